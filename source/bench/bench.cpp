@@ -0,0 +1,611 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include "../lib_compiler/nano.h"
+#include "../lib_compiler/codegen.h"
+#include "../lib_compiler/errors.h"
+#include "../lib_compiler/lexer.h"
+#include "../lib_compiler/parser.h"
+
+#include "../lib_vm/vm.h"
+#include "../lib_vm/thread.h"
+
+#include "../lib_builtins/builtin.h"
+
+// nano_bench
+//
+// runs micro benchmarks for each family of opcodes followed by macro
+// benchmarks over the example programs, and writes the results as json.
+//
+//    nano_bench [-micro] [-macro] [-repeat N] [-filter TEXT] [-o FILE] [FILES]
+//
+// by default both sets are run.  any .ccml files given on the command line
+// replace the default macro benchmark programs.  a program which fails to
+// compile, raises an error or hits the cycle limit is listed as failed and
+// the exit code is non zero.
+
+namespace {
+
+using namespace nano;
+
+// a micro benchmark is a loop body run 'iterations' times in main()
+struct micro_t {
+  const char *name;
+  // declarations placed before main
+  const char *globals;
+  // statements run before the loop
+  const char *setup;
+  // loop body, 'i' is the loop counter
+  const char *body;
+  int32_t iterations;
+};
+
+const micro_t micro[] = {
+  {"arith", "",
+   "var x = 0\n",
+   "x = (x + i * 3 - (i / 2)) % 10007\n",
+   400000},
+  {"float", "",
+   "var x = 0.5\n",
+   "x = x * 0.999 + 0.25\n",
+   400000},
+  {"getv_setv", "var g = 0\n",
+   "var a = 1\nvar b = 2\nvar c = 3\n",
+   "a = b\nb = c\nc = a\ng = c\n",
+   400000},
+  {"call", "function f(x)\n  return x + 1\nend\n",
+   "var x = 0\n",
+   "x = f(x)\n",
+   200000},
+  {"icall", "function f(x)\n  return x + 1\nend\n",
+   "var x = 0\nvar p = f\n",
+   "x = p(x)\n",
+   200000},
+  {"array", "",
+   "var a = new_array(64)\nvar j = 0\nfor (j = 0 to 64)\n  a[j] = j\nend\n",
+   "a[i % 64] = a[(i + 1) % 64] + 1\n",
+   400000},
+  {"packed", "",
+   "var a = new_int32_array(64)\n",
+   "a[i % 64] = a[(i + 1) % 64] + 1\n",
+   400000},
+  {"map", "",
+   "var m = new_map()\n",
+   "m[i % 256] = i\n",
+   200000},
+  {"string_concat", "",
+   "var s = \"\"\n",
+   "s = \"ab\" + i\n",
+   200000},
+  {"gc_churn", "",
+   "var keep = new_array(16)\n",
+   "keep[i % 16] = new_array(8)\n",
+   200000},
+};
+
+// upper bound on instructions for a single macro benchmark run
+const uint64_t macro_cycle_limit = 100 * 1000 * 1000;
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// host syscalls
+//
+// the console and sdl driver syscalls are stood in for by stubs which
+// discard output and play back canned input.  programs which never return,
+// such as an animation or a filter over stdin, are stopped once they have
+// drawn 'macro_frames' frames or written 'macro_output' bytes, and the run
+// counts as complete.
+
+const uint64_t macro_frames = 8;
+const uint64_t macro_output = 64 * 1024;
+
+const char host_input[] =
+  "the quick brown fox\n"
+  "jumps over\n"
+  "the lazy dog\n";
+
+// keys held down in turn, each for a few frames
+const char *const host_keys[] = {"up", "right", "down", "left"};
+
+struct host_t {
+  uint32_t rand;
+  size_t input;
+  uint64_t output;
+  uint64_t frames;
+  bool stopped;
+};
+
+host_t host;
+
+void host_reset() {
+  host.rand = 12345;
+  host.input = 0;
+  host.output = 0;
+  host.frames = 0;
+  host.stopped = false;
+}
+
+void host_stop(thread_t &t) {
+  host.stopped = true;
+  t.halt();
+}
+
+void host_wrote(thread_t &t, uint64_t bytes) {
+  host.output += bytes;
+  if (host.output >= macro_output) {
+    host_stop(t);
+  }
+}
+
+void sys_putc(thread_t &t, int32_t) {
+  t.get_stack().pop();
+  host_wrote(t, 1);
+  t.get_stack().push_int(0);
+}
+
+void sys_puts(thread_t &t, int32_t) {
+  const value_t *v = t.get_stack().pop();
+  host_wrote(t, (v && v->is_a<val_type_string>()) ? v->strlen() + 1 : 1);
+  t.get_stack().push_int(0);
+}
+
+void sys_getc(thread_t &t, int32_t) {
+  const size_t size = sizeof(host_input) - 1;
+  t.get_stack().push_int(host.input < size ? host_input[host.input++] : -1);
+}
+
+void sys_gets(thread_t &t, int32_t) {
+  const size_t size = sizeof(host_input) - 1;
+  std::string line;
+  while (host.input < size && host_input[host.input] != '\n') {
+    line += host_input[host.input++];
+  }
+  host.input += (host.input < size) ? 1 : 0;
+  t.get_stack().push_string(line);
+}
+
+void sys_read(thread_t &t, int32_t) {
+  const value_t *n = t.get_stack().pop();
+  const size_t size = sizeof(host_input) - 1;
+  const size_t want = (n && n->is_a<val_type_int>() && n->v > 0) ? n->v : 0;
+  const size_t got = std::min(want, size - host.input);
+  t.get_stack().push_string(std::string(host_input + host.input, got));
+  host.input += got;
+}
+
+void sys_rand(thread_t &t, int32_t) {
+  uint32_t &x = host.rand;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  t.get_stack().push_int(int32_t(x & 0x7fffffff));
+}
+
+void sys_flip(thread_t &t, int32_t) {
+  if (++host.frames >= macro_frames) {
+    host_stop(t);
+  }
+  t.get_stack().push_int(0);
+}
+
+// a program waiting on the host is as good as one drawing frames
+void sys_sleep(thread_t &t, int32_t) {
+  t.get_stack().pop();
+  sys_flip(t, 0);
+}
+
+void sys_keydown(thread_t &t, int32_t) {
+  const value_t *key = t.get_stack().pop();
+  const char *held = host_keys[(host.frames / 2) % 4];
+  t.get_stack().push_int(key && key->is_a<val_type_string>() &&
+                         strcmp(key->string(), held) == 0 ? 1 : 0);
+}
+
+// drawing calls do nothing
+void sys_none(thread_t &t, int32_t nargs) {
+  for (int32_t i = 0; i < nargs; ++i) {
+    t.get_stack().pop();
+  }
+  t.get_stack().push_int(0);
+}
+
+struct host_syscall_t {
+  const char *name;
+  int32_t nargs;
+  nano_syscall_t call;
+};
+
+const host_syscall_t host_syscalls[] = {
+  // console driver
+  {"putc", 1, sys_putc}, {"getc", 0, sys_getc}, {"puts", 1, sys_puts},
+  {"gets", 0, sys_gets}, {"rand", 0, sys_rand}, {"print", 1, sys_puts},
+  {"write", 1, sys_puts}, {"read", 1, sys_read}, {"flush", 0, sys_none},
+  // sdl driver
+  {"cls", 0, sys_none}, {"video", 2, sys_none}, {"plot", 2, sys_none},
+  {"flip", 0, sys_flip}, {"setrgb", 3, sys_none}, {"circle", 3, sys_none},
+  {"line", 4, sys_none}, {"sleep", 1, sys_sleep},
+  {"keydown", 1, sys_keydown},
+};
+
+// find the identifiers a program uses but does not declare itself, so that
+// only the host syscalls it calls are registered and a program is free to
+// reuse the name of one the other driver provides
+void find_references(const source_manager_t &sources,
+                     std::set<std::string> &out) {
+  // lex into a scratch program so nothing leaks into the real build
+  program_t scratch;
+  nano_t nano{scratch};
+  std::set<std::string> declared;
+  for (int32_t i = 0; i < sources.count(); ++i) {
+    lexer_t lexer(nano);
+    if (!lexer.lex(sources.get_source(i).data(), i)) {
+      continue;
+    }
+    token_stream_t &stream = lexer.stream();
+    token_e prev = TOK_EOL;
+    // 0 outside a declaration, 1 after 'function', 2 inside its arguments
+    int decl = 0;
+    while (stream.type() != TOK_EOF) {
+      const token_t *t = stream.pop();
+      switch (t->type_) {
+      case TOK_IDENT:
+        if (decl == 2 || prev == TOK_VAR || prev == TOK_FUNC ||
+            prev == TOK_CONST) {
+          declared.insert(t->str_);
+        } else {
+          out.insert(t->str_);
+        }
+        break;
+      case TOK_FUNC:
+        decl = 1;
+        break;
+      case TOK_LPAREN:
+        decl = (decl == 1) ? 2 : decl;
+        break;
+      case TOK_RPAREN:
+        decl = 0;
+        break;
+      default:
+        break;
+      }
+      prev = t->type_;
+    }
+  }
+  for (const std::string &name : declared) {
+    out.erase(name);
+  }
+}
+
+struct result_t {
+  std::string name;
+  std::string kind;
+  std::string status;
+  uint64_t iterations;
+  uint64_t instructions;
+  uint64_t time_ns;
+  uint64_t gc_collections;
+  uint64_t gc_time_ns;
+  uint64_t heap_peak;
+};
+
+bool build(program_t &prog, source_manager_t &sources, std::string &error) {
+  nano_t nano{prog};
+  builtins_register(nano);
+  std::set<std::string> used;
+  find_references(sources, used);
+  std::vector<const host_syscall_t *> host_set;
+  for (const host_syscall_t &s : host_syscalls) {
+    if (used.count(s.name)) {
+      nano.syscall_register(s.name, s.nargs);
+      host_set.push_back(&s);
+    }
+  }
+  nano::error_t err;
+  if (!nano.build(sources, err)) {
+    error = err.error;
+    return false;
+  }
+  builtins_resolve(prog);
+  for (const host_syscall_t *s : host_set) {
+    prog.syscall_resolve(s->name, s->call);
+  }
+  return true;
+}
+
+// run main() once in a fresh vm filling in the measurements
+bool run_once(program_t &prog, uint64_t limit, result_t &r) {
+  const function_t *func = prog.function_find("main");
+  if (!func) {
+    r.status = "no main";
+    return false;
+  }
+  vm_t vm(prog);
+  host_reset();
+  const auto start = std::chrono::steady_clock::now();
+  if (!vm.call_init()) {
+    r.status = "init failed";
+    return false;
+  }
+  thread_t *t = vm.new_thread(*func, 0, nullptr);
+  if (!t) {
+    r.status = "bad main";
+    return false;
+  }
+  uint64_t cycles = 0;
+  while (!t->finished() && !t->has_error() && !host.stopped &&
+         cycles < limit) {
+    const uint32_t before = t->get_cycle_count();
+    t->resume(64 * 1024);
+    cycles += uint32_t(t->get_cycle_count() - before);
+  }
+  const auto took = std::chrono::steady_clock::now() - start;
+  if (t->has_error()) {
+    r.status = "error";
+    return false;
+  }
+  if (!t->finished() && !host.stopped) {
+    r.status = "limit";
+    return false;
+  }
+  const uint64_t ns = uint64_t(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(took).count());
+  // keep the fastest run
+  if (r.time_ns == 0 || ns < r.time_ns) {
+    r.time_ns = ns;
+    r.instructions = cycles;
+    const vm_stats_t stats = vm.stats();
+    r.gc_collections = stats.collections;
+    r.gc_time_ns = stats.gc_time_ns;
+    r.heap_peak = stats.heap_peak;
+  }
+  r.status = "ok";
+  return true;
+}
+
+void run(source_manager_t &sources, uint64_t limit, int repeat, result_t &r) {
+  program_t prog;
+  std::string error;
+  if (!build(prog, sources, error)) {
+    r.status = "compile error: " + error;
+    return;
+  }
+  for (int i = 0; i < repeat; ++i) {
+    if (!run_once(prog, limit, r)) {
+      // a failed program has no timings worth reporting
+      r.instructions = 0;
+      r.time_ns = 0;
+      r.gc_collections = 0;
+      r.gc_time_ns = 0;
+      r.heap_peak = 0;
+      return;
+    }
+  }
+}
+
+result_t new_result(const std::string &name, const char *kind) {
+  result_t r;
+  r.name = name;
+  r.kind = kind;
+  r.iterations = 0;
+  r.instructions = 0;
+  r.time_ns = 0;
+  r.gc_collections = 0;
+  r.gc_time_ns = 0;
+  r.heap_peak = 0;
+  return r;
+}
+
+result_t run_micro(const micro_t &m, int repeat) {
+  result_t r = new_result(std::string("micro/") + m.name, "micro");
+  r.iterations = m.iterations;
+  const std::string source =
+    std::string(m.globals) +
+    "function main()\n" +
+    m.setup +
+    "var i = 0\n"
+    "for (i = 0 to " + std::to_string(m.iterations) + ")\n" +
+    m.body +
+    "end\n"
+    "return 0\n"
+    "end\n";
+  source_manager_t sources;
+  sources.load_from_string(source.c_str());
+  run(sources, UINT64_MAX, repeat, r);
+  return r;
+}
+
+result_t run_macro(const std::string &path, int repeat) {
+  // name programs in the tree relative to its root
+  const std::string root = std::string(NANO_SOURCE_DIR) + "/";
+  const bool in_tree = path.compare(0, root.size(), root) == 0;
+  const std::string name = in_tree ? path.substr(root.size()) : path;
+  result_t r = new_result("macro/" + name, "macro");
+  r.iterations = 1;
+  source_manager_t sources;
+  if (!sources.load(path.c_str())) {
+    r.status = "unable to load";
+    return r;
+  }
+  run(sources, macro_cycle_limit, repeat, r);
+  return r;
+}
+
+// list the .ccml files in a directory in name order
+void list_dir(const std::string &dir, std::vector<std::string> &out) {
+  std::vector<std::string> names;
+#if defined(_WIN32)
+  WIN32_FIND_DATAA data;
+  HANDLE h = FindFirstFileA((dir + "\\*.ccml").c_str(), &data);
+  if (h != INVALID_HANDLE_VALUE) {
+    do {
+      names.push_back(data.cFileName);
+    } while (FindNextFileA(h, &data));
+    FindClose(h);
+  }
+#else
+  if (DIR *d = opendir(dir.c_str())) {
+    while (dirent *e = readdir(d)) {
+      const std::string name = e->d_name;
+      if (name.size() > 5 && name.substr(name.size() - 5) == ".ccml") {
+        names.push_back(name);
+      }
+    }
+    closedir(d);
+  }
+#endif
+  std::sort(names.begin(), names.end());
+  for (const std::string &n : names) {
+    out.push_back(dir + "/" + n);
+  }
+}
+
+void json_string(FILE *fd, const std::string &s) {
+  fputc('"', fd);
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      fputc('\\', fd);
+    }
+    fputc((c < ' ') ? ' ' : c, fd);
+  }
+  fputc('"', fd);
+}
+
+void write_json(FILE *fd, const std::vector<result_t> &results) {
+  fprintf(fd, "{\n  \"benchmarks\": [\n");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const result_t &r = results[i];
+    const double ns = double(r.time_ns);
+    const double ops = r.iterations ? double(r.iterations) : 1.0;
+    const double ins = r.instructions ? double(r.instructions) : 1.0;
+    fprintf(fd, "    {\"name\": ");
+    json_string(fd, r.name);
+    fprintf(fd, ", \"kind\": \"%s\", \"status\": ", r.kind.c_str());
+    json_string(fd, r.status);
+    fprintf(fd, ",\n     \"iterations\": %llu, \"instructions\": %llu, "
+                "\"time_ns\": %llu,\n",
+            (unsigned long long)r.iterations,
+            (unsigned long long)r.instructions,
+            (unsigned long long)r.time_ns);
+    fprintf(fd, "     \"ns_per_op\": %.3f, \"ns_per_instruction\": %.3f, "
+                "\"instructions_per_sec\": %.0f,\n",
+            ns / ops, ns / ins, ns > 0.0 ? ins * 1e9 / ns : 0.0);
+    fprintf(fd, "     \"gc_collections\": %llu, \"gc_time_ns\": %llu, "
+                "\"peak_heap_bytes\": %llu}%s\n",
+            (unsigned long long)r.gc_collections,
+            (unsigned long long)r.gc_time_ns,
+            (unsigned long long)r.heap_peak,
+            (i + 1 < results.size()) ? "," : "");
+  }
+  fprintf(fd, "  ]\n}\n");
+}
+
+} // namespace {}
+
+int main(int argc, char **argv) {
+
+  bool do_micro = false;
+  bool do_macro = false;
+  int repeat = 3;
+  const char *filter = nullptr;
+  const char *out_path = nullptr;
+  std::vector<std::string> files;
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-micro") == 0) {
+      do_micro = true;
+      continue;
+    }
+    if (strcmp(argv[i], "-macro") == 0) {
+      do_macro = true;
+      continue;
+    }
+    if (strcmp(argv[i], "-repeat") == 0 && i + 1 < argc) {
+      repeat = std::max(1, atoi(argv[++i]));
+      continue;
+    }
+    if (strcmp(argv[i], "-filter") == 0 && i + 1 < argc) {
+      filter = argv[++i];
+      continue;
+    }
+    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      out_path = argv[++i];
+      continue;
+    }
+    files.push_back(argv[i]);
+  }
+  if (!do_micro && !do_macro) {
+    do_micro = do_macro = true;
+  }
+  if (files.empty()) {
+    const std::string root = NANO_SOURCE_DIR;
+    list_dir(root + "/examples/misc", files);
+    list_dir(root + "/examples/snake", files);
+    // unwind raises an error by design so is not a workload
+    files.erase(std::remove(files.begin(), files.end(),
+                            root + "/examples/misc/unwind.ccml"),
+                files.end());
+  }
+
+  auto wanted = [&](const std::string &name) {
+    return !filter || name.find(filter) != std::string::npos;
+  };
+
+  std::vector<result_t> results;
+  if (do_micro) {
+    for (const micro_t &m : micro) {
+      if (wanted(std::string("micro/") + m.name)) {
+        results.push_back(run_micro(m, repeat));
+        fprintf(stderr, "%s: %s\n", results.back().name.c_str(),
+                results.back().status.c_str());
+      }
+    }
+  }
+  if (do_macro) {
+    for (const std::string &path : files) {
+      if (wanted(path)) {
+        results.push_back(run_macro(path, repeat));
+        fprintf(stderr, "%s: %s\n", results.back().name.c_str(),
+                results.back().status.c_str());
+      }
+    }
+  }
+
+  FILE *fd = out_path ? fopen(out_path, "w") : stdout;
+  if (!fd) {
+    fprintf(stderr, "unable to open '%s'\n", out_path);
+    return 1;
+  }
+  write_json(fd, results);
+  if (fd != stdout) {
+    fclose(fd);
+  }
+
+  // anything which did not run to completion is a failure, not a timing
+  int failed = 0;
+  for (const result_t &r : results) {
+    if (r.status != "ok") {
+      if (failed++ == 0) {
+        fprintf(stderr, "failed:\n");
+      }
+      fprintf(stderr, "   %s: %s\n", r.name.c_str(), r.status.c_str());
+    }
+  }
+  if (failed) {
+    fprintf(stderr, "%d of %d benchmarks failed\n", failed,
+            int(results.size()));
+    return 1;
+  }
+  return 0;
+}
@@ -3,6 +3,7 @@
 #include "../lib_compiler/nano.h"
 #include "../lib_compiler/codegen.h"
 #include "../lib_compiler/disassembler.h"
+#include "../lib_compiler/aot.h"
 #include "../lib_compiler/errors.h"
 #include "../lib_compiler/lexer.h"
 #include "../lib_compiler/parser.h"
@@ -27,11 +28,12 @@ FILE *fd_open(const char *base, const char *ext) {
 }
 
 void usage(const char *path) {
-printf(R"(usage: %s file.nano [-n -a -d -b]
+printf(R"(usage: %s file.nano [-n -a -d -b -c]
   -n  disable codegen optimizations
   -a  emit ast
   -d  emit disassembly
   -b  emit binary
+  -c  emit C++ for use with nano_driver
 )", path);
 }
 
@@ -42,6 +44,7 @@ int main(int argc, char **argv) {
   FILE *fd_ast = nullptr;
   FILE *fd_dis = nullptr;
   FILE *fd_bin = nullptr;
+  FILE *fd_cpp = nullptr;
 
   if (argc <= 1) {
     usage(argv[0]);
@@ -74,6 +77,9 @@ int main(int argc, char **argv) {
     case 'b':
       fd_bin = fd_open(argv[1], ".bin");
       break;
+    case 'c':
+      fd_cpp = fd_open(argv[1], ".cpp");
+      break;
     case 'n':
       optimize = false;
       break;
@@ -88,9 +94,23 @@ int main(int argc, char **argv) {
     nano_t nano(program);
 //    add_builtins(nano);
     nano.optimize = optimize;
+    // native code must be generated from the same program nano_driver
+    // builds so register the same syscalls it does
+    if (fd_cpp) {
+      builtins_register(nano);
+      nano.syscall_register("putc", 1);
+      nano.syscall_register("getc", 0);
+      nano.syscall_register("puts", 1);
+      nano.syscall_register("gets", 0);
+      nano.syscall_register("rand", 0);
+      nano.syscall_register("print", 1);
+      nano.syscall_register("write", 1);
+      nano.syscall_register("read", 1);
+      nano.syscall_register("flush", 0);
+    }
 
     // build the program
-    error_t error;
+    nano::error_t error;
     if (!nano.build(sources, error)) {
       on_error(error);
       return -2;
@@ -108,6 +128,13 @@ int main(int argc, char **argv) {
     disasm.dump(program, fd_dis);
   }
 
+  // emit C++ source
+  if (fd_cpp) {
+    aot_t aot;
+    aot.dump(program, fd_cpp);
+    fclose(fd_cpp);
+  }
+
   // dump the binary
   if (fd_bin) {
     const uint8_t *data = program.data();
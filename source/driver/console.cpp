@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "console.h"
+
+
+namespace {
+
+// stdout buffer size
+static const size_t buffer_size = 64 * 1024;
+
+bool is_terminal(FILE *fd) {
+#if defined(_WIN32)
+  return _isatty(_fileno(fd)) != 0;
+#else
+  return isatty(fileno(fd)) != 0;
+#endif
+}
+
+} // namespace {}
+
+namespace nano {
+
+console_t::console_t()
+  : interactive_(is_terminal(stdout))
+{
+  // must happen before anything is written
+  setvbuf(stdout, nullptr, _IOFBF, buffer_size);
+}
+
+console_t::~console_t() {
+  flush();
+}
+
+int console_t::get() {
+  // make sure any prompt has been seen
+  flush();
+  return getchar();
+}
+
+bool console_t::read_line(std::string &out, size_t limit) {
+  flush();
+  out.clear();
+  char chunk[1024];
+  while (out.size() < limit) {
+    // fgets() keeps one byte for the terminator
+    const size_t want = std::min(sizeof(chunk), limit - out.size() + 1);
+    if (!fgets(chunk, int(want), stdin)) {
+      break;
+    }
+    out += chunk;
+    if (!out.empty() && out.back() == '\n') {
+      out.pop_back();
+      if (!out.empty() && out.back() == '\r') {
+        out.pop_back();
+      }
+      return true;
+    }
+  }
+  // a last line without a line ending
+  return !out.empty();
+}
+
+void console_t::read(size_t size, std::string &out) {
+  flush();
+  out.resize(size);
+  out.resize(fread(&out[0], 1, size, stdin));
+}
+
+} // namespace nano
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+
+namespace nano {
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+//
+// buffered console i/o behind the driver syscalls
+//
+// output is fully buffered and only written when the buffer fills, on an
+// explicit flush, or before input is read.  when stdout is a terminal each
+// completed line is also written so interactive programs behave as before.
+//
+struct console_t {
+
+  console_t();
+  ~console_t();
+
+  void write(const char *data, size_t size) {
+    fwrite(data, 1, size, stdout);
+    if (interactive_ && memchr(data, '\n', size)) {
+      fflush(stdout);
+    }
+  }
+
+  void put(char ch) {
+    putchar(ch);
+    if (interactive_ && ch == '\n') {
+      fflush(stdout);
+    }
+  }
+
+  void flush() {
+    fflush(stdout);
+  }
+
+  // read one character, or -1 at the end of input
+  int get();
+
+  // read a line without its line ending, stopping after 'limit' bytes if
+  // it is longer.  returns false at the end of input.
+  bool read_line(std::string &out, size_t limit);
+
+  // read up to 'size' bytes, fewer at the end of input
+  void read(size_t size, std::string &out);
+
+  // true if stdout is a terminal
+  bool interactive() const {
+    return interactive_;
+  }
+
+protected:
+  bool interactive_;
+};
+
+} // namespace nano
@@ -1,4 +1,5 @@
 #include <cstdio>
+#include <cstring>
 
 #include "../lib_compiler/nano.h"
 #include "../lib_compiler/codegen.h"
@@ -9,12 +10,25 @@
 
 #include "../lib_vm/vm.h"
 #include "../lib_vm/thread.h"
+#include "../lib_vm/profiler.h"
+#include "../lib_vm/opcode_stats.h"
+#include "../lib_vm/coverage.h"
+#include "../lib_vm/replay.h"
 
 #include "../lib_builtins/builtin.h"
 
+#include "console.h"
+
+#if defined(NANO_AOT)
+// provided by a translation unit generated with 'nano_comp -c'
+bool nano_aot_register(nano::vm_t &vm);
+#endif
 
 namespace {
 
+// stdout and stdin for the script
+nano::console_t console;
+
 static inline uint32_t xorshift32() {
   static uint32_t x = 12345;
   x ^= x << 13;
@@ -32,48 +46,81 @@ void vm_rand(nano::thread_t &t, int32_t) {
 
 void vm_getc(nano::thread_t &t, int32_t) {
   using namespace nano;
-  const int32_t ch = getchar();
-  t.get_stack().push_int(ch);
+  t.get_stack().push_int(console.get());
 }
 
 void vm_putc(nano::thread_t &t, int32_t) {
   using namespace nano;
   const value_t *v = t.get_stack().pop();
-  assert(v);
-  if (!v->is_a<val_type_int>()) {
+  if (!v || !v->is_a<val_type_int>()) {
     t.raise_error(thread_error_t::e_bad_argument);
   } else {
-    putchar((int)(v->v));
-    fflush(stdout);
+    console.put(char(v->v));
   }
   t.get_stack().push_int(0);
 }
 
 void vm_gets(nano::thread_t &t, int32_t) {
   using namespace nano;
-  char buffer[80];
-  fgets(buffer, sizeof(buffer), stdin);
-  for (size_t i = 0; i < sizeof(buffer); ++i) {
-    buffer[i] = (buffer[i] == '\n') ? '\0' : buffer[i];
+  // read one byte past the limit to tell a line which is too long
+  const size_t limit = t.gc().max_string();
+  std::string line;
+  console.read_line(line, limit + 1);
+  if (line.size() > limit) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    t.get_stack().push_int(0);
+    return;
   }
-  buffer[79] = '\0';
-  t.get_stack().push_string(std::string{buffer});
+  t.get_stack().push_string(line);
 }
 
 void vm_puts(nano::thread_t &t, int32_t) {
   using namespace nano;
   value_t *s = t.get_stack().pop();
-  assert(s);
-  if (!s->is_a<val_type_string>()) {
+  if (!s || !s->is_a<val_type_string>()) {
     t.raise_error(thread_error_t::e_bad_argument);
   } else {
-    printf("%s\n", s->string());
-    fflush(stdout);
+    console.write(s->string(), size_t(s->strlen()));
+    console.put('\n');
   }
   t.get_stack().push_int(0);
   return;
 }
 
+// write a string without a line ending
+void vm_write(nano::thread_t &t, int32_t) {
+  using namespace nano;
+  value_t *s = t.get_stack().pop();
+  if (!s || !s->is_a<val_type_string>()) {
+    t.raise_error(thread_error_t::e_bad_argument);
+  } else {
+    console.write(s->string(), size_t(s->strlen()));
+  }
+  t.get_stack().push_int(0);
+}
+
+// read up to n bytes, returning an empty string at the end of input.  n may
+// not exceed the longest string the heap can hold.
+void vm_read(nano::thread_t &t, int32_t) {
+  using namespace nano;
+  const value_t *v = t.get_stack().pop();
+  // the result must fit in a single string allocation
+  if (!v || !v->is_a<val_type_int>() || v->v < 0 ||
+      size_t(v->v) > t.gc().max_string()) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    t.get_stack().push_int(0);
+    return;
+  }
+  std::string data;
+  console.read(size_t(v->v), data);
+  t.get_stack().push_string(data);
+}
+
+void vm_flush(nano::thread_t &t, int32_t) {
+  console.flush();
+  t.get_stack().push_int(0);
+}
+
 void on_error(const nano::error_t &error) {
   fprintf(stderr, "file %d, line:%d - %s\n",
           error.line.file,
@@ -97,6 +144,16 @@ void on_runtime_error(nano::thread_t &thread, const nano::source_manager_t &sour
   printf("%s\n", s.c_str());
 }
 
+// report where a thread stopped with an error
+bool on_thread_error(nano::thread_t &thread) {
+  const nano::line_t line = thread.get_source_line();
+  fprintf(stderr, "file %d, line:%d - %s\n",
+          line.file,
+          line.line,
+          nano::get_thread_error(thread.get_error()));
+  return true;
+}
+
 void print_result(const nano::value_t *res) {
 
   using namespace nano;
@@ -121,6 +178,21 @@ void print_result(const nano::value_t *res) {
   if (res->is_a<val_type_func>()) {
     fprintf(fd, "function");
   }
+  if (res->is_a<val_type_buffer>()) {
+    fprintf(fd, "buffer");
+  }
+  if (res->is_a<val_type_int32_array>()) {
+    fprintf(fd, "int32_array");
+  }
+  if (res->is_a<val_type_float32_array>()) {
+    fprintf(fd, "float32_array");
+  }
+  if (res->is_a<val_type_uint8_array>()) {
+    fprintf(fd, "uint8_array");
+  }
+  if (res->is_a<val_type_map>()) {
+    fprintf(fd, "map");
+  }
   fprintf(fd, "\n");
 }
 } // namespace
@@ -132,15 +204,85 @@ int main(int argc, char **argv) {
   bool dump_ast = false;
   bool dump_dis = false;
 
+  // directory to cache compiled programs in
+  const char *cache_dir = nullptr;
+  // program image to run instead of compiling, or to write out
+  const char *image_in = nullptr;
+  const char *image_out = nullptr;
+  // snapshot of the initialized globals to write, or to start from
+  const char *snapshot_out = nullptr;
+  const char *snapshot_in = nullptr;
+  // file to write collapsed profile stacks to
+  const char *profile_out = nullptr;
+  // file to write a disassembly annotated with hit counts to
+  const char *annotate_out = nullptr;
+  // file to write the allocation report to
+  const char *alloc_out = nullptr;
+  // file to write chrome trace events to
+  const char *trace_out = nullptr;
+  // file to write lcov coverage to
+  const char *coverage_out = nullptr;
+  // log of the program's inputs to record, or to replay
+  const char *record_out = nullptr;
+  const char *replay_in = nullptr;
+
   // load the source
   source_manager_t sources;
   for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      cache_dir = argv[++i];
+      continue;
+    }
+    if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+      image_in = argv[++i];
+      continue;
+    }
+    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      image_out = argv[++i];
+      continue;
+    }
+    if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      snapshot_out = argv[++i];
+      continue;
+    }
+    if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+      snapshot_in = argv[++i];
+      continue;
+    }
+    if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+      profile_out = argv[++i];
+      continue;
+    }
+    if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+      annotate_out = argv[++i];
+      continue;
+    }
+    if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+      alloc_out = argv[++i];
+      continue;
+    }
+    if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      trace_out = argv[++i];
+      continue;
+    }
+    if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+      coverage_out = argv[++i];
+      continue;
+    }
+    if (strcmp(argv[i], "-record") == 0 && i + 1 < argc) {
+      record_out = argv[++i];
+      continue;
+    }
+    if (strcmp(argv[i], "-replay") == 0 && i + 1 < argc) {
+      replay_in = argv[++i];
+      continue;
+    }
     if (!sources.load(argv[i])) {
       fprintf(stderr, "unable to load input '%s'\n", argv[i]);
       return -2;
     }
   }
-  if (sources.count() == 0) {
+  if (sources.count() == 0 && !image_in) {
     fprintf(stderr, "no source files provided\n");
     return -1;
   }
@@ -148,8 +290,12 @@ int main(int argc, char **argv) {
   // program to compile into
   nano::program_t program;
 
-  // compile
-  {
+  if (image_in) {
+    if (!program.image_load(image_in)) {
+      fprintf(stderr, "unable to load image '%s'\n", image_in);
+      return -2;
+    }
+  } else {
     // create compile stack
     nano_t nano{program};
     builtins_register(nano);
@@ -159,6 +305,12 @@ int main(int argc, char **argv) {
     nano.syscall_register("gets", 0);
     nano.syscall_register("rand", 0);
     nano.syscall_register("print", 1);
+    nano.syscall_register("write", 1);
+    nano.syscall_register("read", 1);
+    nano.syscall_register("flush", 0);
+    if (cache_dir) {
+      nano.cache_dir = cache_dir;
+    }
 
     // build the program
     nano::error_t error;
@@ -179,10 +331,20 @@ int main(int argc, char **argv) {
   program.syscall_resolve("gets", vm_gets);
   program.syscall_resolve("rand", vm_rand);
   program.syscall_resolve("print", vm_puts);
+  program.syscall_resolve("write", vm_write);
+  program.syscall_resolve("read", vm_read);
+  program.syscall_resolve("flush", vm_flush);
 
   builtins_resolve(program);
   program.serial_save("temp.bin");
 
+  if (image_out) {
+    if (!program.image_save(image_out)) {
+      fprintf(stderr, "unable to write image '%s'\n", image_out);
+      return -2;
+    }
+  }
+
   // disassemble the program
   if (dump_dis) {
     disassembler_t disasm;
@@ -198,11 +360,58 @@ int main(int argc, char **argv) {
 
   // create the vm and a thread
   nano::vm_t vm{program};
+  vm.handlers.on_thread_error = on_thread_error;
+
+  if (alloc_out) {
+    // track allocations made by @init too
+    vm.alloc_tracker_start();
+  }
+  if (record_out &&
+      !vm.replay_record(record_out, {"getc", "gets", "read", "rand"})) {
+    fprintf(stderr, "unable to write replay log '%s'\n", record_out);
+    return -2;
+  }
+  if (replay_in && !vm.replay_start(replay_in)) {
+    fprintf(stderr, "unable to replay log '%s'\n", replay_in);
+    return -2;
+  }
+  if (coverage_out) {
+    // cover @init too
+    vm.coverage_start();
+  }
+  if (trace_out && !vm.trace_events_start(trace_out)) {
+    fprintf(stderr, "unable to write trace '%s'\n", trace_out);
+    return -2;
+  }
 
-  // call the global init function
-  if (!vm.call_init()) {
-    fprintf(stderr, "failed while executing @init\n");
-    return -5;
+#if defined(NANO_AOT)
+  // switch to the native functions
+  if (!nano_aot_register(vm)) {
+    fprintf(stderr, "native code does not match program\n");
+    return -7;
+  }
+#endif
+
+  if (snapshot_in) {
+    // restore the globals instead of running @init
+    if (!vm.snapshot_load(snapshot_in)) {
+      fprintf(stderr, "unable to restore snapshot '%s'\n", snapshot_in);
+      return -5;
+    }
+  } else {
+    // call the global init function
+    if (!vm.call_init()) {
+      fprintf(stderr, "failed while executing @init\n");
+      return -5;
+    }
+    if (snapshot_out && !vm.snapshot_save(snapshot_out)) {
+      fprintf(stderr, "unable to write snapshot '%s'\n", snapshot_out);
+      return -5;
+    }
+  }
+
+  if (profile_out) {
+    vm.profiler_start();
   }
 
   // execution
@@ -219,6 +428,63 @@ int main(int argc, char **argv) {
   }
   fflush(stdout);
 
+  if (vm.replay() && vm.replay()->diverged()) {
+    fprintf(stderr, "execution diverged from replay log '%s'\n", replay_in);
+    return -8;
+  }
+  vm.replay_stop();
+
+  if (trace_out) {
+    vm.trace_events_stop();
+  }
+
+  if (profile_out) {
+    vm.profiler_stop();
+    FILE *fd = fopen(profile_out, "w");
+    if (!fd) {
+      fprintf(stderr, "unable to write profile '%s'\n", profile_out);
+      return -2;
+    }
+    vm.profiler()->write_collapsed(fd);
+    fclose(fd);
+    vm.profiler()->write_report(stderr, 20, &sources);
+  }
+
+  if (alloc_out) {
+    FILE *fd = fopen(alloc_out, "w");
+    if (!fd) {
+      fprintf(stderr, "unable to write allocation report '%s'\n", alloc_out);
+      return -2;
+    }
+    vm.alloc_tracker()->write(fd, program, 20, &sources);
+    fclose(fd);
+  }
+
+  if (coverage_out) {
+    FILE *fd = fopen(coverage_out, "w");
+    if (!fd) {
+      fprintf(stderr, "unable to write coverage '%s'\n", coverage_out);
+      return -2;
+    }
+    vm.coverage()->write_lcov(fd, &sources);
+    fclose(fd);
+  }
+
+  if (annotate_out) {
+    if (!vm.opcode_stats()) {
+      fprintf(stderr, "hit counts need a NANO_OPCODE_STATS build\n");
+      return -2;
+    }
+    FILE *fd = fopen(annotate_out, "w");
+    if (!fd) {
+      fprintf(stderr, "unable to write listing '%s'\n", annotate_out);
+      return -2;
+    }
+    disassembler_t disasm;
+    disasm.dump(program, fd, &vm.opcode_stats()->hits());
+    fclose(fd);
+  }
+
   print_result(res);
   return 0;
 }
@@ -1,4 +1,5 @@
 #include <cstdio>
+#include <cstring>
 #include <memory>
 
 #define _SDL_main_h
@@ -7,6 +8,7 @@
 #include "../nanoscript.h"
 
 #include "../lib_vm/vm.h"
+#include "../lib_vm/replay.h"
 
 #include "../lib_builtins/builtin.h"
 
@@ -317,9 +319,21 @@ int main(int argc, char **argv) {
     return 1;
   }
 
+  // log of the program's inputs to record, or to replay
+  const char *record_out = nullptr;
+  const char *replay_in = nullptr;
+
   // load the source
   source_manager_t sources;
   for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-record") == 0 && i + 1 < argc) {
+      record_out = argv[++i];
+      continue;
+    }
+    if (strcmp(argv[i], "-replay") == 0 && i + 1 < argc) {
+      replay_in = argv[++i];
+      continue;
+    }
     if (!sources.load(argv[i])) {
       fprintf(stderr, "unable to load input '%s'\n", argv[i]);
       return -2;
@@ -374,6 +388,15 @@ int main(int argc, char **argv) {
 
   nano::vm_t vm(program);
 
+  if (record_out && !vm.replay_record(record_out, {"rand", "keydown"})) {
+    fprintf(stderr, "unable to write replay log '%s'\n", record_out);
+    exit(1);
+  }
+  if (replay_in && !vm.replay_start(replay_in)) {
+    fprintf(stderr, "unable to replay log '%s'\n", replay_in);
+    exit(1);
+  }
+
   if (!vm.call_init()) {
     fprintf(stderr, "failed while executing @init\n");
   }
@@ -386,7 +409,8 @@ int main(int argc, char **argv) {
   bool active = true;
   while (active) {
 
-    if (SDL_GetTicks() > tick_mark) {
+    // a replay runs as fast as it can until the log ends
+    if (replay_in || SDL_GetTicks() > tick_mark) {
       if (!vm.resume(1024)) {
         break;
       }
@@ -405,6 +429,11 @@ int main(int argc, char **argv) {
     }
   }
 
+  if (vm.replay() && vm.replay()->diverged()) {
+    fprintf(stderr, "execution diverged from replay log '%s'\n", replay_in);
+  }
+  vm.replay_stop();
+
   if (vm.has_error()) {
     // XXX: FIXME
 #if 0
@@ -1,4 +1,8 @@
 #include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
 
 #include "../lib_compiler/nano.h"
 
@@ -7,13 +11,37 @@
 #include "../lib_vm/thread.h"
 
 #include "builtin.h"
+#include "simd.h"
 
 
 namespace nano {
 
+// none arguments are null pointers so they are tested for before calling
+// into a value
+
+static bool is_int(const value_t *v) {
+  return v && v->is_a<val_type_int>();
+}
+
+static bool is_number(const value_t *v) {
+  return v && v->is_number();
+}
+
+static bool is_packed(const value_t *v) {
+  return v && v->is_packed();
+}
+
+static bool is_map(const value_t *v) {
+  return v && v->is_a<val_type_map>();
+}
+
 static void builtin_abs(struct nano::thread_t &t, int32_t nargs) {
   (void)nargs;
   const nano::value_t *v = t.get_stack().pop();
+  if (!v) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    return;
+  }
   switch (v->type()) {
   case val_type_int: {
     const int32_t res = (v->v < 0) ? (-v->v) : (v->v);
@@ -32,7 +60,7 @@ static void builtin_max(struct nano::thread_t &t, int32_t nargs) {
   (void)nargs;
   const nano::value_t *a = t.get_stack().pop();
   const nano::value_t *b = t.get_stack().pop();
-  if (a->is_number() && b->is_number()) {
+  if (is_number(a) && is_number(b)) {
     const float af = a->as_float();
     const float bf = b->as_float();
     t.get_stack().push_float(af > bf ? af : bf);
@@ -45,7 +73,7 @@ static void builtin_min(struct nano::thread_t &t, int32_t nargs) {
   (void)nargs;
   const nano::value_t *a = t.get_stack().pop();
   const nano::value_t *b = t.get_stack().pop();
-  if (a->is_number() && b->is_number()) {
+  if (is_number(a) && is_number(b)) {
     const float af = a->as_float();
     const float bf = b->as_float();
     t.get_stack().push_float(af < bf ? af : bf);
@@ -58,8 +86,7 @@ static void builtin_bitand(struct nano::thread_t &t, int32_t nargs) {
   (void)nargs;
   const nano::value_t *a = t.get_stack().pop();
   const nano::value_t *b = t.get_stack().pop();
-  if (a->is_a<val_type_int>() &&
-      b->is_a<val_type_int>()) {
+  if (is_int(a) && is_int(b)) {
     const int32_t res = a->v & b->v;
     t.get_stack().push_int(res);
     return;
@@ -70,6 +97,10 @@ static void builtin_bitand(struct nano::thread_t &t, int32_t nargs) {
 static void builtin_len(struct nano::thread_t &t, int32_t nargs) {
   (void)nargs;
   const nano::value_t *a = t.get_stack().pop();
+  if (!a) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    return;
+  }
   switch (a->type()) {
   case val_type_array: {
     const int32_t res = a->array_size();
@@ -79,6 +110,20 @@ static void builtin_len(struct nano::thread_t &t, int32_t nargs) {
     const int32_t res = a->strlen();
     t.get_stack().push_int(res);
   } break;
+  case val_type_buffer: {
+    const int32_t res = a->buffer()->size;
+    t.get_stack().push_int(res);
+  } break;
+  case val_type_int32_array:
+  case val_type_float32_array:
+  case val_type_uint8_array: {
+    const int32_t res = a->packed_size();
+    t.get_stack().push_int(res);
+  } break;
+  case val_type_map: {
+    const int32_t res = a->map()->count;
+    t.get_stack().push_int(res);
+  } break;
   default:
     t.raise_error(thread_error_t::e_bad_argument);
     break;
@@ -243,31 +288,645 @@ static void builtin_new_array(struct nano::thread_t &t, int32_t nargs) {
   t.raise_error(thread_error_t::e_bad_argument);
 }
 
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// packed arrays
+//
+// elements are read and written as doubles which hold int32, float32 and
+// uint8 values exactly, so conversion matches storing with SETA.
+
+// number of elements in a packed or plain array, or -1
+static int32_t elements(const value_t *a) {
+  if (is_packed(a)) {
+    return a->packed_size();
+  }
+  if (a && a->is_a<val_type_array>()) {
+    return a->array_size();
+  }
+  return -1;
+}
+
+// read a number from a packed or plain array
+static bool element_get(const value_t *a, int32_t i, double &out) {
+  switch (a->type()) {
+  case val_type_int32_array:   out = a->int32_array()[i];   return true;
+  case val_type_float32_array: out = a->float32_array()[i]; return true;
+  case val_type_uint8_array:   out = a->uint8_array()[i];   return true;
+  default:
+    break;
+  }
+  const value_t *v = a->array()[i];
+  if (!v) {
+    return false;
+  }
+  switch (v->type()) {
+  case val_type_int:   out = v->v; return true;
+  case val_type_float: out = v->f; return true;
+  default:             return false;
+  }
+}
+
+// convert to an integer, saturating out of range values and mapping nan to 0
+static int32_t element_int(double v) {
+  if (!(v == v)) {
+    return 0;
+  }
+  if (v <= double(INT32_MIN)) {
+    return INT32_MIN;
+  }
+  if (v >= double(INT32_MAX)) {
+    return INT32_MAX;
+  }
+  return int32_t(v);
+}
+
+// write a number into a packed array
+static void element_set(value_t *a, int32_t i, double v) {
+  switch (a->type()) {
+  case val_type_int32_array:
+    a->int32_array()[i] = element_int(v);
+    break;
+  case val_type_float32_array:
+    a->float32_array()[i] = float(v);
+    break;
+  default:
+    a->uint8_array()[i] = uint8_t(element_int(v));
+    break;
+  }
+}
+
+// convert 'count' elements of 'src' starting at 'from' into 'dst' at 'to'
+static bool elements_copy(value_t *dst, int32_t to, const value_t *src,
+                          int32_t from, int32_t count) {
+  if (src->type() == dst->type()) {
+    const size_t stride = value_t::packed_stride(dst->type());
+    memmove((uint8_t*)(dst + 1) + to * stride,
+            (const uint8_t*)(src + 1) + from * stride, count * stride);
+    return true;
+  }
+  for (int32_t i = 0; i < count; ++i) {
+    double v = 0.0;
+    if (!element_get(src, from + i, v)) {
+      return false;
+    }
+    element_set(dst, to + i, v);
+  }
+  return true;
+}
+
+template <value_type_t type>
+static void builtin_new_packed(struct nano::thread_t &t, int32_t nargs) {
+  (void)nargs;
+  const nano::value_t *v = t.get_stack().pop();
+  if (v && v->is_a<val_type_int>() && v->v >= 0) {
+    t.get_stack().push(t.gc().new_packed(type, v->v));
+    return;
+  }
+  t.raise_error(thread_error_t::e_bad_argument);
+}
+
+// convert a packed or plain array into a new packed array
+template <value_type_t type>
+static void builtin_to_packed(struct nano::thread_t &t, int32_t nargs) {
+  (void)nargs;
+  const nano::value_t *a = t.get_stack().pop();
+  const int32_t size = elements(a);
+  if (size < 0) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    return;
+  }
+  value_t *out = t.gc().new_packed(type, size);
+  if (!elements_copy(out, 0, a, 0, size)) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    return;
+  }
+  t.get_stack().push(out);
+}
+
+// convert a packed array back into a plain array
+static void builtin_to_array(struct nano::thread_t &t, int32_t nargs) {
+  (void)nargs;
+  const nano::value_t *a = t.get_stack().pop();
+  if (!is_packed(a) || a->packed_size() <= 0) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    return;
+  }
+  value_t *out = t.gc().new_array(a->packed_size());
+  for (int32_t i = 0; i < a->packed_size(); ++i) {
+    double v = 0.0;
+    element_get(a, i, v);
+    out->array()[i] = a->is_a<val_type_float32_array>() ?
+                      t.gc().new_float(float(v)) :
+                      t.gc().new_int(int32_t(v));
+  }
+  t.get_stack().push(out);
+}
+
+// array_fill(array, value)
+static void builtin_array_fill(struct nano::thread_t &t, int32_t nargs) {
+  (void)nargs;
+  const nano::value_t *v = t.get_stack().pop();
+  nano::value_t *a = t.get_stack().pop();
+  if (!is_packed(a) || !is_number(v)) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    return;
+  }
+  const int32_t size = a->packed_size();
+  switch (a->type()) {
+  case val_type_int32_array:
+    std::fill(a->int32_array(), a->int32_array() + size, v->as_int());
+    break;
+  case val_type_float32_array:
+    std::fill(a->float32_array(), a->float32_array() + size, v->as_float());
+    break;
+  default:
+    memset(a->uint8_array(), uint8_t(v->as_int()), size);
+    break;
+  }
+  t.get_stack().push(a);
+}
+
+// array_copy(dst, offset, src) converting elements to the type of dst
+static void builtin_array_copy(struct nano::thread_t &t, int32_t nargs) {
+  (void)nargs;
+  const nano::value_t *src = t.get_stack().pop();
+  const nano::value_t *offs = t.get_stack().pop();
+  nano::value_t *dst = t.get_stack().pop();
+  const int32_t count = elements(src);
+  if (!is_packed(dst) || !is_int(offs) || count < 0) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    return;
+  }
+  if (offs->v < 0 || count > dst->packed_size() - offs->v) {
+    t.raise_error(thread_error_t::e_bad_array_bounds);
+    return;
+  }
+  if (!elements_copy(dst, offs->v, src, 0, count)) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    return;
+  }
+  t.get_stack().push(dst);
+}
+
+// array_slice(array, start, end) as a new packed array of the same type
+static void builtin_array_slice(struct nano::thread_t &t, int32_t nargs) {
+  (void)nargs;
+  const nano::value_t *end = t.get_stack().pop();
+  const nano::value_t *start = t.get_stack().pop();
+  const nano::value_t *a = t.get_stack().pop();
+  if (!is_packed(a) || !is_int(start) || !is_int(end)) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    return;
+  }
+  if (start->v < 0 || end->v < start->v || end->v > a->packed_size()) {
+    t.raise_error(thread_error_t::e_bad_array_bounds);
+    return;
+  }
+  const int32_t size = end->v - start->v;
+  value_t *out = t.gc().new_packed(a->type(), size);
+  elements_copy(out, 0, a, start->v, size);
+  t.get_stack().push(out);
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// numeric array builtins
+//
+// float32 arrays are handed to the simd kernels while other packed and plain
+// arrays take the scalar path through element_get() and element_set().
+
+static bool is_float32(const value_t *a) {
+  return a && a->is_a<val_type_float32_array>();
+}
+
+// reduce an array of numbers with a double accumulator
+template <typename func_t>
+static bool elements_reduce(const value_t *a, func_t func) {
+  const int32_t size = elements(a);
+  if (size < 0) {
+    return false;
+  }
+  for (int32_t i = 0; i < size; ++i) {
+    double v = 0.0;
+    if (!element_get(a, i, v)) {
+      return false;
+    }
+    func(i, v);
+  }
+  return true;
+}
+
+// apply an update to every element of a packed array
+template <typename func_t>
+static void elements_update(value_t *a, func_t func) {
+  for (int32_t i = 0; i < a->packed_size(); ++i) {
+    double v = 0.0;
+    element_get(a, i, v);
+    element_set(a, i, func(i, v));
+  }
+}
+
+static void builtin_array_sum(struct nano::thread_t &t, int32_t nargs) {
+  (void)nargs;
+  const nano::value_t *a = t.get_stack().pop();
+  if (is_float32(a)) {
+    const float res = simd_kernels().sum(a->float32_array(), a->packed_size());
+    t.get_stack().push_float(res);
+    return;
+  }
+  double res = 0.0;
+  if (!elements_reduce(a, [&](int32_t, double v) { res += v; })) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    return;
+  }
+  t.get_stack().push_float(float(res));
+}
+
+static void builtin_array_dot(struct nano::thread_t &t, int32_t nargs) {
+  (void)nargs;
+  const nano::value_t *b = t.get_stack().pop();
+  const nano::value_t *a = t.get_stack().pop();
+  const int32_t size = elements(a);
+  if (size < 0 || size != elements(b)) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    return;
+  }
+  if (is_float32(a) && is_float32(b)) {
+    const float res = simd_kernels().dot(a->float32_array(),
+                                         b->float32_array(), size);
+    t.get_stack().push_float(res);
+    return;
+  }
+  double res = 0.0;
+  bool numbers = true;
+  const bool ok = elements_reduce(a, [&](int32_t i, double v) {
+    double w = 0.0;
+    numbers &= element_get(b, i, w);
+    res += v * w;
+  });
+  if (!ok || !numbers) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    return;
+  }
+  t.get_stack().push_float(float(res));
+}
+
+// find the smallest or largest element and its index
+template <bool is_max>
+static bool elements_extreme(const value_t *a, int32_t &index, float &out) {
+  const int32_t size = elements(a);
+  if (size <= 0) {
+    return false;
+  }
+  if (is_float32(a)) {
+    const float *data = a->float32_array();
+    out = is_max ? simd_kernels().max(data, size) :
+                   simd_kernels().min(data, size);
+    index = 0;
+    for (int32_t i = 0; i < size; ++i) {
+      if (data[i] == out) {
+        index = i;
+        break;
+      }
+    }
+    return true;
+  }
+  double best = 0.0;
+  index = -1;
+  const bool ok = elements_reduce(a, [&](int32_t i, double v) {
+    if (index < 0 || (is_max ? v > best : v < best)) {
+      best = v;
+      index = i;
+    }
+  });
+  out = float(best);
+  return ok;
+}
+
+template <bool is_max>
+static void builtin_array_extreme(struct nano::thread_t &t, int32_t nargs) {
+  (void)nargs;
+  const nano::value_t *a = t.get_stack().pop();
+  int32_t index = 0;
+  float res = 0.f;
+  if (!elements_extreme<is_max>(a, index, res)) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    return;
+  }
+  t.get_stack().push_float(res);
+}
+
+static void builtin_array_argmax(struct nano::thread_t &t, int32_t nargs) {
+  (void)nargs;
+  const nano::value_t *a = t.get_stack().pop();
+  int32_t index = 0;
+  float res = 0.f;
+  if (!elements_extreme<true>(a, index, res)) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    return;
+  }
+  t.get_stack().push_int(index);
+}
+
+// array_axpy(alpha, x, y) computing y = y + alpha * x
+static void builtin_array_axpy(struct nano::thread_t &t, int32_t nargs) {
+  (void)nargs;
+  nano::value_t *y = t.get_stack().pop();
+  const nano::value_t *x = t.get_stack().pop();
+  const nano::value_t *alpha = t.get_stack().pop();
+  if (!is_packed(y) || !is_number(alpha) ||
+      elements(x) != y->packed_size()) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    return;
+  }
+  const float s = alpha->as_float();
+  if (is_float32(x) && is_float32(y)) {
+    simd_kernels().axpy(s, x->float32_array(), y->float32_array(),
+                        y->packed_size());
+    t.get_stack().push(y);
+    return;
+  }
+  if (!elements_reduce(x, [](int32_t, double) {})) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    return;
+  }
+  elements_update(y, [&](int32_t i, double v) {
+    double w = 0.0;
+    element_get(x, i, w);
+    return v + s * w;
+  });
+  t.get_stack().push(y);
+}
+
+// array_scale(a, s) computing a = a * s
+static void builtin_array_scale(struct nano::thread_t &t, int32_t nargs) {
+  (void)nargs;
+  const nano::value_t *s = t.get_stack().pop();
+  nano::value_t *a = t.get_stack().pop();
+  if (!is_packed(a) || !is_number(s)) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    return;
+  }
+  const float f = s->as_float();
+  if (is_float32(a)) {
+    simd_kernels().scale(a->float32_array(), f, a->packed_size());
+  }
+  else {
+    elements_update(a, [&](int32_t, double v) { return v * f; });
+  }
+  t.get_stack().push(a);
+}
+
+// array_clamp(a, lo, hi) limiting every element to [lo, hi]
+static void builtin_array_clamp(struct nano::thread_t &t, int32_t nargs) {
+  (void)nargs;
+  const nano::value_t *hi = t.get_stack().pop();
+  const nano::value_t *lo = t.get_stack().pop();
+  nano::value_t *a = t.get_stack().pop();
+  if (!is_packed(a) || !is_number(lo) || !is_number(hi)) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    return;
+  }
+  const float l = lo->as_float();
+  const float h = hi->as_float();
+  if (is_float32(a)) {
+    simd_kernels().clamp(a->float32_array(), l, h, a->packed_size());
+  }
+  else {
+    elements_update(a, [&](int32_t, double v) {
+      v = v > l ? v : l;
+      return v < h ? v : h;
+    });
+  }
+  t.get_stack().push(a);
+}
+
+// element wise a = a + b or a = a * b
+template <bool is_mul>
+static void builtin_array_binary(struct nano::thread_t &t, int32_t nargs) {
+  (void)nargs;
+  const nano::value_t *b = t.get_stack().pop();
+  nano::value_t *a = t.get_stack().pop();
+  if (!is_packed(a) || elements(b) != a->packed_size()) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    return;
+  }
+  if (is_float32(a) && is_float32(b)) {
+    const auto kernel = is_mul ? simd_kernels().mul : simd_kernels().add;
+    kernel(a->float32_array(), b->float32_array(), a->packed_size());
+    t.get_stack().push(a);
+    return;
+  }
+  if (!elements_reduce(b, [](int32_t, double) {})) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    return;
+  }
+  elements_update(a, [&](int32_t i, double v) {
+    double w = 0.0;
+    element_get(b, i, w);
+    return is_mul ? v * w : v + w;
+  });
+  t.get_stack().push(a);
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// maps
+
+static void builtin_new_map(struct nano::thread_t &t, int32_t nargs) {
+  (void)nargs;
+  t.get_stack().push(t.gc().new_map());
+}
+
+// map_has(map, key)
+static void builtin_map_has(struct nano::thread_t &t, int32_t nargs) {
+  (void)nargs;
+  const nano::value_t *key = t.get_stack().pop();
+  const nano::value_t *map = t.get_stack().pop();
+  if (!is_map(map) || !value_gc_t::map_key_valid(key)) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    return;
+  }
+  bool found = false;
+  t.gc().map_get(map, key, found);
+  t.get_stack().push_int(found ? 1 : 0);
+}
+
+// map_remove(map, key) returning 1 if the key was present
+static void builtin_map_remove(struct nano::thread_t &t, int32_t nargs) {
+  (void)nargs;
+  const nano::value_t *key = t.get_stack().pop();
+  nano::value_t *map = t.get_stack().pop();
+  if (!is_map(map) || !value_gc_t::map_key_valid(key)) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    return;
+  }
+  t.get_stack().push_int(t.gc().map_remove(map, key) ? 1 : 0);
+}
+
+// return an array of the keys or values of a map, or none if it is empty
+template <bool keys>
+static void builtin_map_items(struct nano::thread_t &t, int32_t nargs) {
+  (void)nargs;
+  const nano::value_t *map = t.get_stack().pop();
+  if (!is_map(map)) {
+    t.raise_error(thread_error_t::e_bad_argument);
+    return;
+  }
+  const map_t *m = map->map();
+  if (m->count == 0) {
+    t.get_stack().push_none();
+    return;
+  }
+  value_t *out = t.gc().new_array(m->count);
+  int32_t j = 0;
+  for (int32_t i = 0; i < m->table->capacity; ++i) {
+    const map_slot_t &s = m->table->slots()[i];
+    if (s.state == map_slot_t::full) {
+      // keys are copied so they can not be changed from outside the map
+      out->array()[j++] = keys ? t.gc().copy(*s.key) : s.value;
+    }
+  }
+  assert(j == m->count);
+  t.get_stack().push(out);
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// compile time evaluators
+//
+// these must exactly match the runtime behaviour of the builtins above and
+// should return false whenever the builtin would raise an error.
+
+static bool const_abs(const std::vector<const_value_t> &args, const_value_t &out) {
+  const const_value_t &v = args[0];
+  switch (v.type) {
+  case const_value_t::e_int:
+    out = const_value_t::from_int((v.i < 0) ? (-v.i) : (v.i));
+    return true;
+  case const_value_t::e_float:
+    out = const_value_t::from_float((v.f < 0.f) ? (-v.f) : (v.f));
+    return true;
+  default:
+    return false;
+  }
+}
+
+static bool const_max(const std::vector<const_value_t> &args, const_value_t &out) {
+  // note: arguments are on the stack in reverse
+  const const_value_t &a = args[1];
+  const const_value_t &b = args[0];
+  if (a.is_number() && b.is_number()) {
+    const float af = a.as_float();
+    const float bf = b.as_float();
+    out = const_value_t::from_float(af > bf ? af : bf);
+    return true;
+  }
+  return false;
+}
+
+static bool const_min(const std::vector<const_value_t> &args, const_value_t &out) {
+  // note: arguments are on the stack in reverse
+  const const_value_t &a = args[1];
+  const const_value_t &b = args[0];
+  if (a.is_number() && b.is_number()) {
+    const float af = a.as_float();
+    const float bf = b.as_float();
+    out = const_value_t::from_float(af < bf ? af : bf);
+    return true;
+  }
+  return false;
+}
+
+static bool const_bitand(const std::vector<const_value_t> &args, const_value_t &out) {
+  const const_value_t &a = args[0];
+  const const_value_t &b = args[1];
+  if (a.type == const_value_t::e_int && b.type == const_value_t::e_int) {
+    out = const_value_t::from_int(a.i & b.i);
+    return true;
+  }
+  return false;
+}
+
+static bool const_len(const std::vector<const_value_t> &args, const_value_t &out) {
+  const const_value_t &a = args[0];
+  if (a.type == const_value_t::e_string) {
+    out = const_value_t::from_int(int32_t(a.s.size()));
+    return true;
+  }
+  return false;
+}
+
+static bool const_chr(const std::vector<const_value_t> &args, const_value_t &out) {
+  const const_value_t &v = args[0];
+  if (v.type == const_value_t::e_int) {
+    char x[2] = {char(v.i), 0};
+    out = const_value_t::from_string(std::string(x));
+    return true;
+  }
+  return false;
+}
+
+// evaluate a float -> float math builtin
+template <float (*func)(float)>
+static bool const_math(const std::vector<const_value_t> &args, const_value_t &out) {
+  const const_value_t &v = args[0];
+  if (v.is_number()) {
+    out = const_value_t::from_float(func(v.as_float()));
+    return true;
+  }
+  return false;
+}
+
 void builtins_register(nano_t &nano) {
 
-  nano.syscall_register("abs", 1);
-  nano.syscall_register("min", 2);
-  nano.syscall_register("max", 2);
+  nano.syscall_register("abs", 1, const_abs);
+  nano.syscall_register("min", 2, const_min);
+  nano.syscall_register("max", 2, const_max);
 
-  nano.syscall_register("bitand", 2);
+  nano.syscall_register("bitand", 2, const_bitand);
 
-  nano.syscall_register("sin", 1);
-  nano.syscall_register("cos", 1);
-  nano.syscall_register("tan", 1);
+  nano.syscall_register("sin", 1, const_math<sinf>);
+  nano.syscall_register("cos", 1, const_math<cosf>);
+  nano.syscall_register("tan", 1, const_math<tanf>);
 
-  nano.syscall_register("len", 1);
-  nano.syscall_register("chr", 1);
+  nano.syscall_register("len", 1, const_len);
+  nano.syscall_register("chr", 1, const_chr);
 
-  nano.syscall_register("round", 1);
-  nano.syscall_register("ceil",  1);
-  nano.syscall_register("floor", 1);
+  nano.syscall_register("round", 1, const_math<roundf>);
+  nano.syscall_register("ceil",  1, const_math<ceilf>);
+  nano.syscall_register("floor", 1, const_math<floorf>);
 
-  nano.syscall_register("sqrt", 1);
+  nano.syscall_register("sqrt", 1, const_math<sqrtf>);
 
   nano.syscall_register("new_thread", -1);
   nano.syscall_register("wait", 1);
 
   nano.syscall_register("new_array", 1);
+
+  nano.syscall_register("new_int32_array", 1);
+  nano.syscall_register("new_float32_array", 1);
+  nano.syscall_register("new_uint8_array", 1);
+  nano.syscall_register("to_int32_array", 1);
+  nano.syscall_register("to_float32_array", 1);
+  nano.syscall_register("to_uint8_array", 1);
+  nano.syscall_register("to_array", 1);
+  nano.syscall_register("array_fill", 2);
+  nano.syscall_register("array_copy", 3);
+  nano.syscall_register("array_slice", 3);
+
+  nano.syscall_register("array_sum", 1);
+  nano.syscall_register("array_dot", 2);
+  nano.syscall_register("array_min", 1);
+  nano.syscall_register("array_max", 1);
+  nano.syscall_register("array_argmax", 1);
+  nano.syscall_register("array_axpy", 3);
+  nano.syscall_register("array_scale", 2);
+  nano.syscall_register("array_clamp", 3);
+  nano.syscall_register("array_add", 2);
+  nano.syscall_register("array_mul", 2);
+
+  nano.syscall_register("new_map", 0);
+  nano.syscall_register("map_has", 2);
+  nano.syscall_register("map_remove", 2);
+  nano.syscall_register("map_keys", 1);
+  nano.syscall_register("map_values", 1);
 }
 
 void builtins_resolve(program_t &prog) {
@@ -297,6 +956,34 @@ void builtins_resolve(program_t &prog) {
 
   map["new_array"] = builtin_new_array;
 
+  map["new_int32_array"]   = builtin_new_packed<val_type_int32_array>;
+  map["new_float32_array"] = builtin_new_packed<val_type_float32_array>;
+  map["new_uint8_array"]   = builtin_new_packed<val_type_uint8_array>;
+  map["to_int32_array"]    = builtin_to_packed<val_type_int32_array>;
+  map["to_float32_array"]  = builtin_to_packed<val_type_float32_array>;
+  map["to_uint8_array"]    = builtin_to_packed<val_type_uint8_array>;
+  map["to_array"]          = builtin_to_array;
+  map["array_fill"]        = builtin_array_fill;
+  map["array_copy"]        = builtin_array_copy;
+  map["array_slice"]       = builtin_array_slice;
+
+  map["array_sum"]    = builtin_array_sum;
+  map["array_dot"]    = builtin_array_dot;
+  map["array_min"]    = builtin_array_extreme<false>;
+  map["array_max"]    = builtin_array_extreme<true>;
+  map["array_argmax"] = builtin_array_argmax;
+  map["array_axpy"]   = builtin_array_axpy;
+  map["array_scale"]  = builtin_array_scale;
+  map["array_clamp"]  = builtin_array_clamp;
+  map["array_add"]    = builtin_array_binary<false>;
+  map["array_mul"]    = builtin_array_binary<true>;
+
+  map["new_map"]    = builtin_new_map;
+  map["map_has"]    = builtin_map_has;
+  map["map_remove"] = builtin_map_remove;
+  map["map_keys"]   = builtin_map_items<true>;
+  map["map_values"] = builtin_map_items<false>;
+
   for (auto &itt : prog.syscalls()) {
     auto i = map.find(itt.name_);
     if (i != map.end()) {
@@ -0,0 +1,386 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "simd.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define NANO_SIMD_SSE 1
+#include <emmintrin.h>
+#endif
+
+// avx2 kernels need per function target attributes and cpu detection
+#if NANO_SIMD_SSE && (defined(__GNUC__) || defined(__clang__))
+#define NANO_SIMD_AVX2 1
+#include <immintrin.h>
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+
+namespace {
+
+using namespace nano;
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// scalar
+
+float scalar_sum(const float *a, size_t n) {
+  float out = 0.f;
+  for (size_t i = 0; i < n; ++i) {
+    out += a[i];
+  }
+  return out;
+}
+
+float scalar_dot(const float *a, const float *b, size_t n) {
+  float out = 0.f;
+  for (size_t i = 0; i < n; ++i) {
+    out += a[i] * b[i];
+  }
+  return out;
+}
+
+float scalar_min(const float *a, size_t n) {
+  float out = a[0];
+  for (size_t i = 1; i < n; ++i) {
+    out = a[i] < out ? a[i] : out;
+  }
+  return out;
+}
+
+float scalar_max(const float *a, size_t n) {
+  float out = a[0];
+  for (size_t i = 1; i < n; ++i) {
+    out = a[i] > out ? a[i] : out;
+  }
+  return out;
+}
+
+void scalar_axpy(float alpha, const float *x, float *y, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    y[i] += alpha * x[i];
+  }
+}
+
+void scalar_scale(float *a, float s, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    a[i] *= s;
+  }
+}
+
+void scalar_clamp(float *a, float lo, float hi, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    const float x = a[i] > lo ? a[i] : lo;
+    a[i] = x < hi ? x : hi;
+  }
+}
+
+void scalar_add(float *a, const float *b, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    a[i] += b[i];
+  }
+}
+
+void scalar_mul(float *a, const float *b, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    a[i] *= b[i];
+  }
+}
+
+const simd_kernels_t kernels_scalar = {
+  "scalar",
+  scalar_sum, scalar_dot, scalar_min, scalar_max,
+  scalar_axpy, scalar_scale, scalar_clamp, scalar_add, scalar_mul,
+};
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// sse
+//
+// note: loads and stores are unaligned as heap values are only byte aligned
+
+#if NANO_SIMD_SSE
+float sse_hsum(__m128 v) {
+  float lanes[4];
+  _mm_storeu_ps(lanes, v);
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+float sse_sum(const float *a, size_t n) {
+  __m128 acc = _mm_setzero_ps();
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    acc = _mm_add_ps(acc, _mm_loadu_ps(a + i));
+  }
+  return sse_hsum(acc) + scalar_sum(a + i, n - i);
+}
+
+float sse_dot(const float *a, const float *b, size_t n) {
+  __m128 acc = _mm_setzero_ps();
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m128 v = _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+    acc = _mm_add_ps(acc, v);
+  }
+  return sse_hsum(acc) + scalar_dot(a + i, b + i, n - i);
+}
+
+float sse_min(const float *a, size_t n) {
+  if (n < 4) {
+    return scalar_min(a, n);
+  }
+  __m128 acc = _mm_loadu_ps(a);
+  size_t i = 4;
+  for (; i + 4 <= n; i += 4) {
+    acc = _mm_min_ps(acc, _mm_loadu_ps(a + i));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, acc);
+  const float out = scalar_min(lanes, 4);
+  if (i == n) {
+    return out;
+  }
+  const float tail = scalar_min(a + i, n - i);
+  return tail < out ? tail : out;
+}
+
+float sse_max(const float *a, size_t n) {
+  if (n < 4) {
+    return scalar_max(a, n);
+  }
+  __m128 acc = _mm_loadu_ps(a);
+  size_t i = 4;
+  for (; i + 4 <= n; i += 4) {
+    acc = _mm_max_ps(acc, _mm_loadu_ps(a + i));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, acc);
+  const float out = scalar_max(lanes, 4);
+  if (i == n) {
+    return out;
+  }
+  const float tail = scalar_max(a + i, n - i);
+  return tail > out ? tail : out;
+}
+
+void sse_axpy(float alpha, const float *x, float *y, size_t n) {
+  const __m128 s = _mm_set1_ps(alpha);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m128 v = _mm_mul_ps(s, _mm_loadu_ps(x + i));
+    _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), v));
+  }
+  scalar_axpy(alpha, x + i, y + i, n - i);
+}
+
+void sse_scale(float *a, float s, size_t n) {
+  const __m128 v = _mm_set1_ps(s);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(a + i, _mm_mul_ps(_mm_loadu_ps(a + i), v));
+  }
+  scalar_scale(a + i, s, n - i);
+}
+
+void sse_clamp(float *a, float lo, float hi, size_t n) {
+  const __m128 l = _mm_set1_ps(lo);
+  const __m128 h = _mm_set1_ps(hi);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m128 v = _mm_max_ps(_mm_loadu_ps(a + i), l);
+    _mm_storeu_ps(a + i, _mm_min_ps(v, h));
+  }
+  scalar_clamp(a + i, lo, hi, n - i);
+}
+
+void sse_add(float *a, const float *b, size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m128 v = _mm_add_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+    _mm_storeu_ps(a + i, v);
+  }
+  scalar_add(a + i, b + i, n - i);
+}
+
+void sse_mul(float *a, const float *b, size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m128 v = _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+    _mm_storeu_ps(a + i, v);
+  }
+  scalar_mul(a + i, b + i, n - i);
+}
+
+const simd_kernels_t kernels_sse = {
+  "sse",
+  sse_sum, sse_dot, sse_min, sse_max,
+  sse_axpy, sse_scale, sse_clamp, sse_add, sse_mul,
+};
+#endif  // NANO_SIMD_SSE
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// avx2
+
+#if NANO_SIMD_AVX2
+TARGET_AVX2
+float avx2_hsum(__m256 v) {
+  float lanes[8];
+  _mm256_storeu_ps(lanes, v);
+  return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) +
+         ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+
+TARGET_AVX2
+float avx2_sum(const float *a, size_t n) {
+  // two accumulators to hide the add latency
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    acc0 = _mm256_add_ps(acc0, _mm256_loadu_ps(a + i));
+    acc1 = _mm256_add_ps(acc1, _mm256_loadu_ps(a + i + 8));
+  }
+  return avx2_hsum(_mm256_add_ps(acc0, acc1)) + sse_sum(a + i, n - i);
+}
+
+TARGET_AVX2
+float avx2_dot(const float *a, const float *b, size_t n) {
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a + i),
+                                             _mm256_loadu_ps(b + i)));
+    acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8),
+                                             _mm256_loadu_ps(b + i + 8)));
+  }
+  return avx2_hsum(_mm256_add_ps(acc0, acc1)) + sse_dot(a + i, b + i, n - i);
+}
+
+TARGET_AVX2
+float avx2_min(const float *a, size_t n) {
+  if (n < 8) {
+    return sse_min(a, n);
+  }
+  __m256 acc = _mm256_loadu_ps(a);
+  size_t i = 8;
+  for (; i + 8 <= n; i += 8) {
+    acc = _mm256_min_ps(acc, _mm256_loadu_ps(a + i));
+  }
+  float lanes[8];
+  _mm256_storeu_ps(lanes, acc);
+  const float out = scalar_min(lanes, 8);
+  if (i == n) {
+    return out;
+  }
+  const float tail = sse_min(a + i, n - i);
+  return tail < out ? tail : out;
+}
+
+TARGET_AVX2
+float avx2_max(const float *a, size_t n) {
+  if (n < 8) {
+    return sse_max(a, n);
+  }
+  __m256 acc = _mm256_loadu_ps(a);
+  size_t i = 8;
+  for (; i + 8 <= n; i += 8) {
+    acc = _mm256_max_ps(acc, _mm256_loadu_ps(a + i));
+  }
+  float lanes[8];
+  _mm256_storeu_ps(lanes, acc);
+  const float out = scalar_max(lanes, 8);
+  if (i == n) {
+    return out;
+  }
+  const float tail = sse_max(a + i, n - i);
+  return tail > out ? tail : out;
+}
+
+TARGET_AVX2
+void avx2_axpy(float alpha, const float *x, float *y, size_t n) {
+  const __m256 s = _mm256_set1_ps(alpha);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 v = _mm256_mul_ps(s, _mm256_loadu_ps(x + i));
+    _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), v));
+  }
+  scalar_axpy(alpha, x + i, y + i, n - i);
+}
+
+TARGET_AVX2
+void avx2_scale(float *a, float s, size_t n) {
+  const __m256 v = _mm256_set1_ps(s);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(a + i, _mm256_mul_ps(_mm256_loadu_ps(a + i), v));
+  }
+  scalar_scale(a + i, s, n - i);
+}
+
+TARGET_AVX2
+void avx2_clamp(float *a, float lo, float hi, size_t n) {
+  const __m256 l = _mm256_set1_ps(lo);
+  const __m256 h = _mm256_set1_ps(hi);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 v = _mm256_max_ps(_mm256_loadu_ps(a + i), l);
+    _mm256_storeu_ps(a + i, _mm256_min_ps(v, h));
+  }
+  scalar_clamp(a + i, lo, hi, n - i);
+}
+
+TARGET_AVX2
+void avx2_add(float *a, const float *b, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 v = _mm256_add_ps(_mm256_loadu_ps(a + i),
+                                   _mm256_loadu_ps(b + i));
+    _mm256_storeu_ps(a + i, v);
+  }
+  scalar_add(a + i, b + i, n - i);
+}
+
+TARGET_AVX2
+void avx2_mul(float *a, const float *b, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 v = _mm256_mul_ps(_mm256_loadu_ps(a + i),
+                                   _mm256_loadu_ps(b + i));
+    _mm256_storeu_ps(a + i, v);
+  }
+  scalar_mul(a + i, b + i, n - i);
+}
+
+const simd_kernels_t kernels_avx2 = {
+  "avx2",
+  avx2_sum, avx2_dot, avx2_min, avx2_max,
+  avx2_axpy, avx2_scale, avx2_clamp, avx2_add, avx2_mul,
+};
+#endif  // NANO_SIMD_AVX2
+
+const simd_kernels_t &select() {
+  const char *force = getenv("NANO_SIMD");
+  const bool any = force == nullptr;
+#if NANO_SIMD_AVX2
+  if ((any || strcmp(force, "avx2") == 0) && __builtin_cpu_supports("avx2")) {
+    return kernels_avx2;
+  }
+#endif
+#if NANO_SIMD_SSE
+  if (any || strcmp(force, "sse") == 0 || strcmp(force, "avx2") == 0) {
+    return kernels_sse;
+  }
+#endif
+  return kernels_scalar;
+}
+
+} // namespace {}
+
+namespace nano {
+
+const simd_kernels_t &simd_kernels() {
+  // note: thread safe initialisation as a function local static
+  static const simd_kernels_t &kernels = select();
+  return kernels;
+}
+
+} // namespace nano
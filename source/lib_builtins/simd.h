@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+
+
+namespace nano {
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+//
+// float32 kernels used by the numeric array builtins
+//
+// the best implementation for the host cpu is chosen the first time
+// simd_kernels() is called.  the NANO_SIMD environment variable can be set
+// to 'scalar', 'sse' or 'avx2' to force a lower level.
+//
+struct simd_kernels_t {
+
+  const char *name;
+
+  float (*sum)(const float *a, size_t n);
+  float (*dot)(const float *a, const float *b, size_t n);
+
+  // smallest and largest element, n must be > 0
+  float (*min)(const float *a, size_t n);
+  float (*max)(const float *a, size_t n);
+
+  // y = y + alpha * x
+  void (*axpy)(float alpha, const float *x, float *y, size_t n);
+  // a = a * s
+  void (*scale)(float *a, float s, size_t n);
+  // a = min(max(a, lo), hi)
+  void (*clamp)(float *a, float lo, float hi, size_t n);
+  // a = a + b
+  void (*add)(float *a, const float *b, size_t n);
+  // a = a * b
+  void (*mul)(float *a, const float *b, size_t n);
+};
+
+const simd_kernels_t &simd_kernels();
+
+} // namespace nano
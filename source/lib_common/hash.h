@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace nano {
+
+// 64bit FNV-1a hash
+struct hash_t {
+
+  hash_t()
+    : value(0xcbf29ce484222325ull)
+  {}
+
+  void add(const void *data, size_t size) {
+    const uint8_t *p = (const uint8_t *)data;
+    for (size_t i = 0; i < size; ++i) {
+      value = (value ^ p[i]) * 0x100000001b3ull;
+    }
+  }
+
+  void add(const std::string &s) {
+    add(int32_t(s.size()));
+    add(s.data(), s.size());
+  }
+
+  void add(int32_t v) {
+    add(&v, sizeof(v));
+  }
+
+  uint64_t value;
+};
+
+} // namespace nano
@@ -0,0 +1,361 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "image.h"
+#include "program.h"
+
+#define TRY(X) { if (!(X)) { return false; } }
+
+
+namespace {
+
+using namespace nano;
+using namespace nano::image;
+
+size_t align_up(size_t x) {
+  return (x + image::align - 1) & ~size_t(image::align - 1);
+}
+
+// accumulates the sections of an image before they are written out
+struct writer_t {
+
+  writer_t() {
+    // the first pool entry is the empty string
+    pool_.push_back('\0');
+  }
+
+  ref_t intern(const std::string &s) {
+    auto itt = interned_.find(s);
+    if (itt != interned_.end()) {
+      return itt->second;
+    }
+    const ref_t ref = {uint32_t(pool_.size()), uint32_t(s.size())};
+    pool_.insert(pool_.end(), s.begin(), s.end());
+    pool_.push_back('\0');
+    interned_[s] = ref;
+    return ref;
+  }
+
+  template <typename type_t>
+  void add(uint32_t id, const std::vector<type_t> &items) {
+    add(id, uint32_t(items.size()), items.data(), items.size() * sizeof(type_t));
+  }
+
+  void add(uint32_t id, uint32_t count, const void *data, size_t size) {
+    section_t s;
+    s.id = id;
+    s.count = count;
+    s.offset = 0;
+    s.size = size;
+    sections_.push_back(s);
+    const uint8_t *p = (const uint8_t *)data;
+    blobs_.emplace_back(p, p + size);
+  }
+
+  bool write(FILE *fd) {
+    add(sec_pool, 0, pool_.data(), pool_.size());
+    // lay out the sections after the directory
+    header_t h;
+    memset(&h, 0, sizeof(h));
+    h.magic = image::magic;
+    h.version_major = image::version_major;
+    h.version_minor = image::version_minor;
+    h.header_size = sizeof(header_t);
+    h.num_sections = uint32_t(sections_.size());
+    size_t offset = align_up(sizeof(header_t) +
+                             sections_.size() * sizeof(section_t));
+    for (section_t &s : sections_) {
+      s.offset = offset;
+      offset = align_up(offset + size_t(s.size));
+    }
+    h.file_size = offset;
+    // write everything out
+    std::vector<uint8_t> out(offset, 0);
+    memcpy(out.data(), &h, sizeof(h));
+    memcpy(out.data() + sizeof(h), sections_.data(),
+           sections_.size() * sizeof(section_t));
+    for (size_t i = 0; i < sections_.size(); ++i) {
+      if (!blobs_[i].empty()) {
+        memcpy(out.data() + sections_[i].offset, blobs_[i].data(),
+               blobs_[i].size());
+      }
+    }
+    return fwrite(out.data(), 1, out.size(), fd) == out.size();
+  }
+
+protected:
+  std::vector<char> pool_;
+  std::map<std::string, ref_t> interned_;
+  std::vector<section_t> sections_;
+  std::vector<std::vector<uint8_t>> blobs_;
+};
+
+// typed access to a validated section
+template <typename type_t>
+const type_t *view(const mapping_t &m, uint32_t id, size_t &count) {
+  const section_t *s = m.find(id, sizeof(type_t));
+  if (!s) {
+    count = 0;
+    return nullptr;
+  }
+  count = s->count;
+  return (const type_t *)(m.data() + s->offset);
+}
+
+} // namespace {}
+
+namespace nano {
+namespace image {
+
+bool mapping_t::open(const char *path) {
+  close();
+#if defined(_WIN32)
+  // no mmap so read the image into memory instead
+  FILE *fd = fopen(path, "rb");
+  if (!fd) {
+    return false;
+  }
+  fseek(fd, 0, SEEK_END);
+  const long size = ftell(fd);
+  fseek(fd, 0, SEEK_SET);
+  if (size <= 0) {
+    fclose(fd);
+    return false;
+  }
+  uint8_t *data = new uint8_t[size];
+  const size_t read = fread(data, 1, size_t(size), fd);
+  fclose(fd);
+  if (read != size_t(size)) {
+    delete[] data;
+    return false;
+  }
+  data_ = data;
+  size_ = size_t(size);
+  mapped_ = false;
+#else
+  const int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    ::close(fd);
+    return false;
+  }
+  void *data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  data_ = (const uint8_t *)data;
+  size_ = size_t(st.st_size);
+  mapped_ = true;
+#endif
+  return true;
+}
+
+void mapping_t::close() {
+  if (!data_) {
+    return;
+  }
+#if !defined(_WIN32)
+  if (mapped_) {
+    munmap((void *)data_, size_);
+  }
+#endif
+  if (!mapped_) {
+    delete[] data_;
+  }
+  data_ = nullptr;
+  size_ = 0;
+  mapped_ = false;
+}
+
+const section_t *mapping_t::find(uint32_t id, size_t elem_size) const {
+  const header_t *h = (const header_t *)data_;
+  const section_t *dir = (const section_t *)(data_ + h->header_size);
+  for (uint32_t i = 0; i < h->num_sections; ++i) {
+    const section_t &s = dir[i];
+    if (s.id != id) {
+      continue;
+    }
+    // the section must lie inside the image and be aligned
+    if (s.offset % image::align || s.offset > size_ ||
+        s.size > size_ - s.offset) {
+      return nullptr;
+    }
+    if (elem_size > 1 && uint64_t(s.count) * elem_size != s.size) {
+      return nullptr;
+    }
+    return &s;
+  }
+  return nullptr;
+}
+
+} // namespace image
+
+bool program_t::image_save(const char *path) const {
+  using namespace image;
+  writer_t w;
+  // code
+  w.add(sec_code, 0, data(), size());
+  // line table
+  {
+    // the line index is sorted by pc and only holds the start of each line
+    const std::vector<line_entry_t> lines(lines_begin_(), lines_end_());
+    w.add(sec_lines, lines);
+  }
+  // strings
+  {
+    std::vector<ref_t> refs;
+    for (const std::string &s : strings_) {
+      refs.push_back(w.intern(s));
+    }
+    w.add(sec_strings, refs);
+  }
+  // syscalls
+  {
+    std::vector<ref_t> refs;
+    for (const syscall_entry_t &s : syscalls_) {
+      refs.push_back(w.intern(s.name_));
+    }
+    w.add(sec_syscalls, refs);
+  }
+  // globals
+  {
+    std::vector<ident_t> globals;
+    for (const identifier_t &g : globals_) {
+      globals.push_back(ident_t{w.intern(g.name_), g.offset_});
+    }
+    w.add(sec_globals, globals);
+  }
+  // functions and their locals and arguments
+  {
+    std::vector<func_t> funcs;
+    std::vector<ident_t> idents;
+    for (const function_t &f : functions_) {
+      func_t out;
+      out.name = w.intern(f.name_);
+      out.code_start = f.code_start_;
+      out.code_end = f.code_end_;
+      out.locals_start = uint32_t(idents.size());
+      out.locals_count = uint32_t(f.locals_.size());
+      for (const identifier_t &i : f.locals_) {
+        idents.push_back(ident_t{w.intern(i.name_), i.offset_});
+      }
+      out.args_start = uint32_t(idents.size());
+      out.args_count = uint32_t(f.args_.size());
+      for (const identifier_t &i : f.args_) {
+        idents.push_back(ident_t{w.intern(i.name_), i.offset_});
+      }
+      funcs.push_back(out);
+    }
+    w.add(sec_functions, funcs);
+    w.add(sec_idents, idents);
+  }
+  // write to disk
+  FILE *fd = fopen(path, "wb");
+  if (!fd) {
+    return false;
+  }
+  const bool ok = w.write(fd);
+  return (fclose(fd) == 0) && ok;
+}
+
+bool program_t::image_load(const char *path) {
+  using namespace image;
+  reset();
+  std::shared_ptr<mapping_t> m = std::make_shared<mapping_t>();
+  TRY(m->open(path));
+  // validate the header
+  TRY(m->size() >= sizeof(header_t));
+  const header_t *h = (const header_t *)m->data();
+  TRY(h->magic == image::magic);
+  TRY(h->version_major == image::version_major);
+  TRY(h->header_size >= sizeof(header_t) && h->header_size % 8 == 0);
+  TRY(h->header_size <= m->size());
+  TRY(h->file_size == m->size());
+  TRY(h->num_sections <= (m->size() - h->header_size) / sizeof(section_t));
+  // string pool
+  const section_t *pool_sec = m->find(sec_pool, 1);
+  TRY(pool_sec && pool_sec->size > 0);
+  const char *pool = (const char *)(m->data() + pool_sec->offset);
+  const uint64_t pool_size = pool_sec->size;
+  auto str = [&](const ref_t &r, std::string &out) -> bool {
+    TRY(uint64_t(r.offset) + r.size < pool_size);
+    out.assign(pool + r.offset, r.size);
+    return true;
+  };
+  size_t count = 0;
+  // code is executed in place
+  const section_t *code_sec = m->find(sec_code, 1);
+  TRY(code_sec);
+  // line table is searched in place
+  const line_entry_t *lines = view<line_entry_t>(*m, sec_lines, count);
+  TRY(lines || count == 0);
+  const size_t num_lines = count;
+  // strings
+  const ref_t *strings = view<ref_t>(*m, sec_strings, count);
+  strings_.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    TRY(str(strings[i], strings_[i]));
+  }
+  // syscalls
+  const ref_t *syscalls = view<ref_t>(*m, sec_syscalls, count);
+  syscalls_.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    syscalls_[i].call_ = nullptr;
+    TRY(str(syscalls[i], syscalls_[i].name_));
+  }
+  // globals
+  const ident_t *globals = view<ident_t>(*m, sec_globals, count);
+  globals_.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    TRY(str(globals[i].name, globals_[i].name_));
+    globals_[i].offset_ = globals[i].offset;
+  }
+  // functions
+  size_t num_idents = 0;
+  const ident_t *idents = view<ident_t>(*m, sec_idents, num_idents);
+  const func_t *funcs = view<func_t>(*m, sec_functions, count);
+  functions_.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    const func_t &in = funcs[i];
+    function_t &out = functions_[i];
+    TRY(str(in.name, out.name_));
+    TRY(in.code_start >= 0 && in.code_start <= in.code_end);
+    TRY(uint64_t(in.code_end) <= code_sec->size);
+    out.code_start_ = in.code_start;
+    out.code_end_ = in.code_end;
+    TRY(uint64_t(in.locals_start) + in.locals_count <= num_idents);
+    TRY(uint64_t(in.args_start) + in.args_count <= num_idents);
+    out.locals_.resize(in.locals_count);
+    for (uint32_t j = 0; j < in.locals_count; ++j) {
+      TRY(str(idents[in.locals_start + j].name, out.locals_[j].name_));
+      out.locals_[j].offset_ = idents[in.locals_start + j].offset;
+    }
+    out.args_.resize(in.args_count);
+    for (uint32_t j = 0; j < in.args_count; ++j) {
+      TRY(str(idents[in.args_start + j].name, out.args_[j].name_));
+      out.args_[j].offset_ = idents[in.args_start + j].offset;
+    }
+  }
+  // bind to the image
+  image_code_ = m->data() + code_sec->offset;
+  image_code_size_ = size_t(code_sec->size);
+  image_lines_ = lines;
+  image_num_lines_ = num_lines;
+  image_ = m;
+  return true;
+}
+
+} // namespace nano
@@ -0,0 +1,125 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+#include "types.h"
+
+
+namespace nano {
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+//
+// memory mappable program image
+//
+// an image is a header followed by a section directory and a number of
+// sections.  every section is aligned to image_align bytes from the start of
+// the file and all references are file offsets, so an image can be mapped at
+// any address and read in place.
+//
+//    header_t
+//    section_t [num_sections]
+//    ... sections ...
+//
+// all names and strings are stored as image_ref_t into the string pool.
+//
+namespace image {
+
+static const uint32_t magic = (('G' << 24) | ('M' << 16) | ('I' << 8) | ('N'));
+
+// the major version is bumped for incompatible changes
+static const uint16_t version_major = 1;
+static const uint16_t version_minor = 0;
+
+static const uint32_t align = 16;
+
+enum section_id_t : uint32_t {
+  sec_code      = 1,  // uint8_t      [size]
+  sec_lines     = 2,  // line_entry_t [count] sorted by pc
+  sec_pool      = 3,  // char         [size]  nul terminated strings
+  sec_strings   = 4,  // ref_t        [count]
+  sec_syscalls  = 5,  // ref_t        [count]
+  sec_globals   = 6,  // ident_t      [count]
+  sec_functions = 7,  // func_t       [count]
+  sec_idents    = 8,  // ident_t      [count] function locals and arguments
+};
+
+struct header_t {
+  uint32_t magic;
+  uint16_t version_major;
+  uint16_t version_minor;
+  uint32_t header_size;
+  uint32_t num_sections;
+  uint64_t file_size;
+};
+
+struct section_t {
+  uint32_t id;
+  uint32_t count;
+  uint64_t offset;
+  uint64_t size;
+};
+
+// reference into the string pool
+struct ref_t {
+  uint32_t offset;
+  uint32_t size;
+};
+
+using line_entry_t = nano::line_entry_t;
+
+struct ident_t {
+  ref_t name;
+  int32_t offset;
+};
+
+struct func_t {
+  ref_t name;
+  int32_t code_start;
+  int32_t code_end;
+  // ranges in the idents section
+  uint32_t locals_start;
+  uint32_t locals_count;
+  uint32_t args_start;
+  uint32_t args_count;
+};
+
+// a read only view of an image file
+struct mapping_t {
+
+  mapping_t()
+    : data_(nullptr)
+    , size_(0)
+    , mapped_(false)
+  {}
+
+  ~mapping_t() {
+    close();
+  }
+
+  bool open(const char *path);
+  void close();
+
+  const uint8_t *data() const {
+    return data_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  // find a section, checking that it lies inside the image and holds
+  // 'count' elements of 'elem_size' bytes
+  const section_t *find(uint32_t id, size_t elem_size) const;
+
+protected:
+  mapping_t(const mapping_t &) = delete;
+  mapping_t &operator=(const mapping_t &) = delete;
+
+  const uint8_t *data_;
+  size_t size_;
+  // true if data_ came from mmap rather than the heap
+  bool mapped_;
+};
+
+} // namespace image
+} // namespace nano
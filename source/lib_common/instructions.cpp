@@ -1,5 +1,46 @@
+#include <cassert>
+
 #include "instructions.h"
 
+namespace {
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+const char *gMnemonic[] = {
+  // operators
+  "INS_ADD", "INS_SUB", "INS_MUL", "INS_DIV", "INS_MOD", "INS_AND", "INS_OR",
+  // unary operators
+  "INS_NOT", "INS_NEG",
+  // comparators
+  "INS_LT", "INS_GT", "INS_LEQ", "INS_GEQ", "INS_EQ",
+  // branching
+  "INS_JMP", "INS_TJMP", "INS_FJMP", "INS_CALL", "INS_RET", "INS_SCALL",
+  "INS_ICALL",
+  // stack
+  "INS_POP",
+  "INS_NEW_INT", "INS_NEW_STR", "INS_NEW_ARY", "INS_NEW_NONE", "INS_NEW_FLT",
+  "INS_NEW_FUNC", "INS_NEW_SYSCALL", "INS_LOCALS", "INS_GLOBALS",
+  // local variables
+  "INS_GETV", "INS_SETV", "INS_DEREF", "INS_SETA",
+  // global variables
+  "INS_GETG", "INS_SETG",
+  // member access
+  "INS_GETM", "INS_SETM",
+  //
+  "INS_ARY_INIT",
+  // loops
+  "INS_FOR",
+  //
+  "INS_ARY_LOCAL",
+  // debugging
+  "INS_BREAK"
+};
+
+// make sure this is kept up to date with the opcode table 'instruction_e'
+static_assert(sizeof(gMnemonic) / sizeof(const char *) == nano::__INS_COUNT__,
+              "gMnemonic table should match instruction_e enum layout");
+
+} // namespace {}
+
 namespace nano {
 
 bool ins_has_operand(const instruction_e ins) {
@@ -23,12 +64,36 @@ bool ins_has_operand(const instruction_e ins) {
   case INS_GETM:
   case INS_SETM:
   case INS_ARY_INIT:
+  case INS_FOR:
+  case INS_ARY_LOCAL:
+  case INS_NEW_ARY:
+  case INS_NEW_FUNC:
+  case INS_NEW_SCALL:
+  case INS_ICALL:
     return true;
   default:
     return false;
   }
 }
 
+bool ins_has_two_operands(const instruction_e ins) {
+  switch (ins) {
+  case INS_CALL:
+  case INS_SCALL:
+  case INS_FOR:
+    return true;
+  default:
+    return false;
+  }
+}
+
+int32_t ins_size(const instruction_e ins) {
+  if (ins_has_two_operands(ins)) {
+    return 9;
+  }
+  return ins_has_operand(ins) ? 5 : 1;
+}
+
 bool ins_will_branch(const instruction_e ins) {
   switch (ins) {
   case INS_JMP:
@@ -36,6 +101,7 @@ bool ins_will_branch(const instruction_e ins) {
   case INS_TJMP:
   case INS_CALL:
   case INS_RET:
+  case INS_FOR:
     return true;
   default:
     return false;
@@ -72,4 +138,9 @@ bool ins_is_unary_op(const instruction_e ins) {
   }
 }
 
+const char *ins_mnemonic(const instruction_e ins) {
+  assert(ins < __INS_COUNT__);
+  return gMnemonic[ins];
+}
+
 } // namespace nano
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 
 namespace nano {
 
@@ -158,6 +159,22 @@ enum instruction_e {
   //      array[i] = pop()
   INS_ARY_INIT,
 
+  // counted loop step
+  //    end = pop()
+  //    stack[ fp + operand1 ] += 1
+  //    if (stack[ fp + operand1 ] < end)
+  //      pc = operand2
+  INS_FOR,
+
+  // initalize array in the frame scratch region
+  //    for (i = 0 to operand)
+  //      array[i] = pop()
+  INS_ARY_LOCAL,
+
+  // debugger breakpoint, never emitted by the compiler
+  //    patched over the first opcode of a line by vm_t::breakpoint_add()
+  INS_BREAK,
+
   // number of instructions
   __INS_COUNT__,
 };
@@ -165,6 +182,12 @@ enum instruction_e {
 // return true if instruction takes an operand
 bool ins_has_operand(const instruction_e ins);
 
+// return true if instruction takes a second operand
+bool ins_has_two_operands(const instruction_e ins);
+
+// return the encoded size of an instruction in bytes
+int32_t ins_size(const instruction_e ins);
+
 // return true if execution can branch after instruction
 bool ins_will_branch(const instruction_e ins);
 
@@ -174,4 +197,7 @@ bool ins_is_binary_op(const instruction_e ins);
 // return true if instruction is a unary operator
 bool ins_is_unary_op(const instruction_e ins);
 
+// return the instruction mnemonic
+const char *ins_mnemonic(const instruction_e ins);
+
 } // namespace {}
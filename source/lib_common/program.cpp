@@ -1,7 +1,10 @@
+#include <algorithm>
 #include <cstdio>
 #include <memory>
 
 #include "program.h"
+#include "image.h"
+#include "hash.h"
 
 #define TRY(X) { if (!(X)) { return false; } }
 
@@ -77,15 +80,14 @@ bool consume(FILE *fd, std::string &string) {
   if (1 != fread(&size, 4, 1, fd)) {
     return false;
   }
-  assert(size < 256);
-  string.resize(size);
-  auto data = std::make_unique<char[]>(size + 1);
-  if (fread(data.get(), 1, size, fd) != size) {
+  if (size < 0) {
     return false;
   }
-  data[size] = '\0';
-  string.assign(data.get());
-  return true;
+  string.resize(size);
+  if (size == 0) {
+    return true;
+  }
+  return fread(&string[0], 1, size, fd) == size_t(size);
 }
 
 bool consume(FILE *fd, nano::function_t &f) {
@@ -119,12 +121,18 @@ bool consume(FILE *fd, nano::function_t &f) {
 
 namespace nano {
 
-bool program_t::serial_save(const char *path) {
+bool program_t::serial_save(const char *path) const {
   // open the output file
   FILE *fd = fopen(path, "wb");
   if (!fd) {
     return false;
   }
+  const bool ret = serial_save(fd);
+  fclose(fd);
+  return ret;
+}
+
+bool program_t::serial_save(FILE *fd) const {
   // emit header
   emit(fd, magic);
 #if 0
@@ -144,27 +152,47 @@ bool program_t::serial_save(const char *path) {
   for (const auto &f : functions_) {
     emit(fd, f);
   }
+  // emit globals
+  emit(fd, int32_t(globals_.size()));
+  for (const auto &g : globals_) {
+    emit(fd, g.name_);
+    emit(fd, g.offset_);
+  }
   // emit bytecode
-  emit(fd, int32_t(code_.size()));
-  emit(fd, code_.data(), code_.size());
+  emit(fd, int32_t(size()));
+  emit(fd, data(), size());
   // emit the line table
-  emit(fd, line_table_);
+  if (image_) {
+    linetable_t lines;
+    for (size_t i = 0; i < image_num_lines_; ++i) {
+      const line_entry_t &l = image_lines_[i];
+      lines[l.pc] = line_t{l.file, l.line};
+    }
+    emit(fd, lines);
+  } else {
+    emit(fd, line_table_);
+  }
   // emit the string table
   emit(fd, int32_t(strings_.size()));
   for (const auto &s : strings_) {
     emit(fd, s);
   }
   // done
-  fclose(fd);
-  return true;
+  return ferror(fd) == 0;
 }
 
 bool program_t::serial_load(const char *path) {
-  // open the output file
+  // open the input file
   FILE *fd = fopen(path, "rb");
   if (!fd) {
     return false;
   }
+  const bool ret = serial_load(fd);
+  fclose(fd);
+  return ret;
+}
+
+bool program_t::serial_load(FILE *fd) {
   // reset this program prior
   reset();
   // read header
@@ -184,7 +212,7 @@ bool program_t::serial_load(const char *path) {
   for (int32_t i = 0; i < num_syscalls; ++i) {
     syscalls_.emplace_back();
     syscalls_.back().call_ = nullptr;
-    consume(fd, syscalls_.back().name_);
+    TRY(consume(fd, syscalls_.back().name_));
   }
   // read functions
   int32_t num_functions = 0;
@@ -193,16 +221,28 @@ bool program_t::serial_load(const char *path) {
     functions_.emplace_back();
     TRY(consume(fd, functions_.back()));
   }
+  // read globals
+  int32_t num_globals = 0;
+  TRY(consume(fd, num_globals));
+  for (int32_t i = 0; i < num_globals; ++i) {
+    globals_.emplace_back();
+    TRY(consume(fd, globals_.back().name_));
+    TRY(consume(fd, globals_.back().offset_));
+  }
   // read bytecode
   int32_t code_size = 0;
   TRY(consume(fd, code_size));
+  TRY(code_size >= 0);
   code_.resize(code_size);
-  if (fread(code_.data(), 1, code_size, fd) != code_size) {
+  if (fread(code_.data(), 1, code_size, fd) != size_t(code_size)) {
     return false;
   }
-  // emit the line table
+  // read the line table
   TRY(consume(fd, line_table_));
-  // emit the string table
+  for (const auto &l : line_table_) {
+    index_line_(l.first, l.second);
+  }
+  // read the string table
   int32_t strings_size = 0;
   TRY(consume(fd, strings_size));
   for (int32_t i = 0; i < strings_size; ++i) {
@@ -210,17 +250,34 @@ bool program_t::serial_load(const char *path) {
     TRY(consume(fd, strings_.back()));
   }
   // done
-  fclose(fd);
   return true;
 }
 
+uint64_t program_t::hash() const {
+  hash_t h;
+  h.add(data(), size());
+  for (const auto &s : strings_) {
+    h.add(s);
+  }
+  for (const auto &s : syscalls_) {
+    h.add(s.name_);
+  }
+  return h.value;
+}
+
 void program_t::reset() {
   syscalls_.clear();
   functions_.clear();
   code_.clear();
   line_table_.clear();
+  line_index_.clear();
   strings_.clear();
   globals_.clear();
+  image_.reset();
+  image_code_ = nullptr;
+  image_code_size_ = 0;
+  image_lines_ = nullptr;
+  image_num_lines_ = 0;
 }
 
 const function_t *program_t::function_find(const std::string &name) const {
@@ -259,6 +316,62 @@ const function_t *program_t::function_find(int32_t pc) const {
   return nullptr;
 }
 
+void program_t::index_line_(int32_t pc, line_t line) {
+  // lines are almost always added in pc order
+  if (line_index_.empty() || line_index_.back().pc < pc) {
+    // only keep the first instruction of each run of the same line
+    if (line_index_.empty() || line_index_.back().file != line.file ||
+        line_index_.back().line != line.line) {
+      line_index_.push_back(line_entry_t{pc, line.file, line.line});
+    }
+    return;
+  }
+  // otherwise rebuild it from the line table
+  line_index_.clear();
+  for (const auto &l : line_table_) {
+    index_line_(l.first, l.second);
+  }
+}
+
+line_t program_t::get_line(uint32_t pc) const {
+  const line_entry_t *end = lines_end_();
+  const line_entry_t *itt = std::lower_bound(
+      lines_begin_(), end, int32_t(pc),
+      [](const line_entry_t &l, int32_t pc) { return l.pc < pc; });
+  if (itt != end && itt->pc == int32_t(pc)) {
+    return line_t{itt->file, itt->line};
+  }
+  // no line found
+  return line_t{};
+}
+
+line_t program_t::find_line(uint32_t pc) const {
+  // the last line starting at or before pc
+  const line_entry_t *begin = lines_begin_();
+  const line_entry_t *itt = std::upper_bound(
+      begin, lines_end_(), int32_t(pc),
+      [](int32_t pc, const line_entry_t &l) { return pc < l.pc; });
+  if (itt == begin) {
+    return line_t{};
+  }
+  --itt;
+  return line_t{itt->file, itt->line};
+}
+
+void program_t::line_pcs(line_t line, std::vector<int32_t> &out) const {
+  const line_entry_t *begin = lines_begin_();
+  for (const line_entry_t *l = begin; l != lines_end_(); ++l) {
+    if (l->file != line.file || l->line != line.line) {
+      continue;
+    }
+    // skip any entry continuing the same line
+    if (l != begin && l[-1].file == l->file && l[-1].line == l->line) {
+      continue;
+    }
+    out.push_back(l->pc);
+  }
+}
+
 bool program_t::syscall_resolve(const std::string &name, nano_syscall_t syscall) {
   bool res = false;
   for (auto &i : syscalls_) {
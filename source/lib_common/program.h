@@ -6,6 +6,7 @@
 #include <array>
 #include <memory>
 #include <cassert>
+#include <cstdio>
 
 
 #include "common.h"
@@ -14,8 +15,19 @@
 
 namespace nano {
 
+namespace image {
+struct mapping_t;
+} // namespace image
+
 struct program_t {
 
+  program_t()
+    : image_code_(nullptr)
+    , image_code_size_(0)
+    , image_lines_(nullptr)
+    , image_num_lines_(0)
+  {}
+
   // map instruction to line number
   typedef std::map<int32_t, line_t> linetable_t;
 
@@ -27,30 +39,32 @@ struct program_t {
 
   // access the raw opcodes
   const uint8_t *data() const {
-    return code_.data();
+    return image_ ? image_code_ : code_.data();
   }
 
   // size of the raw opcodes
   size_t size() const {
-    return code_.size();
+    return image_ ? image_code_size_ : code_.size();
   }
 
   const uint8_t *end() const {
-    return code_.data() + code_.size();
+    return data() + size();
   }
 
+  // note: empty for programs loaded from an image
   const linetable_t &line_table() const {
     return line_table_;
   }
 
-  line_t get_line(uint32_t pc) const {
-    auto itt = line_table_.find(pc);
-    if (itt != line_table_.end()) {
-      return itt->second;
-    }
-    // no line found
-    return line_t{};
-  }
+  // return the line which starts at exactly 'pc'
+  line_t get_line(uint32_t pc) const;
+
+  // return the line containing the instruction at 'pc', which need not be
+  // the first instruction of a line
+  line_t find_line(uint32_t pc) const;
+
+  // append the address of each instruction which starts 'line' to 'out'
+  void line_pcs(line_t line, std::vector<int32_t> &out) const;
 
   void reset();
 
@@ -78,6 +92,10 @@ struct program_t {
     return syscalls_;
   }
 
+  const std::vector<syscall_entry_t> &syscalls() const {
+    return syscalls_;
+  }
+
   bool syscall_resolve(const std::string &name, nano_syscall_t syscall);
 
   const function_t *function_find(const std::string &name) const;
@@ -85,9 +103,21 @@ struct program_t {
   const function_t *function_find(int32_t pc) const;
         function_t *function_find(int32_t pc);
 
+  // hash of the bytecode, string and syscall tables
+  uint64_t hash() const;
+
   // serialization functions
-  bool serial_save(const char *path);
+  bool serial_save(const char *path) const;
   bool serial_load(const char *path);
+  bool serial_save(FILE *fd) const;
+  bool serial_load(FILE *fd);
+
+  // save and load a memory mappable image
+  //
+  // a loaded program executes its code and line table directly from the
+  // mapped file.
+  bool image_save(const char *path) const;
+  bool image_load(const char *path);
 
 protected:
   friend struct program_builder_t;
@@ -97,6 +127,20 @@ protected:
   // add a line to the line table
   void add_line(int32_t pc, line_t line) {
     line_table_[pc] = line;
+    index_line_(pc, line);
+  }
+
+  // insert into the dense line index, which is in pc order
+  void index_line_(int32_t pc, line_t line);
+
+  // the line index, or the mapped line table for an image
+  const line_entry_t *lines_begin_() const {
+    return image_ ? image_lines_ : line_index_.data();
+  }
+
+  const line_entry_t *lines_end_() const {
+    return image_ ? image_lines_ + image_num_lines_
+                  : line_index_.data() + line_index_.size();
   }
 
   // global variables
@@ -114,8 +158,19 @@ protected:
   // line table [PC -> Line]
   linetable_t line_table_;
 
+  // the line table as an array sorted by pc holding only the first
+  // instruction of each line, for fast lookup
+  std::vector<line_entry_t> line_index_;
+
   // string table
   std::vector<std::string> strings_;
+
+  // image this program was loaded from, if any
+  std::shared_ptr<const image::mapping_t> image_;
+  const uint8_t *image_code_;
+  size_t image_code_size_;
+  const line_entry_t *image_lines_;
+  size_t image_num_lines_;
 };
 
 } // namespace nano
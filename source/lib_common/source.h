@@ -2,6 +2,7 @@
 #include <memory>
 #include <vector>
 #include <cassert>
+#include <cstring>
 
 #include "file.h"
 #include "types.h"
@@ -120,6 +121,11 @@ struct source_manager_t {
 
   void imported_path(const source_t &s, std::string &in_out);
 
+  // take ownership of an already loaded source
+  void add(std::unique_ptr<source_t> s) {
+    sources_.push_back(std::move(s));
+  }
+
 protected:
   std::vector<std::unique_ptr<source_t>> sources_;
 };
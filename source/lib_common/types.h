@@ -36,6 +36,13 @@ struct line_t {
   }
 };
 
+// an entry in a line table sorted by pc, the line runs until the next entry
+struct line_entry_t {
+  int32_t pc;
+  int32_t file;
+  int32_t line;
+};
+
 struct identifier_t {
   // identifier name
   std::string name_;
@@ -0,0 +1,248 @@
+#include <cstring>
+#include <set>
+
+#include "aot.h"
+#include "disassembler.h"
+
+
+namespace {
+
+using namespace nano;
+
+int32_t read_operand(const uint8_t *ptr) {
+  int32_t out;
+  memcpy(&out, ptr, sizeof(out));
+  return out;
+}
+
+// native_t method for instructions without control flow
+const char *get_method(instruction_e ins) {
+  switch (ins) {
+  case INS_ADD:       return "add";
+  case INS_SUB:       return "sub";
+  case INS_MUL:       return "mul";
+  case INS_DIV:       return "div";
+  case INS_MOD:       return "mod";
+  case INS_AND:       return "and_";
+  case INS_OR:        return "or_";
+  case INS_NOT:       return "not_";
+  case INS_NEG:       return "neg";
+  case INS_LT:        return "lt";
+  case INS_GT:        return "gt";
+  case INS_LEQ:       return "leq";
+  case INS_GEQ:       return "geq";
+  case INS_EQ:        return "eq";
+  case INS_POP:       return "pop";
+  case INS_NEW_ARY:   return "new_ary";
+  case INS_NEW_INT:   return "new_int";
+  case INS_NEW_STR:   return "new_str";
+  case INS_NEW_NONE:  return "new_none";
+  case INS_NEW_FUNC:  return "new_func";
+  case INS_NEW_SCALL: return "new_scall";
+  case INS_LOCALS:    return "locals";
+  case INS_GLOBALS:   return "globals";
+  case INS_GETV:      return "getv";
+  case INS_SETV:      return "setv";
+  case INS_GETG:      return "getg";
+  case INS_SETG:      return "setg";
+  case INS_DEREF:     return "deref";
+  case INS_SETA:      return "seta";
+  case INS_GETM:      return "getm";
+  case INS_SETM:      return "setm";
+  case INS_ARY_INIT:  return "ary_init";
+  case INS_ARY_LOCAL: return "ary_local";
+  default:            return nullptr;
+  }
+}
+
+// return true if an instruction can never raise an error
+bool is_safe(instruction_e ins) {
+  switch (ins) {
+  case INS_JMP:
+  case INS_TJMP:
+  case INS_FJMP:
+  case INS_RET:
+  case INS_AND:
+  case INS_OR:
+  case INS_NOT:
+  case INS_POP:
+  case INS_NEW_ARY:
+  case INS_NEW_INT:
+  case INS_NEW_STR:
+  case INS_NEW_NONE:
+  case INS_NEW_FLT:
+  case INS_NEW_FUNC:
+  case INS_NEW_SCALL:
+  case INS_LOCALS:
+  case INS_GLOBALS:
+  case INS_GETV:
+  case INS_SETV:
+  case INS_ARY_INIT:
+  case INS_ARY_LOCAL:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// return true if an instruction calls a function or syscall, which may halt
+// the thread
+bool is_call(instruction_e ins) {
+  switch (ins) {
+  case INS_CALL:
+  case INS_SCALL:
+  case INS_ICALL:
+    return true;
+  default:
+    return false;
+  }
+}
+
+} // namespace {}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+namespace nano {
+
+void aot_t::dump(const program_t &prog, FILE *fd) {
+  fprintf(fd, "// generated by nano_comp, do not edit\n");
+  fprintf(fd, "#include \"lib_vm/native.h\"\n\n");
+  fprintf(fd, "namespace {\n\n");
+  fprintf(fd, "using nano::native_t;\n");
+  fprintf(fd, "using nano::thread_t;\n\n");
+  // forward declarations
+  for (const function_t &f : prog.functions()) {
+    fprintf(fd, "void f_%d(thread_t &t);  // %s\n",
+            f.code_start_, f.name().c_str());
+  }
+  // function bodies
+  for (const function_t &f : prog.functions()) {
+    emit_function_(prog, f, fd);
+  }
+  fprintf(fd, "\n} // namespace {}\n\n");
+  // registration
+  fprintf(fd, "bool nano_aot_register(nano::vm_t &vm) {\n");
+  fprintf(fd, "  // only valid for the exact program this was generated from\n");
+  fprintf(fd, "  if (vm.program().hash() != 0x%016llxull) {\n",
+          (unsigned long long)prog.hash());
+  fprintf(fd, "    return false;\n");
+  fprintf(fd, "  }\n");
+  for (const function_t &f : prog.functions()) {
+    fprintf(fd, "  vm.native_register(%d, f_%d);\n",
+            f.code_start_, f.code_start_);
+  }
+  fprintf(fd, "  return true;\n");
+  fprintf(fd, "}\n");
+}
+
+void aot_t::emit_function_(const program_t &prog, const function_t &f,
+                           FILE *fd) {
+  const uint8_t *code = prog.data();
+
+  // find all of the branch targets in this function
+  std::set<int32_t> labels;
+  for (int32_t pc = f.code_start_; pc < f.code_end_;) {
+    const instruction_e ins = instruction_e(code[pc]);
+    switch (ins) {
+    case INS_JMP:
+    case INS_TJMP:
+    case INS_FJMP:
+      labels.insert(read_operand(code + pc + 1));
+      break;
+    case INS_FOR:
+      labels.insert(read_operand(code + pc + 5));
+      break;
+    default:
+      break;
+    }
+    pc += ins_size(ins);
+  }
+
+  fprintf(fd, "\n// function %s\n", f.name().c_str());
+  fprintf(fd, "void f_%d(thread_t &t) {\n", f.code_start_);
+  fprintf(fd, "  native_t n(t);\n");
+  fprintf(fd, "  n.tick();\n");
+
+  int32_t line = -1;
+  for (int32_t pc = f.code_start_; pc < f.code_end_;) {
+    const instruction_e ins = instruction_e(code[pc]);
+    const int32_t o1 = ins_has_operand(ins) ? read_operand(code + pc + 1) : 0;
+    const int32_t o2 = ins_has_two_operands(ins) ?
+                       read_operand(code + pc + 5) : 0;
+    const int32_t next = pc + ins_size(ins);
+
+    if (labels.count(pc)) {
+      fprintf(fd, "L_%d:\n", pc);
+      // loops pass through here so let the collector run
+      fprintf(fd, "  n.tick();\n");
+    }
+    const line_t loc = prog.find_line(pc);
+    if (loc.line > 0 && loc.line != line) {
+      line = loc.line;
+      fprintf(fd, "  // line %d\n", line);
+    }
+    if (!is_safe(ins)) {
+      // as the interpreter, errors and calls see the pc of the next
+      // instruction so source lines and return addresses match
+      fprintf(fd, "  n.at(%d);\n", next);
+    }
+
+    switch (ins) {
+    case INS_JMP:
+      fprintf(fd, "  goto L_%d;\n", o1);
+      break;
+    case INS_TJMP:
+      fprintf(fd, "  if (n.pop_bool()) goto L_%d;\n", o1);
+      break;
+    case INS_FJMP:
+      fprintf(fd, "  if (!n.pop_bool()) goto L_%d;\n", o1);
+      break;
+    case INS_FOR:
+      fprintf(fd, "  if (n.for_(%d)) goto L_%d;\n", o1, o2);
+      break;
+    case INS_CALL: {
+      const function_t *callee = prog.function_find(o2);
+      assert(callee && callee->code_start_ == o2);
+      fprintf(fd, "  n.enter(%d);\n", o2);
+      fprintf(fd, "  f_%d(t);  // %s\n", o2, callee->name().c_str());
+      break;
+    }
+    case INS_RET:
+      fprintf(fd, "  n.ret(%d);\n", o1);
+      fprintf(fd, "  return;\n");
+      break;
+    case INS_SCALL:
+      fprintf(fd, "  n.scall(%d, %d);  // %s\n", o1, o2,
+              prog.syscalls()[o2].name_.c_str());
+      break;
+    case INS_ICALL:
+      fprintf(fd, "  n.icall(%d);\n", o1);
+      break;
+    case INS_NEW_FLT: {
+      float val;
+      memcpy(&val, &o1, sizeof(val));
+      fprintf(fd, "  n.new_flt(0x%08xu);  // %f\n", uint32_t(o1), val);
+      break;
+    }
+    default: {
+      const char *method = get_method(ins);
+      assert(method);
+      if (ins_has_operand(ins)) {
+        fprintf(fd, "  n.%s(%d);\n", method, o1);
+      } else {
+        fprintf(fd, "  n.%s();\n", method);
+      }
+    }
+    }
+
+    if (is_call(ins)) {
+      // leave a halted thread for the interpreter to resume from 'next'
+      fprintf(fd, "  if (n.failed() || n.halted()) return;\n");
+    } else if (!is_safe(ins)) {
+      fprintf(fd, "  if (n.failed()) return;\n");
+    }
+    pc = next;
+  }
+  fprintf(fd, "}\n");
+}
+
+} // namespace nano
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdio>
+
+#include "nano.h"
+
+
+namespace nano {
+
+// translate a program into a C++ translation unit
+//
+// the generated code runs on the same runtime as the interpreter via the
+// native_t interface in lib_vm/native.h.  it exports:
+//
+//    bool nano_aot_register(nano::vm_t &vm);
+//
+// which installs a native function for every function in the program.  it
+// returns false if the program bound to the vm is not the one the code was
+// generated from.
+struct aot_t {
+
+  void dump(const program_t &prog, FILE *fd);
+
+protected:
+  void emit_function_(const program_t &prog, const function_t &f, FILE *fd);
+};
+
+} // namespace nano
@@ -175,6 +175,7 @@ void ast_t::reset() {
     delete x;
   }
   allocs_.clear();
+  tokens_.clear();
 }
 
 ast_t::~ast_t() {
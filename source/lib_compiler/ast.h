@@ -204,6 +204,7 @@ struct ast_exp_array_init_t : public ast_node_t {
   ast_exp_array_init_t(const token_t *name)
     : ast_node_t(TYPE)
     , name(name)
+    , in_frame(false)
   {}
 
   void replace_child(const ast_node_t *which, ast_node_t *with) override {
@@ -217,6 +218,8 @@ struct ast_exp_array_init_t : public ast_node_t {
   const token_t *name;
   // index expression
   std::vector<ast_node_t *> expr;
+  // set by escape analysis when the array can't outlive its stack frame
+  bool in_frame;
 };
 
 // XXX: should be called ast_exp_deref_t
@@ -532,6 +535,7 @@ struct ast_decl_func_t : public ast_node_t {
     , token(n)
     , is_syscall(false)
     , is_varargs(false)
+    , const_eval(nullptr)
     , name(n->str_)
     , body(nullptr)
     , stack_size(0)
@@ -543,6 +547,7 @@ struct ast_decl_func_t : public ast_node_t {
     , token(nullptr)
     , is_syscall(false)
     , is_varargs(false)
+    , const_eval(nullptr)
     , name(n)
     , body(nullptr)
     , stack_size(0)
@@ -569,6 +574,9 @@ struct ast_decl_func_t : public ast_node_t {
   bool is_syscall;
   bool is_varargs;
 
+  // compile time evaluator if this is a pure syscall
+  nano_const_eval_t const_eval;
+
   const std::string name;
   std::vector<ast_decl_var_t *> args;
   ast_block_t *body;
@@ -644,6 +652,12 @@ struct ast_t {
     return obj;
   }
 
+  // allocate a token for compiler generated nodes
+  const token_t *alloc_token(const token_t &t) {
+    tokens_.emplace_back(new token_t(t));
+    return tokens_.back().get();
+  }
+
   ast_program_t program;
 
   void reset();
@@ -656,6 +670,8 @@ struct ast_t {
 protected:
   nano_t &nano_;
   std::vector<ast_node_t*> allocs_;
+  // tokens owned by compiler generated nodes
+  std::vector<std::unique_ptr<token_t>> tokens_;
 };
 
 // ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
@@ -0,0 +1,169 @@
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "cache.h"
+
+#define TRY(X) { if (!(X)) { return false; } }
+
+namespace {
+
+using namespace nano;
+
+static const uint32_t magic = (('N' << 24) | ('C' << 16) | ('C' << 8) | ('H'));
+static const int32_t version = 1;
+
+// a temp file name no other writer of the same entry will use, from this or
+// any other process
+std::string temp_path(const std::string &path) {
+  static std::atomic<uint32_t> counter(0);
+#if defined(_WIN32)
+  const int pid = _getpid();
+#else
+  const int pid = int(getpid());
+#endif
+  char suffix[48];
+  snprintf(suffix, sizeof(suffix), ".%d.%u.tmp", pid, unsigned(counter++));
+  return path + suffix;
+}
+
+uint64_t hash_source(const source_t &s) {
+  hash_t h;
+  h.add(s.data(), strlen(s.data()));
+  return h.value;
+}
+
+void emit(FILE *fd, const void *data, size_t size) {
+  fwrite(data, 1, size, fd);
+}
+
+void emit(FILE *fd, const std::string &s) {
+  const int32_t size = int32_t(s.size());
+  emit(fd, &size, sizeof(size));
+  emit(fd, s.data(), s.size());
+}
+
+template <typename type_t>
+bool consume(FILE *fd, type_t &out) {
+  return fread(&out, sizeof(type_t), 1, fd) == 1;
+}
+
+bool consume(FILE *fd, std::string &out) {
+  int32_t size = 0;
+  TRY(consume(fd, size));
+  TRY(size >= 0);
+  out.resize(size);
+  return size == 0 || fread(&out[0], 1, size, fd) == size_t(size);
+}
+
+// an imported file and a hash of its contents
+struct dep_t {
+  std::string path;
+  uint64_t hash;
+};
+
+} // namespace {}
+
+namespace nano {
+
+void compile_cache_t::begin(const source_manager_t &sources) {
+  hash_t h;
+  h.add(version);
+  h.add(&options_, sizeof(options_));
+  roots_ = sources.count();
+  for (int32_t i = 0; i < roots_; ++i) {
+    const source_t &s = sources.get_source(i);
+    // imports are relative to the path so it must be part of the key
+    h.add(s.file_path());
+    h.add(s.data(), strlen(s.data()));
+  }
+  key_ = h.value;
+}
+
+std::string compile_cache_t::entry_path_() const {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.nbc", (unsigned long long)key_);
+  return dir_ + "/" + name;
+}
+
+bool compile_cache_t::load(source_manager_t &sources, program_t &program) {
+  // the cached program assumes only the roots have been loaded
+  TRY(sources.count() == roots_);
+  FILE *fd = fopen(entry_path_().c_str(), "rb");
+  if (!fd) {
+    return false;
+  }
+  std::unique_ptr<FILE, int(*)(FILE*)> guard(fd, fclose);
+  uint32_t magic_no = 0;
+  int32_t version_no = 0;
+  uint64_t key = 0;
+  TRY(consume(fd, magic_no) && magic_no == magic);
+  TRY(consume(fd, version_no) && version_no == version);
+  // guard against hash collisions between entries
+  TRY(consume(fd, key) && key == key_);
+  // read the list of imported files
+  int32_t num_deps = 0;
+  TRY(consume(fd, num_deps) && num_deps >= 0);
+  std::vector<dep_t> deps(num_deps);
+  for (dep_t &d : deps) {
+    TRY(consume(fd, d.path));
+    TRY(consume(fd, d.hash));
+  }
+  // make sure no imported file has changed
+  std::vector<std::unique_ptr<source_t>> imports;
+  for (const dep_t &d : deps) {
+    imports.emplace_back(new source_t);
+    TRY(imports.back()->load_from_file(d.path.c_str()));
+    TRY(hash_source(*imports.back()) == d.hash);
+  }
+  if (!program.serial_load(fd)) {
+    program.reset();
+    return false;
+  }
+  // add the imports in the order they were loaded so file indices in the
+  // line table stay valid
+  for (auto &s : imports) {
+    sources.add(std::move(s));
+  }
+  return true;
+}
+
+bool compile_cache_t::save(const source_manager_t &sources,
+                           const program_t &program) {
+  const std::string path = entry_path_();
+  const std::string temp = temp_path(path);
+  FILE *fd = fopen(temp.c_str(), "wb");
+  if (!fd) {
+    return false;
+  }
+  emit(fd, &magic, sizeof(magic));
+  emit(fd, &version, sizeof(version));
+  emit(fd, &key_, sizeof(key_));
+  // everything after the roots was imported
+  const int32_t num_deps = sources.count() - roots_;
+  emit(fd, &num_deps, sizeof(num_deps));
+  for (int32_t i = roots_; i < sources.count(); ++i) {
+    const source_t &s = sources.get_source(i);
+    const uint64_t hash = hash_source(s);
+    emit(fd, s.file_path());
+    emit(fd, &hash, sizeof(hash));
+  }
+  bool ok = program.serial_save(fd);
+  // the last of the data is only written by the final flush
+  ok = (fclose(fd) == 0) && ok;
+  // move into place so a reader never sees a partial entry
+  if (!ok || rename(temp.c_str(), path.c_str()) != 0) {
+    remove(temp.c_str());
+    return false;
+  }
+  return true;
+}
+
+} // namespace nano
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "nano.h"
+#include "../lib_common/hash.h"
+
+
+namespace nano {
+
+// on disk cache of compiled programs
+//
+// entries are keyed on the contents and paths of the root source files and
+// the compiler options.  each entry records the files imported during the
+// build along with a hash of their contents so that a change to any imported
+// file will invalidate it.
+struct compile_cache_t {
+
+  compile_cache_t(const std::string &dir, uint64_t options)
+    : dir_(dir)
+    , options_(options)
+    , key_(0)
+    , roots_(0)
+  {}
+
+  // compute the cache key from the root source files
+  void begin(const source_manager_t &sources);
+
+  // try to load a program from the cache
+  //
+  // note: on success any imported files are added to the source manager
+  bool load(source_manager_t &sources, program_t &program);
+
+  // store a newly built program in the cache
+  bool save(const source_manager_t &sources, const program_t &program);
+
+protected:
+  std::string entry_path_() const;
+
+  const std::string dir_;
+  const uint64_t options_;
+  uint64_t key_;
+  int32_t roots_;
+};
+
+} // namespace nano
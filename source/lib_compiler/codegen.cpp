@@ -35,6 +35,33 @@ static instruction_e tok_to_ins_(token_e op) {
     return instruction_e(0);
   }
 }
+
+// check if an expression reads a specific variable
+struct find_use_t: public ast_visitor_t {
+
+  find_use_t(const ast_decl_var_t *decl)
+    : decl_(decl)
+    , found_(false)
+  {}
+
+  void visit(ast_exp_ident_t *n) override {
+    found_ |= (n->decl == decl_);
+  }
+
+  void visit(ast_exp_member_t *n) override {
+    found_ |= (n->decl == decl_);
+  }
+
+  bool find(ast_node_t *n) {
+    found_ = false;
+    dispatch(n);
+    return found_;
+  }
+
+protected:
+  const ast_decl_var_t *decl_;
+  bool found_;
+};
 } // namespace {}
 
 namespace nano {
@@ -163,7 +190,8 @@ struct codegen_pass_t: ast_visitor_t {
   void visit(ast_exp_array_init_t* n) override {
     ast_visitor_t::visit(n);
     assert(!n->expr.empty());
-    emit(INS_ARY_INIT, int32_t(n->expr.size()), n->name);
+    emit(n->in_frame ? INS_ARY_LOCAL : INS_ARY_INIT,
+         int32_t(n->expr.size()), n->name);
   }
 
   void visit(ast_exp_deref_t* n) override {
@@ -318,6 +346,17 @@ struct codegen_pass_t: ast_visitor_t {
 
   void visit(ast_stmt_for_t* n) override {
 
+    assert(n->decl);
+
+    // use a counted loop where we can
+    if (nano_.optimize && (n->decl->is_local() || n->decl->is_arg())) {
+      // INS_FOR evaluates <end> before the increment so it can't use <name>
+      if (!find_use_t(n->decl).find(n->end)) {
+        visit_counted_for_(n);
+        return;
+      }
+    }
+
     // format:
     // 
     // <name> = <start>
@@ -329,8 +368,6 @@ struct codegen_pass_t: ast_visitor_t {
     // if (<name> < <end>) jmp -'
     //
 
-    assert(n->decl);
-
     dispatch(n->start);
     set_decl_(n->decl, n->name);
 
@@ -498,6 +535,47 @@ protected:
     return stream_.head(-4);
   }
 
+  // emit a for loop using the counted loop instruction
+  void visit_counted_for_(ast_stmt_for_t* n) {
+
+    // format:
+    //
+    // <name> = <start>
+    // if (!(<name> < <end>)) jmp ---.
+    // L0 <--------------------.     |
+    // <body>                  |     |
+    // for <name>, <end> ------'     |
+    // L1 <--------------------------'
+    //
+
+    dispatch(n->start);
+    set_decl_(n->decl, n->name);
+
+    // check entry condition
+    get_decl_(n->decl, n->token);
+    dispatch(n->end);
+    emit(INS_LT, n->token);
+
+    // false jump to L1 --->
+    emit(INS_FJMP, 0, n->token);
+    uint32_t to_L1 = get_fixup();
+
+    // L0 <---
+    const int32_t L0 = pos();
+    // emit the for loop body
+    dispatch(n->body);
+
+    // step and loop back to L0 --->
+    dispatch(n->end);
+    emit(INS_FOR, n->decl->offset, L0, n->token);
+
+    // L1 <---
+    const int32_t L1 = pos();
+
+    // apply fixups
+    stream_.apply_fixup(to_L1, L1);
+  }
+
   // handle @init function as a special case
   void visit_init(ast_decl_func_t* a, function_t *func) {
 
@@ -594,6 +672,7 @@ void codegen_pass_t::emit(instruction_e ins, int32_t o1, const token_t *t) {
   case INS_GETM:
   case INS_SETM:
   case INS_ARY_INIT:
+  case INS_ARY_LOCAL:
     stream_.write8(uint8_t(ins));
     stream_.write32(o1);
     break;
@@ -612,6 +691,11 @@ void codegen_pass_t::emit(instruction_e ins, int32_t o1, int32_t o2, const token
     stream_.write32(o1);  // num args
     stream_.write32(o2);  // target
     break;
+  case INS_FOR:
+    stream_.write8(uint8_t(ins));
+    stream_.write32(o1);  // loop variable
+    stream_.write32(o2);  // target
+    break;
   default:
     assert(!"unknown instruction");
   }
@@ -4,45 +4,11 @@
 #include "instructions.h"
 
 
-namespace {
-
-// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
-const char *gMnemonic[] = {
-  // operators
-  "INS_ADD", "INS_SUB", "INS_MUL", "INS_DIV", "INS_MOD", "INS_AND", "INS_OR",
-  // unary operators
-  "INS_NOT", "INS_NEG",
-  // comparators
-  "INS_LT", "INS_GT", "INS_LEQ", "INS_GEQ", "INS_EQ",
-  // branching
-  "INS_JMP", "INS_TJMP", "INS_FJMP", "INS_CALL", "INS_RET", "INS_SCALL",
-  "INS_ICALL",
-  // stack
-  "INS_POP",
-  "INS_NEW_INT", "INS_NEW_STR", "INS_NEW_ARY", "INS_NEW_NONE", "INS_NEW_FLT",
-  "INS_NEW_FUNC", "INS_NEW_SYSCALL", "INS_LOCALS", "INS_GLOBALS",
-  // local variables
-  "INS_GETV", "INS_SETV", "INS_DEREF", "INS_SETA",
-  // global variables
-  "INS_GETG", "INS_SETG",
-  // member access
-  "INS_GETM", "INS_SETM",
-  //
-  "INS_ARY_INIT"
-};
-
-// make sure this is kept up to date with the opcode table 'instruction_e'
-static_assert(sizeof(gMnemonic) / sizeof(const char *) == nano::__INS_COUNT__,
-              "gMnemonic table should match instruction_e enum layout");
-
-} // namespace {}
-
 // ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
 namespace nano {
 
 const char *disassembler_t::get_mnemonic(const instruction_e e) {
-  assert(e < __INS_COUNT__);
-  return gMnemonic[e];
+  return ins_mnemonic(e);
 }
 
 // disassemble a code stream
@@ -73,7 +39,8 @@ int32_t disassembler_t::disasm(const uint8_t *ptr, std::string &out) const {
   case INS_SETA:
   case INS_DEREF:
   case INS_NEW_NONE:
-    out = gMnemonic[op];
+  case INS_BREAK:
+    out = ins_mnemonic(instruction_e(op));
     return i;
   }
 
@@ -103,7 +70,8 @@ int32_t disassembler_t::disasm(const uint8_t *ptr, std::string &out) const {
   case INS_GETM:
   case INS_SETM:
   case INS_ARY_INIT:
-    out = gMnemonic[op];
+  case INS_ARY_LOCAL:
+    out = ins_mnemonic(instruction_e(op));
     out += " ";
     out += std::to_string(val1);
     return i;
@@ -116,7 +84,8 @@ int32_t disassembler_t::disasm(const uint8_t *ptr, std::string &out) const {
   switch (op) {
   case INS_SCALL:
   case INS_CALL:
-    out = gMnemonic[op];
+  case INS_FOR:
+    out = ins_mnemonic(instruction_e(op));
     out += " ";
     out += std::to_string(val1);
     out += " ";
@@ -127,7 +96,8 @@ int32_t disassembler_t::disasm(const uint8_t *ptr, std::string &out) const {
   return 0;
 }
 
-void disassembler_t::dump(program_t &prog, FILE *fd) {
+void disassembler_t::dump(program_t &prog, FILE *fd,
+                          const std::vector<uint64_t> *hits) {
 
   const uint8_t *p   = prog.data();
   const uint8_t *end = prog.end();
@@ -150,13 +120,19 @@ void disassembler_t::dump(program_t &prog, FILE *fd) {
       func = f;
     }
 
-    line_t loc = prog.get_line(offs);
+    line_t loc = prog.find_line(offs);
     if (loc.line != line) {
       line = loc.line;
       fprintf(fd, "# line: %d\n", line);
     }
 
-    fprintf(fd, "%s\n", out.c_str());
+    if (hits) {
+      const uint64_t count =
+          offs < int32_t(hits->size()) ? (*hits)[offs] : 0;
+      fprintf(fd, "%12llu  %s\n", (unsigned long long)count, out.c_str());
+    } else {
+      fprintf(fd, "%s\n", out.c_str());
+    }
 
     offs += i;
     p += i;
@@ -1,5 +1,6 @@
 #pragma once
 #include <cstdio>
+#include <vector>
 
 #include "nano.h"
 
@@ -8,7 +9,10 @@ namespace nano {
 
 struct disassembler_t {
 
-  void dump(program_t &prog, FILE *fd);
+  // write a listing of the program.  if 'hits' is given each instruction is
+  // annotated with its hit count, indexed by code address.
+  void dump(program_t &prog, FILE *fd,
+            const std::vector<uint64_t> *hits = nullptr);
 
   // return number of bytes disassembled or <= 0 on error
   int32_t disasm(const uint8_t *ptr, std::string &out) const;
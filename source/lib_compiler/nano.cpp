@@ -10,12 +10,14 @@
 #include "disassembler.h"
 #include "phases.h"
 #include "source.h"
+#include "cache.h"
 
 using namespace nano;
 
 nano_t::nano_t(program_t &prog)
   : optimize(true)
   , program_(prog)
+  , syscall_hash_(0)
   , sources_(nullptr)
   , source_(nullptr)
   , errors_(new error_manager_t(*this))
@@ -35,6 +37,18 @@ bool nano_t::build(source_manager_t &sources, error_t &error) {
   // store the source manager for now so we can import into it
   sources_ = &sources;
 
+  // the options and syscalls change the generated code so form part of the key
+  hash_t options;
+  options.add(&syscall_hash_, sizeof(syscall_hash_));
+  options.add(int32_t(optimize));
+  compile_cache_t cache(cache_dir, options.value);
+  if (!cache_dir.empty()) {
+    cache.begin(sources);
+    if (cache.load(sources, program_)) {
+      return true;
+    }
+  }
+
   // clear the error
   error.clear();
   try {
@@ -69,6 +83,10 @@ bool nano_t::build(source_manager_t &sources, error_t &error) {
     }
     // collect all garbage
     ast().gc();
+    // store for next time
+    if (!cache_dir.empty()) {
+      cache.save(sources, program_);
+    }
   }
   catch (const error_t &e) {
     error = e;
@@ -83,11 +101,14 @@ void nano_t::reset() {
   parser_->reset();
   ast_->reset();
   program_.reset();
+  syscall_hash_ = 0;
 }
 
-void nano_t::syscall_register(const std::string &name, int32_t num_args) {
+void nano_t::syscall_register(const std::string &name, int32_t num_args,
+                              nano_const_eval_t eval) {
   ast_decl_func_t *func = ast_->alloc<ast_decl_func_t>(name);
   func->is_syscall = true;
+  func->const_eval = eval;
   if (num_args < 0) {
     // this signals var args
     func->is_varargs = true;
@@ -99,4 +120,11 @@ void nano_t::syscall_register(const std::string &name, int32_t num_args) {
   }
   auto &prog = ast_->program;
   prog.children.push_back(func);
+  // syscalls change the generated code so they are part of the cache key
+  hash_t h;
+  h.add(&syscall_hash_, sizeof(syscall_hash_));
+  h.add(name);
+  h.add(num_args);
+  h.add(int32_t(eval != nullptr));
+  syscall_hash_ = h.value;
 }
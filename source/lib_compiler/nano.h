@@ -15,6 +15,63 @@
 
 namespace nano {
 
+// a constant value used when evaluating syscalls at compile time
+struct const_value_t {
+
+  enum type_t {
+    e_int,
+    e_float,
+    e_string,
+  };
+
+  const_value_t()
+    : type(e_int)
+    , i(0)
+    , f(0.f)
+  {}
+
+  bool is_number() const {
+    return type == e_int || type == e_float;
+  }
+
+  float as_float() const {
+    return type == e_float ? f : float(i);
+  }
+
+  static const_value_t from_int(int32_t v) {
+    const_value_t out;
+    out.type = e_int;
+    out.i = v;
+    return out;
+  }
+
+  static const_value_t from_float(float v) {
+    const_value_t out;
+    out.type = e_float;
+    out.f = v;
+    return out;
+  }
+
+  static const_value_t from_string(const std::string &v) {
+    const_value_t out;
+    out.type = e_string;
+    out.s = v;
+    return out;
+  }
+
+  type_t type;
+  int32_t i;
+  float f;
+  std::string s;
+};
+
+// compile time evaluator for a pure syscall
+//
+// note: return false if the call can not be evaluated, in which case it will
+//       be left to execute at runtime
+typedef bool(*nano_const_eval_t)(const std::vector<const_value_t> &args,
+                                 const_value_t &out);
+
 struct nano_t {
 
   nano_t(program_t &prog);
@@ -33,11 +90,17 @@ struct nano_t {
   // register a system call
   //
   // note: if num_args < 0 it can take a variable number of arguments
-  void syscall_register(const std::string &name, int32_t num_args);
+  // note: if eval is provided the syscall is pure and calls with constant
+  //       arguments will be evaluated at compile time
+  void syscall_register(const std::string &name, int32_t num_args,
+                        nano_const_eval_t eval = nullptr);
 
   // enable codegen optimizations
   bool optimize;
 
+  // if set, compiled programs are cached in this directory
+  std::string cache_dir;
+
 protected:
   friend struct lexer_t;
   friend struct parser_t;
@@ -49,6 +112,9 @@ protected:
   // the current program we are building
   program_t &program_;
 
+  // hash of all registered syscalls
+  uint64_t syscall_hash_;
+
   // the source manager we are working with
   source_manager_t *sources_;
   // the current file we are parsing
@@ -1,4 +1,5 @@
 #include <set>
+#include <map>
 
 #include "ast.h"
 #include "errors.h"
@@ -196,6 +197,10 @@ struct opt_const_expr_t: public ast_visitor_t {
   void visit(ast_stmt_return_t *s) override {
     ast_visitor_t::visit(s);
     int32_t v = 0;
+    // a bare return has no expression
+    if (!s->expr) {
+      return;
+    }
     if (auto *e = s->expr->cast<ast_exp_bin_op_t>()) {
       if (eval_(e, v)) {
         s->expr = ast_.alloc<ast_exp_lit_var_t>(v);
@@ -213,6 +218,31 @@ struct opt_const_expr_t: public ast_visitor_t {
     }
   }
 
+  void visit(ast_decl_var_t *s) override {
+    ast_visitor_t::visit(s);
+    int32_t v = 0;
+    // a declaration need not have an initializer
+    if (!s->expr) {
+      return;
+    }
+    if (auto *e = s->expr->cast<ast_exp_bin_op_t>()) {
+      if (eval_(e, v)) {
+        s->expr = ast_.alloc<ast_exp_lit_var_t>(v);
+      }
+    }
+  }
+
+  void visit(ast_exp_call_t *c) override {
+    ast_visitor_t::visit(c);
+    // fold arguments so pure syscalls can be evaluated
+    for (auto &arg : c->args) {
+      int32_t v = 0;
+      if (value_(arg, v) && !arg->is_a<ast_exp_lit_var_t>()) {
+        arg = ast_.alloc<ast_exp_lit_var_t>(v);
+      }
+    }
+  }
+
   void visit(ast_program_t *p) override {
     ast_visitor_t::visit(p);
   }
@@ -305,6 +335,83 @@ protected:
   ast_t &ast_;
 };
 
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+//
+// evaluate calls to pure syscalls with constant arguments
+//
+struct opt_pure_call_t: public ast_visitor_t {
+
+  opt_pure_call_t(nano_t &nano)
+    : ast_(nano.ast())
+  {}
+
+  void visit(ast_exp_call_t *n) override {
+    // fold any inner calls first
+    ast_visitor_t::visit(n);
+    auto *ident = n->callee->cast<ast_exp_ident_t>();
+    if (!ident) {
+      return;
+    }
+    auto *func = ident->decl->cast<ast_decl_func_t>();
+    if (!func || !func->is_syscall || !func->const_eval) {
+      return;
+    }
+    // the result of a call statement is discarded anyway
+    ast_node_t *parent = stack.rbegin()[1];
+    if (parent->is_a<ast_stmt_call_t>()) {
+      return;
+    }
+    // all arguments must be constant
+    std::vector<const_value_t> args;
+    for (const ast_node_t *a : n->args) {
+      args.emplace_back();
+      if (!to_const_(a, args.back())) {
+        return;
+      }
+    }
+    const_value_t out;
+    if (!func->const_eval(args, out)) {
+      return;
+    }
+    parent->replace_child(n, from_const_(out));
+  }
+
+  void visit(ast_program_t *p) override {
+    ast_visitor_t::visit(p);
+  }
+
+protected:
+
+  bool to_const_(const ast_node_t *n, const_value_t &out) const {
+    if (const auto *v = n->cast<ast_exp_lit_var_t>()) {
+      out = const_value_t::from_int(v->val);
+      return true;
+    }
+    if (const auto *v = n->cast<ast_exp_lit_float_t>()) {
+      out = const_value_t::from_float(v->val);
+      return true;
+    }
+    if (const auto *v = n->cast<ast_exp_lit_str_t>()) {
+      out = const_value_t::from_string(v->value);
+      return true;
+    }
+    return false;
+  }
+
+  ast_node_t *from_const_(const const_value_t &v) {
+    switch (v.type) {
+    case const_value_t::e_int:    return ast_.alloc<ast_exp_lit_var_t>(v.i);
+    case const_value_t::e_float:  return ast_.alloc<ast_exp_lit_float_t>(v.f);
+    case const_value_t::e_string: return ast_.alloc<ast_exp_lit_str_t>(v.s);
+    default:
+      assert(!"unknown constant type");
+      return nullptr;
+    }
+  }
+
+  ast_t &ast_;
+};
+
 // ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
 //
 // delete dead code after a return statement
@@ -380,12 +487,401 @@ protected:
   error_manager_t &errs_;
 };
 
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+//
+// collect the variables that may change inside a loop
+//
+struct opt_loop_writes_t: public ast_visitor_t {
+
+  void visit(ast_stmt_assign_var_t *n) override {
+    writes.insert(n->decl);
+    ast_visitor_t::visit(n);
+  }
+
+  void visit(ast_stmt_for_t *n) override {
+    writes.insert(n->decl);
+    ast_visitor_t::visit(n);
+  }
+
+  void visit(ast_decl_var_t *n) override {
+    // a decl inside a loop is reinitalized every itteration
+    writes.insert(n);
+    ast_visitor_t::visit(n);
+  }
+
+  void visit(ast_exp_call_t *n) override {
+    has_side_effects = true;
+    ast_visitor_t::visit(n);
+  }
+
+  void visit(ast_exp_member_t *n) override {
+    // member access may invoke a user handler
+    has_side_effects = true;
+    ast_visitor_t::visit(n);
+  }
+
+  void collect(ast_node_t *n) {
+    dispatch(n);
+  }
+
+  opt_loop_writes_t()
+    : has_side_effects(false)
+  {}
+
+  std::set<const ast_decl_var_t*> writes;
+  bool has_side_effects;
+};
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+//
+// find all 'i * <int>' products of a loop variable
+//
+struct opt_loop_products_t: public ast_visitor_t {
+
+  opt_loop_products_t(const ast_decl_var_t *decl)
+    : decl_(decl)
+  {}
+
+  struct product_t {
+    ast_node_t *parent;
+    ast_exp_bin_op_t *node;
+  };
+
+  void visit(ast_exp_bin_op_t *n) override {
+    int32_t c = 0;
+    if (n->op == TOK_MUL && match_(n, c)) {
+      ast_node_t *parent = stack.rbegin()[1];
+      products[c].push_back(product_t{parent, n});
+      return;
+    }
+    ast_visitor_t::visit(n);
+  }
+
+  void collect(ast_node_t *n) {
+    dispatch(n);
+  }
+
+  // products grouped by their constant factor
+  std::map<int32_t, std::vector<product_t>> products;
+
+protected:
+  bool is_decl_(const ast_node_t *n) const {
+    if (const auto *i = n->cast<ast_exp_ident_t>()) {
+      return i->decl == decl_;
+    }
+    return false;
+  }
+
+  bool match_(const ast_exp_bin_op_t *n, int32_t &c) const {
+    const auto *l = n->left->cast<ast_exp_lit_var_t>();
+    const auto *r = n->right->cast<ast_exp_lit_var_t>();
+    if (r && is_decl_(n->left)) {
+      c = r->val;
+      return true;
+    }
+    if (l && is_decl_(n->right)) {
+      c = l->val;
+      return true;
+    }
+    return false;
+  }
+
+  const ast_decl_var_t *decl_;
+};
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+//
+// loop invariant code motion and strength reduction
+//
+// invariant expressions in a loop condition are hoisted into temporaries
+// declared just before the loop.  the condition is always evaluated at least
+// once so this can not introduce a new runtime error.  loop bodies are left
+// alone as an operator may raise an error for some types which the body would
+// otherwise never have evaluated.
+//
+// within a for loop, 'i * <int>' products are replaced by a derived induction
+// variable which is stepped at the end of each itteration.  since the step
+// costs about as much as a multiply in our VM, this is only done when the
+// same product is used more than once per itteration.
+//
+struct opt_loop_t: public ast_visitor_t {
+
+  opt_loop_t(nano_t &nano)
+    : ast_(nano.ast())
+    , temps_(0)
+  {}
+
+  void visit(ast_block_t *n) override {
+    auto &nodes = n->nodes;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      assert(hoisted_.empty());
+      dispatch(nodes[i]);
+      if (!hoisted_.empty()) {
+        // insert temporaries ahead of the loop
+        nodes.insert(nodes.begin() + i, hoisted_.begin(), hoisted_.end());
+        i += hoisted_.size();
+        hoisted_.clear();
+      }
+    }
+  }
+
+  void visit(ast_stmt_while_t *s) override {
+    // optimize any inner loops first
+    dispatch(s->body);
+    opt_loop_writes_t w;
+    w.collect(s->expr);
+    w.collect(s->body);
+    if (!w.has_side_effects) {
+      hoist_(s, s->expr, w.writes, s->token);
+    }
+  }
+
+  void visit(ast_stmt_for_t *s) override {
+    assert(s->decl);
+    // optimize any inner loops first
+    dispatch(s->body);
+    opt_loop_writes_t w;
+    w.collect(s->end);
+    w.collect(s->body);
+    w.writes.insert(s->decl);
+    if (!w.has_side_effects) {
+      hoist_(s, s->end, w.writes, s->token);
+    }
+    strength_reduce_(s);
+  }
+
+  void visit(ast_program_t *p) override {
+    ast_visitor_t::visit(p);
+  }
+
+protected:
+
+  bool is_invariant_(const ast_node_t *n,
+                     const std::set<const ast_decl_var_t*> &writes) const {
+    switch (n->type) {
+    case ast_exp_lit_var_e:
+    case ast_exp_lit_float_e:
+    case ast_exp_lit_str_e:
+    case ast_exp_none_e:
+      return true;
+    case ast_exp_ident_e: {
+      // globals may be changed by a call or another thread
+      const auto *d = n->cast<ast_exp_ident_t>()->decl->cast<ast_decl_var_t>();
+      return d && (d->is_local() || d->is_arg()) && !writes.count(d);
+    }
+    case ast_exp_bin_op_e: {
+      const auto *b = n->cast<ast_exp_bin_op_t>();
+      return is_invariant_(b->left, writes) && is_invariant_(b->right, writes);
+    }
+    case ast_exp_unary_op_e:
+      return is_invariant_(n->cast<ast_exp_unary_op_t>()->child, writes);
+    default:
+      return false;
+    }
+  }
+
+  // hoist the largest invariant sub expressions of 'n', a child of 'parent'
+  void hoist_(ast_node_t *parent, ast_node_t *n,
+              const std::set<const ast_decl_var_t*> &writes,
+              const token_t *loc) {
+    if (!n) {
+      return;
+    }
+    if (is_invariant_(n, writes)) {
+      // only worth hoisting if there is some work to be saved
+      if (n->is_a<ast_exp_bin_op_t>() || n->is_a<ast_exp_unary_op_t>()) {
+        ast_decl_var_t *decl = new_temp_(n, loc);
+        parent->replace_child(n, new_ident_(decl));
+      }
+      return;
+    }
+    if (auto *b = n->cast<ast_exp_bin_op_t>()) {
+      hoist_(b, b->left, writes, loc);
+      hoist_(b, b->right, writes, loc);
+    }
+    if (auto *u = n->cast<ast_exp_unary_op_t>()) {
+      hoist_(u, u->child, writes, loc);
+    }
+  }
+
+  void strength_reduce_(ast_stmt_for_t *s) {
+    // the loop variable must only be changed by the loop itself
+    if (!s->body || !(s->decl->is_local() || s->decl->is_arg())) {
+      return;
+    }
+    if (count_writes_(s->body, s->decl) != 0) {
+      return;
+    }
+    // the start value must be a known integer for the products to be exact
+    const auto *start = s->start->cast<ast_exp_lit_var_t>();
+    if (!start) {
+      return;
+    }
+    opt_loop_products_t p(s->decl);
+    p.collect(s->body);
+    for (auto &pair : p.products) {
+      const int32_t c = pair.first;
+      auto &uses = pair.second;
+      if (uses.size() < 2) {
+        continue;
+      }
+      // var @loopN = <start> * c
+      auto *init = ast_.alloc<ast_exp_lit_var_t>(start->val * c);
+      ast_decl_var_t *decl = new_temp_(init, s->token);
+      for (auto &u : uses) {
+        u.parent->replace_child(u.node, new_ident_(decl));
+      }
+      // @loopN = @loopN + c
+      const line_t line = s->token->line_;
+      auto *step = ast_.alloc<ast_exp_bin_op_t>(
+        ast_.alloc_token(token_t(TOK_ADD, line)));
+      step->left = new_ident_(decl);
+      step->right = ast_.alloc<ast_exp_lit_var_t>(c);
+      auto *assign = ast_.alloc<ast_stmt_assign_var_t>(decl->name);
+      assign->decl = decl;
+      assign->expr = step;
+      s->body->add(assign);
+    }
+  }
+
+  int32_t count_writes_(ast_node_t *n, const ast_decl_var_t *decl) const {
+    opt_loop_writes_t w;
+    w.collect(n);
+    return int32_t(w.writes.count(decl));
+  }
+
+  ast_decl_var_t *new_temp_(ast_node_t *expr, const token_t *loc) {
+    const std::string name = "@loop" + std::to_string(temps_++);
+    const token_t *tok = ast_.alloc_token(token_t(TOK_IDENT, name, loc->line_));
+    auto *decl = ast_.alloc<ast_decl_var_t>(tok, ast_decl_var_t::e_local);
+    decl->expr = expr;
+    hoisted_.push_back(decl);
+    return decl;
+  }
+
+  ast_exp_ident_t *new_ident_(ast_decl_var_t *decl) {
+    auto *ident = ast_.alloc<ast_exp_ident_t>(decl->name);
+    ident->decl = decl;
+    return ident;
+  }
+
+  ast_t &ast_;
+  int32_t temps_;
+
+  // temporaries to be inserted before the current loop
+  std::vector<ast_node_t*> hoisted_;
+};
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+//
+// escape analysis for local arrays
+//
+// a local array which is only ever indexed, or passed to a pure syscall, can
+// not outlive its stack frame and so can be allocated from the threads frame
+// scratch region rather than the heap.  arrays declared in a loop are left
+// on the heap as scratch space is only released on return.
+//
+struct opt_array_escape_t: public ast_visitor_t {
+
+  opt_array_escape_t(nano_t &)
+    : loops_(0)
+  {}
+
+  void visit(ast_stmt_while_t *n) override {
+    ++loops_;
+    ast_visitor_t::visit(n);
+    --loops_;
+  }
+
+  void visit(ast_stmt_for_t *n) override {
+    escape_(n->decl);
+    ++loops_;
+    ast_visitor_t::visit(n);
+    --loops_;
+  }
+
+  void visit(ast_decl_var_t *n) override {
+    if (n->is_local() && loops_ == 0) {
+      if (auto *init = n->expr ? n->expr->cast<ast_exp_array_init_t>()
+                               : nullptr) {
+        candidates_[n] = init;
+      }
+    }
+    ast_visitor_t::visit(n);
+  }
+
+  void visit(ast_exp_ident_t *n) override {
+    ast_node_t *parent = stack.rbegin()[1];
+    if (auto *d = parent->cast<ast_exp_deref_t>()) {
+      if (d->lhs == n) {
+        return;
+      }
+    }
+    if (auto *c = parent->cast<ast_exp_call_t>()) {
+      if (c->callee != n && is_pure_(c)) {
+        return;
+      }
+    }
+    escape_(n->decl);
+  }
+
+  void visit(ast_exp_member_t *n) override {
+    // all other members may be handled by a user callback
+    if (n->member->str_ != "length") {
+      escape_(n->decl);
+    }
+    ast_visitor_t::visit(n);
+  }
+
+  void visit(ast_stmt_assign_var_t *n) override {
+    escape_(n->decl);
+    ast_visitor_t::visit(n);
+  }
+
+  void visit(ast_stmt_assign_member_t *n) override {
+    escape_(n->decl);
+    ast_visitor_t::visit(n);
+  }
+
+  void visit(ast_program_t *p) override {
+    ast_visitor_t::visit(p);
+    for (auto &pair : candidates_) {
+      if (!escapes_.count(pair.first)) {
+        pair.second->in_frame = true;
+      }
+    }
+  }
+
+protected:
+  static bool is_pure_(const ast_exp_call_t *c) {
+    if (const auto *ident = c->callee->cast<ast_exp_ident_t>()) {
+      if (const auto *func = ident->decl->cast<ast_decl_func_t>()) {
+        return func->is_syscall && func->const_eval;
+      }
+    }
+    return false;
+  }
+
+  void escape_(const ast_node_t *decl) {
+    escapes_.insert(decl);
+  }
+
+  int32_t loops_;
+  std::map<const ast_decl_var_t*, ast_exp_array_init_t*> candidates_;
+  std::set<const ast_node_t*> escapes_;
+};
+
 // ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
 void run_optimize(nano_t &nano) {
   if (nano.optimize) {
     opt_post_ret_t    (nano).visit(&(nano.ast().program));
     opt_const_expr_t  (nano).visit(&(nano.ast().program));
+    opt_pure_call_t   (nano).visit(&(nano.ast().program));
+    // fold any expressions using the results of pure calls
+    opt_const_expr_t  (nano).visit(&(nano.ast().program));
     opt_if_remove_t   (nano).visit(&(nano.ast().program));
+    opt_loop_t        (nano).visit(&(nano.ast().program));
+    opt_array_escape_t(nano).visit(&(nano.ast().program));
 
 // we have to disable this at the moment since we need to teach it that asignments
 // can make values alias.
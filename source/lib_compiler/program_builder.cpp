@@ -5,8 +5,8 @@ namespace nano {
 void program_builder_t::set_line(lexer_t &lexer, const token_t *t) {
   (void)lexer;
   const uint32_t pc = head();
-  if (t) {
-    program_.add_line(pc, t->line_);
-  }
+  // instructions without a token are marked as having no line so that they
+  // are not counted as part of the line before them
+  program_.add_line(pc, t ? t->line_ : line_t{});
 }
 } // namespace nano
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "../lib_common/program.h"
+#include "../lib_common/source.h"
+
+#include "alloc_tracker.h"
+
+
+namespace {
+
+using namespace nano;
+
+typedef alloc_tracker_t::counts_t counts_t;
+
+struct row_t {
+  line_t line;
+  value_type_t type;
+  counts_t counts;
+};
+
+// merge sites on the same source line and sort by bytes
+std::vector<row_t> by_line(const std::map<alloc_tracker_t::key_t, counts_t> &in,
+                           const program_t &program) {
+  std::map<std::pair<line_t, value_type_t>, counts_t> lines;
+  for (const auto &i : in) {
+    const int32_t site = i.first.first;
+    // the site is just past the allocating instruction
+    const line_t line = site > 0 ? program.find_line(site - 1) : line_t{};
+    counts_t &c = lines[std::make_pair(line, i.first.second)];
+    c.count += i.second.count;
+    c.bytes += i.second.bytes;
+  }
+  std::vector<row_t> out;
+  for (const auto &l : lines) {
+    out.push_back(row_t{l.first.first, l.first.second, l.second});
+  }
+  std::stable_sort(out.begin(), out.end(), [](const row_t &a, const row_t &b) {
+    return a.counts.bytes > b.counts.bytes;
+  });
+  return out;
+}
+
+std::vector<row_t> by_type(const std::map<alloc_tracker_t::key_t, counts_t> &in) {
+  std::map<value_type_t, counts_t> types;
+  for (const auto &i : in) {
+    // all user types are reported together
+    const value_type_t type =
+        i.first.second >= val_type_user ? val_type_user : i.first.second;
+    counts_t &c = types[type];
+    c.count += i.second.count;
+    c.bytes += i.second.bytes;
+  }
+  std::vector<row_t> out;
+  for (const auto &t : types) {
+    out.push_back(row_t{line_t{}, t.first, t.second});
+  }
+  std::stable_sort(out.begin(), out.end(), [](const row_t &a, const row_t &b) {
+    return a.counts.bytes > b.counts.bytes;
+  });
+  return out;
+}
+
+void write_line(FILE *fd, line_t line, const source_manager_t *sources) {
+  if (line.file < 0) {
+    fprintf(fd, "(host)");
+  } else if (sources && line.file < sources->count()) {
+    fprintf(fd, "%s:%d", sources->get_source(line.file).file_path().c_str(),
+            line.line);
+  } else {
+    fprintf(fd, "%d:%d", line.file, line.line);
+  }
+}
+
+void write_rows(FILE *fd, const char *title, const std::vector<row_t> &rows,
+                size_t top, bool lines, const source_manager_t *sources) {
+  uint64_t total = 0;
+  for (const row_t &r : rows) {
+    total += r.counts.bytes;
+  }
+  fprintf(fd, "\n  %12s %10s  %-14s %s\n", "bytes", "count", "type", title);
+  for (size_t i = 0; i < rows.size() && i < top; ++i) {
+    const row_t &r = rows[i];
+    fprintf(fd, "  %12llu %10llu  %-14s ", (unsigned long long)r.counts.bytes,
+            (unsigned long long)r.counts.count, value_type_name(r.type));
+    if (lines) {
+      write_line(fd, r.line, sources);
+    }
+    fprintf(fd, "\n");
+  }
+  fprintf(fd, "  %12llu total\n", (unsigned long long)total);
+}
+
+} // namespace {}
+
+namespace nano {
+
+void alloc_tracker_t::write(FILE *fd, const program_t &program, size_t top,
+                            const source_manager_t *sources) const {
+  fprintf(fd, "allocations\n");
+  write_rows(fd, "", by_type(allocs_), top, false, sources);
+  write_rows(fd, "line", by_line(allocs_, program), top, true, sources);
+  fprintf(fd, "\nheap census after %llu collections\n",
+          (unsigned long long)collections_);
+  write_rows(fd, "", by_type(census_), top, false, sources);
+  write_rows(fd, "line", by_line(census_, program), top, true, sources);
+}
+
+} // namespace nano
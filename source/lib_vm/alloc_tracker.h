@@ -0,0 +1,126 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+#include "../lib_common/common.h"
+
+#include "value.h"
+
+
+namespace nano {
+
+struct source_manager_t;
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+//
+// allocation tracker
+//
+// records the count and bytes of each value allocated, keyed by the code
+// address of the allocating instruction and the value type.  every tracked
+// value is followed as the collector moves it so that a census of the live
+// heap, by type and by allocation site, can be taken at each collection.
+// note: the collector keeps everything allocated since the previous
+// collection, so the census includes those values whether reachable or not.
+//
+// allocations made by the host outside of a running thread have site -1.
+//
+struct alloc_tracker_t {
+
+  struct counts_t {
+    uint64_t count, bytes;
+  };
+
+  // allocation site and value type
+  typedef std::pair<int32_t, value_type_t> key_t;
+
+  alloc_tracker_t()
+    : pc_(nullptr)
+    , collections_(0)
+  {}
+
+  // set the pc allocations are attributed to, or nullptr for the host
+  void site(const int32_t *pc) {
+    pc_ = pc;
+  }
+
+  void on_alloc(const value_t *v, value_type_t type, size_t bytes) {
+    // the pc is just past the allocating instruction
+    const int32_t site = pc_ ? *pc_ : -1;
+    counts_t &c = allocs_[key_t{site, type}];
+    ++c.count;
+    c.bytes += bytes;
+    live_[v] = site;
+  }
+
+  // bytes allocated for a value after it was created, such as a new map table
+  void on_grow(value_type_t type, size_t bytes) {
+    const int32_t site = pc_ ? *pc_ : -1;
+    allocs_[key_t{site, type}].bytes += bytes;
+  }
+
+  // a value was copied into the to space during a collection
+  void on_move(const value_t *from, const value_t *to) {
+    auto itt = live_.find(from);
+    if (itt != live_.end()) {
+      moved_[to] = itt->second;
+    }
+  }
+
+  // called once tracing has finished.  values in the to space which were not
+  // moved were allocated since the last collection and are kept.
+  template <typename is_live_t, typename size_of_t>
+  void census(is_live_t is_live, size_of_t size_of) {
+    for (const auto &v : live_) {
+      if (is_live(v.first)) {
+        moved_[v.first] = v.second;
+      }
+    }
+    live_.swap(moved_);
+    moved_.clear();
+    census_.clear();
+    for (const auto &v : live_) {
+      counts_t &c = census_[key_t{v.second, v.first->type()}];
+      ++c.count;
+      c.bytes += size_of(v.first);
+    }
+    ++collections_;
+  }
+
+  // write the 'top' allocation sites and the last census, by value type and
+  // by source line.  'sources' if given is used to name files.
+  void write(FILE *fd, const program_t &program, size_t top,
+             const source_manager_t *sources = nullptr) const;
+
+  // the heap was emptied so stop following its values
+  void heap_reset() {
+    live_.clear();
+    moved_.clear();
+  }
+
+  void clear() {
+    allocs_.clear();
+    census_.clear();
+    live_.clear();
+    moved_.clear();
+    collections_ = 0;
+  }
+
+protected:
+  const int32_t *pc_;
+
+  // total allocations since tracking started
+  std::map<key_t, counts_t> allocs_;
+
+  // live values found by the last collection
+  std::map<key_t, counts_t> census_;
+  uint64_t collections_;
+
+  // allocation site of each tracked value
+  std::unordered_map<const value_t *, int32_t> live_;
+  std::unordered_map<const value_t *, int32_t> moved_;
+};
+
+} // namespace nano
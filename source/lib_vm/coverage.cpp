@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <string>
+
+#include "../lib_common/instructions.h"
+#include "../lib_common/program.h"
+#include "../lib_common/source.h"
+
+#include "coverage.h"
+
+
+namespace {
+
+using namespace nano;
+
+int32_t operand(const uint8_t *code, int32_t pc, int32_t index) {
+  int32_t out = 0;
+  memcpy(&out, code + pc + 1 + index * sizeof(int32_t), sizeof(out));
+  return out;
+}
+
+struct function_row_t {
+  int32_t line;
+  std::string name;
+  bool hit;
+};
+
+struct branch_row_t {
+  int32_t line, block;
+  bool taken, not_taken;
+};
+
+// coverage of one source file
+struct file_cover_t {
+  std::map<int32_t, bool> lines;
+  std::vector<function_row_t> functions;
+  std::vector<branch_row_t> branches;
+};
+
+} // namespace {}
+
+namespace nano {
+
+coverage_t::coverage_t(const program_t &program)
+  : program_(program)
+  , index_(program.size(), -1)
+{
+  const uint8_t *code = program.data();
+  const int32_t size = int32_t(program.size());
+  // find the first instruction of every basic block
+  std::vector<bool> leader(size + 1, false);
+  leader[0] = true;
+  for (const function_t &f : program.functions()) {
+    if (f.code_start_ >= 0 && f.code_start_ < size) {
+      leader[f.code_start_] = true;
+    }
+  }
+  for (int32_t pc = 0; pc < size;) {
+    const instruction_e ins = instruction_e(code[pc]);
+    const int32_t next = pc + ins_size(ins);
+    if (ins_will_branch(ins)) {
+      int32_t target = -1;
+      switch (ins) {
+      case INS_JMP:
+      case INS_TJMP:
+      case INS_FJMP:
+        target = operand(code, pc, 0);
+        break;
+      case INS_CALL:
+      case INS_FOR:
+        target = operand(code, pc, 1);
+        break;
+      default:
+        break;
+      }
+      if (target >= 0 && target < size) {
+        leader[target] = true;
+      }
+      leader[std::min(next, size)] = true;
+      if (ins == INS_TJMP || ins == INS_FJMP || ins == INS_FOR) {
+        branches_.push_back(branch_t{pc, target, false, false});
+      }
+    }
+    pc = next;
+  }
+  // form the blocks and place a probe at the start of each
+  for (int32_t pc = 0; pc < size;) {
+    int32_t end = pc + ins_size(instruction_e(code[pc]));
+    while (end < size && !leader[end]) {
+      end += ins_size(instruction_e(code[end]));
+    }
+    index_[pc] = int32_t(probes_.size());
+    probes_.push_back(probe_t{int32_t(blocks_.size()), -1, false});
+    probe_pcs_.push_back(pc);
+    blocks_.push_back(block_t{pc, end, false});
+    pc = end;
+  }
+  // and on every conditional branch
+  for (size_t i = 0; i < branches_.size(); ++i) {
+    const int32_t pc = branches_[i].pc;
+    if (index_[pc] < 0) {
+      index_[pc] = int32_t(probes_.size());
+      probes_.push_back(probe_t{-1, -1, false});
+      probe_pcs_.push_back(pc);
+    }
+    probes_[index_[pc]].branch = int32_t(i);
+  }
+}
+
+bool coverage_t::hit(int32_t pc, int32_t next) {
+  const int32_t i = probe_index_(pc);
+  if (i < 0) {
+    return true;
+  }
+  probe_t &p = probes_[i];
+  if (p.block >= 0) {
+    blocks_[p.block].hit = true;
+  }
+  if (p.branch >= 0) {
+    branch_t &b = branches_[p.branch];
+    (next == b.target ? b.taken : b.not_taken) = true;
+    p.done = b.taken && b.not_taken;
+  } else {
+    p.done = true;
+  }
+  return p.done;
+}
+
+size_t coverage_t::blocks_hit() const {
+  size_t out = 0;
+  for (const block_t &b : blocks_) {
+    out += b.hit ? 1 : 0;
+  }
+  return out;
+}
+
+void coverage_t::write_lcov(FILE *fd, const source_manager_t *sources) const {
+  const uint8_t *code = program_.data();
+  std::map<int32_t, file_cover_t> files;
+  // a line is covered if any block it has code in was executed
+  for (const block_t &b : blocks_) {
+    for (int32_t pc = b.start; pc < b.end;
+         pc += ins_size(instruction_e(code[pc]))) {
+      const line_t line = program_.find_line(pc);
+      if (line.file < 0 || line.line < 1) {
+        continue;
+      }
+      bool &hit = files[line.file].lines[line.line];
+      hit |= b.hit;
+    }
+  }
+  for (const function_t &f : program_.functions()) {
+    const line_t line = program_.find_line(f.code_start_);
+    const int32_t i = probe_index_(f.code_start_);
+    if (line.file < 0 || line.line < 1 || i < 0 || probes_[i].block < 0) {
+      continue;
+    }
+    files[line.file].functions.push_back(
+        function_row_t{line.line, f.name(), blocks_[probes_[i].block].hit});
+  }
+  for (size_t i = 0; i < branches_.size(); ++i) {
+    const branch_t &b = branches_[i];
+    const line_t line = program_.find_line(b.pc);
+    if (line.file < 0 || line.line < 1) {
+      continue;
+    }
+    files[line.file].branches.push_back(
+        branch_row_t{line.line, int32_t(i), b.taken, b.not_taken});
+  }
+  // one record per source file
+  for (const auto &i : files) {
+    const file_cover_t &file = i.second;
+    fprintf(fd, "TN:\n");
+    if (sources && i.first < sources->count()) {
+      fprintf(fd, "SF:%s\n", sources->get_source(i.first).file_path().c_str());
+    } else {
+      fprintf(fd, "SF:%d\n", i.first);
+    }
+    int32_t fn_hit = 0;
+    for (const function_row_t &f : file.functions) {
+      fprintf(fd, "FN:%d,%s\n", f.line, f.name.c_str());
+    }
+    for (const function_row_t &f : file.functions) {
+      fprintf(fd, "FNDA:%d,%s\n", f.hit ? 1 : 0, f.name.c_str());
+      fn_hit += f.hit ? 1 : 0;
+    }
+    fprintf(fd, "FNF:%d\nFNH:%d\n", int32_t(file.functions.size()), fn_hit);
+    int32_t br_hit = 0;
+    for (const branch_row_t &b : file.branches) {
+      // '-' marks a branch which was never reached
+      if (!b.taken && !b.not_taken) {
+        fprintf(fd, "BRDA:%d,%d,0,-\nBRDA:%d,%d,1,-\n", b.line, b.block,
+                b.line, b.block);
+        continue;
+      }
+      fprintf(fd, "BRDA:%d,%d,0,%d\nBRDA:%d,%d,1,%d\n", b.line, b.block,
+              b.taken ? 1 : 0, b.line, b.block, b.not_taken ? 1 : 0);
+      br_hit += (b.taken ? 1 : 0) + (b.not_taken ? 1 : 0);
+    }
+    fprintf(fd, "BRF:%d\nBRH:%d\n", int32_t(file.branches.size() * 2),
+            br_hit);
+    int32_t ln_hit = 0;
+    for (const auto &l : file.lines) {
+      fprintf(fd, "DA:%d,%d\n", l.first, l.second ? 1 : 0);
+      ln_hit += l.second ? 1 : 0;
+    }
+    fprintf(fd, "LF:%d\nLH:%d\n", int32_t(file.lines.size()), ln_hit);
+    fprintf(fd, "end_of_record\n");
+  }
+}
+
+} // namespace nano
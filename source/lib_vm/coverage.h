@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "../lib_common/common.h"
+#include "../lib_common/types.h"
+
+
+namespace nano {
+
+struct source_manager_t;
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+//
+// code coverage
+//
+// the bytecode is split into basic blocks which start at function entry
+// points, branch targets and after instructions which can branch.  the vm
+// patches a probe over the first instruction of every block and over every
+// conditional branch.  a block probe is removed the first time it executes
+// and a branch probe once both outcomes have been seen, so covered code runs
+// at full speed.  compiled and native code is not covered.
+//
+struct coverage_t {
+
+  coverage_t(const program_t &program);
+
+  // code addresses to place probes at
+  const std::vector<int32_t> &probes() const {
+    return probe_pcs_;
+  }
+
+  // true if 'pc' holds a probe which has not finished
+  bool pending(int32_t pc) const {
+    const int32_t i = probe_index_(pc);
+    return i >= 0 && !probes_[i].done;
+  }
+
+  // record execution of the probe at 'pc' which left the pc at 'next'.
+  // returns true when the probe has nothing more to record.
+  bool hit(int32_t pc, int32_t next);
+
+  size_t blocks() const {
+    return blocks_.size();
+  }
+
+  size_t blocks_hit() const;
+
+  // write the line, function and branch coverage as an lcov tracefile.
+  // 'sources' if given is used to name files.
+  void write_lcov(FILE *fd, const source_manager_t *sources = nullptr) const;
+
+protected:
+  struct block_t {
+    int32_t start, end;
+    bool hit;
+  };
+
+  // a conditional branch, 'taken' when it jumped to its target
+  struct branch_t {
+    int32_t pc, target;
+    bool taken, not_taken;
+  };
+
+  struct probe_t {
+    int32_t block;
+    int32_t branch;
+    bool done;
+  };
+
+  int32_t probe_index_(int32_t pc) const {
+    return (pc >= 0 && pc < int32_t(index_.size())) ? index_[pc] : -1;
+  }
+
+  const program_t &program_;
+
+  std::vector<block_t> blocks_;
+  std::vector<branch_t> branches_;
+  std::vector<probe_t> probes_;
+  std::vector<int32_t> probe_pcs_;
+
+  // probe for each code address, or -1
+  std::vector<int32_t> index_;
+};
+
+} // namespace nano
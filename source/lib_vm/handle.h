@@ -0,0 +1,146 @@
+#pragma once
+#include <cassert>
+#include <cstdint>
+
+#include "vm.h"
+
+
+namespace nano {
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+//
+// persistent handle to a value held by the host
+//
+// the value stays alive and is kept up to date across garbage collections
+// until the handle is destroyed or reset.  use get() each time the value is
+// needed rather than holding on to the raw pointer.
+//
+struct handle_t {
+
+  handle_t()
+    : vm_(nullptr)
+    , index_(-1)
+  {}
+
+  handle_t(vm_t &vm, value_t *v)
+    : vm_(&vm)
+    , index_(vm.handle_new(v))
+  {}
+
+  handle_t(const handle_t &h)
+    : vm_(h.vm_)
+    , index_(h.vm_ ? h.vm_->handle_new(h.get()) : -1)
+  {}
+
+  handle_t(handle_t &&h)
+    : vm_(h.vm_)
+    , index_(h.index_)
+  {
+    h.vm_ = nullptr;
+    h.index_ = -1;
+  }
+
+  ~handle_t() {
+    reset();
+  }
+
+  handle_t &operator = (const handle_t &h) {
+    if (this != &h) {
+      reset();
+      if (h.vm_) {
+        vm_ = h.vm_;
+        index_ = vm_->handle_new(h.get());
+      }
+    }
+    return *this;
+  }
+
+  handle_t &operator = (handle_t &&h) {
+    if (this != &h) {
+      reset();
+      vm_ = h.vm_;
+      index_ = h.index_;
+      h.vm_ = nullptr;
+      h.index_ = -1;
+    }
+    return *this;
+  }
+
+  // release the handle
+  void reset() {
+    if (vm_) {
+      vm_->handle_release(index_);
+    }
+    vm_ = nullptr;
+    index_ = -1;
+  }
+
+  // return the current location of the value
+  value_t *get() const {
+    return vm_ ? vm_->handle_get(index_) : nullptr;
+  }
+
+  // change the value held
+  void set(value_t *v) {
+    assert(vm_);
+    vm_->handle_set(index_, v);
+  }
+
+  bool valid() const {
+    return vm_ != nullptr;
+  }
+
+protected:
+  vm_t *vm_;
+  int32_t index_;
+};
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+//
+// scope for short lived handles
+//
+// handles created with add() are cheap, stack allocated slots which are all
+// released when the scope is destroyed.  scopes must be destroyed in the
+// reverse order they were created.
+//
+struct handle_scope_t {
+
+  // a handle owned by a scope
+  struct local_t {
+
+    value_t *get() const {
+      return vm_.scoped_[index_];
+    }
+
+    void set(value_t *v) {
+      vm_.scoped_[index_] = v;
+    }
+
+    vm_t &vm_;
+    size_t index_;
+  };
+
+  handle_scope_t(vm_t &vm)
+    : vm_(vm)
+    , base_(vm.scoped_.size())
+  {}
+
+  ~handle_scope_t() {
+    assert(vm_.scoped_.size() >= base_);
+    vm_.scoped_.resize(base_);
+  }
+
+  local_t add(value_t *v) {
+    vm_.scoped_.push_back(v);
+    return local_t{vm_, vm_.scoped_.size() - 1};
+  }
+
+protected:
+  handle_scope_t(const handle_scope_t &) = delete;
+  handle_scope_t &operator = (const handle_scope_t &) = delete;
+
+  vm_t &vm_;
+  const size_t base_;
+};
+
+} // namespace nano
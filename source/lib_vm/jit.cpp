@@ -0,0 +1,406 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+#include "../lib_common/instructions.h"
+#include "../lib_common/program.h"
+
+#include "jit.h"
+#include "native.h"
+#include "thread.h"
+
+#if NANO_JIT_SUPPORTED
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if NANO_JIT_SUPPORTED
+
+
+namespace {
+
+using namespace nano;
+
+// every instruction handler shares this signature so that the call sequence
+// we emit is the same for all of them.  'pc' is the address following the
+// instruction, where the interpreter would have its program counter.
+//
+//    rdi = thread, esi = operand 1, edx = operand 2, ecx = pc
+//
+typedef int32_t(*handler_t)(thread_t *t, int32_t o1, int32_t o2, int32_t pc);
+
+// return non zero if the thread raised an error
+template <void (native_t::*method)()>
+int32_t op0(thread_t *t, int32_t, int32_t, int32_t pc) {
+  native_t n(*t);
+  n.at(pc);
+  (n.*method)();
+  return n.failed();
+}
+
+template <void (native_t::*method)(int32_t)>
+int32_t op1(thread_t *t, int32_t o1, int32_t, int32_t pc) {
+  native_t n(*t);
+  n.at(pc);
+  (n.*method)(o1);
+  return n.failed();
+}
+
+template <void (native_t::*method)(int32_t, int32_t)>
+int32_t op2(thread_t *t, int32_t o1, int32_t o2, int32_t pc) {
+  native_t n(*t);
+  n.at(pc);
+  (n.*method)(o1, o2);
+  return n.failed();
+}
+
+// calls also return non zero if the thread halted so the interpreter takes
+// over from the instruction after the call
+template <void (native_t::*method)(int32_t)>
+int32_t call1(thread_t *t, int32_t o1, int32_t, int32_t pc) {
+  native_t n(*t);
+  n.at(pc);
+  (n.*method)(o1);
+  return n.failed() || n.halted();
+}
+
+template <void (native_t::*method)(int32_t, int32_t)>
+int32_t call2(thread_t *t, int32_t o1, int32_t o2, int32_t pc) {
+  native_t n(*t);
+  n.at(pc);
+  (n.*method)(o1, o2);
+  return n.failed() || n.halted();
+}
+
+int32_t op_new_flt(thread_t *t, int32_t o1, int32_t, int32_t) {
+  native_t n(*t);
+  n.new_flt(uint32_t(o1));
+  return 0;
+}
+
+// return 1 if the branch condition is true
+int32_t op_pop_bool(thread_t *t, int32_t, int32_t, int32_t) {
+  return native_t(*t).pop_bool() ? 1 : 0;
+}
+
+// return 1 to branch, 2 on error
+int32_t op_for(thread_t *t, int32_t o1, int32_t, int32_t pc) {
+  native_t n(*t);
+  n.at(pc);
+  if (n.for_(o1)) {
+    return 1;
+  }
+  return n.failed() ? 2 : 0;
+}
+
+int32_t op_tick(thread_t *t, int32_t, int32_t, int32_t) {
+  native_t(*t).tick();
+  return 0;
+}
+
+// fall back to the interpreter for the rest of this function
+int32_t op_interpret(thread_t *t, int32_t, int32_t, int32_t pc) {
+  native_t(*t).interpret(pc);
+  return 1;
+}
+
+handler_t get_handler(instruction_e ins) {
+  switch (ins) {
+  case INS_ADD:       return op0<&native_t::add>;
+  case INS_SUB:       return op0<&native_t::sub>;
+  case INS_MUL:       return op0<&native_t::mul>;
+  case INS_DIV:       return op0<&native_t::div>;
+  case INS_MOD:       return op0<&native_t::mod>;
+  case INS_AND:       return op0<&native_t::and_>;
+  case INS_OR:        return op0<&native_t::or_>;
+  case INS_NOT:       return op0<&native_t::not_>;
+  case INS_NEG:       return op0<&native_t::neg>;
+  case INS_LT:        return op0<&native_t::lt>;
+  case INS_GT:        return op0<&native_t::gt>;
+  case INS_LEQ:       return op0<&native_t::leq>;
+  case INS_GEQ:       return op0<&native_t::geq>;
+  case INS_EQ:        return op0<&native_t::eq>;
+  case INS_TJMP:
+  case INS_FJMP:      return op_pop_bool;
+  case INS_FOR:       return op_for;
+  case INS_CALL:      return call2<&native_t::call>;
+  case INS_RET:       return op1<&native_t::ret>;
+  case INS_SCALL:     return call2<&native_t::scall>;
+  case INS_ICALL:     return call1<&native_t::icall>;
+  case INS_POP:       return op1<&native_t::pop>;
+  case INS_NEW_ARY:   return op1<&native_t::new_ary>;
+  case INS_NEW_INT:   return op1<&native_t::new_int>;
+  case INS_NEW_STR:   return op1<&native_t::new_str>;
+  case INS_NEW_NONE:  return op0<&native_t::new_none>;
+  case INS_NEW_FLT:   return op_new_flt;
+  case INS_NEW_FUNC:  return op1<&native_t::new_func>;
+  case INS_NEW_SCALL: return op1<&native_t::new_scall>;
+  case INS_LOCALS:    return op1<&native_t::locals>;
+  case INS_GLOBALS:   return op1<&native_t::globals>;
+  case INS_GETV:      return op1<&native_t::getv>;
+  case INS_SETV:      return op1<&native_t::setv>;
+  case INS_GETG:      return op1<&native_t::getg>;
+  case INS_SETG:      return op1<&native_t::setg>;
+  case INS_DEREF:     return op0<&native_t::deref>;
+  case INS_SETA:      return op0<&native_t::seta>;
+  case INS_GETM:      return op1<&native_t::getm>;
+  case INS_SETM:      return op1<&native_t::setm>;
+  case INS_ARY_INIT:  return op1<&native_t::ary_init>;
+  case INS_ARY_LOCAL: return op1<&native_t::ary_local>;
+  default:            return nullptr;
+  }
+}
+
+int32_t read_operand(const uint8_t *ptr) {
+  int32_t out;
+  memcpy(&out, ptr, sizeof(out));
+  return out;
+}
+
+// minimal x86-64 code emitter
+struct emitter_t {
+
+  void byte(uint8_t b) {
+    code.push_back(b);
+  }
+
+  void bytes(std::initializer_list<uint8_t> list) {
+    code.insert(code.end(), list.begin(), list.end());
+  }
+
+  void imm32(int32_t v) {
+    const uint8_t *p = (const uint8_t*)&v;
+    code.insert(code.end(), p, p + sizeof(v));
+  }
+
+  void imm64(uint64_t v) {
+    const uint8_t *p = (const uint8_t*)&v;
+    code.insert(code.end(), p, p + sizeof(v));
+  }
+
+  // call handler(rbx, o1, o2, pc)
+  void call(handler_t handler, int32_t o1, int32_t o2, int32_t pc) {
+    bytes({0x48, 0x89, 0xdf});  // mov rdi, rbx
+    byte(0xbe);                 // mov esi, imm32
+    imm32(o1);
+    byte(0xba);                 // mov edx, imm32
+    imm32(o2);
+    byte(0xb9);                 // mov ecx, imm32
+    imm32(pc);
+    bytes({0x48, 0xb8});        // mov rax, imm64
+    imm64(uint64_t(handler));
+    bytes({0xff, 0xd0});        // call rax
+  }
+
+  void test_eax() {
+    bytes({0x85, 0xc0});        // test eax, eax
+  }
+
+  void cmp_eax_1() {
+    bytes({0x83, 0xf8, 0x01});  // cmp eax, 1
+  }
+
+  // branches to a bytecode address
+  void jmp(int32_t target)  { byte(0xe9);         fixup(target); }
+  void jz(int32_t target)   { bytes({0x0f, 0x84}); fixup(target); }
+  void jnz(int32_t target)  { bytes({0x0f, 0x85}); fixup(target); }
+
+  // branch target for the function epilogue
+  static const int32_t exit = -1;
+
+  void fixup(int32_t target) {
+    fixups.push_back(fixup_t{code.size(), target});
+    imm32(0);
+  }
+
+  // resolve all branch targets
+  bool link(const std::unordered_map<int32_t, size_t> &labels,
+            size_t epilogue) {
+    for (const fixup_t &f : fixups) {
+      size_t dst = epilogue;
+      if (f.target != exit) {
+        auto itt = labels.find(f.target);
+        if (itt == labels.end()) {
+          return false;
+        }
+        dst = itt->second;
+      }
+      const int32_t rel = int32_t(dst) - int32_t(f.offset + 4);
+      memcpy(code.data() + f.offset, &rel, sizeof(rel));
+    }
+    return true;
+  }
+
+  struct fixup_t {
+    size_t offset;
+    int32_t target;
+  };
+
+  std::vector<uint8_t> code;
+  std::vector<fixup_t> fixups;
+};
+
+} // namespace {}
+#endif // NANO_JIT_SUPPORTED
+
+namespace nano {
+
+jit_t::jit_t(vm_t &vm)
+  : enabled(true)
+  , threshold(default_threshold)
+  , vm_(vm)
+{
+  if (const char *force = getenv("NANO_JIT_THRESHOLD")) {
+    threshold = uint32_t(std::max(1, atoi(force)));
+  }
+}
+
+jit_t::~jit_t() {
+#if NANO_JIT_SUPPORTED
+  for (const region_t &r : regions_) {
+    munmap(r.data, r.size);
+  }
+#endif
+}
+
+nano_native_t jit_t::on_call(int32_t addr) {
+  uint32_t &count = counters_[addr];
+  if (++count < threshold) {
+    return nullptr;
+  }
+  // only try to compile a function once
+  auto itt = compiled_.find(addr);
+  if (itt != compiled_.end()) {
+    return itt->second;
+  }
+  nano_native_t func = compile_(addr);
+  compiled_[addr] = func;
+  if (func) {
+    vm_.native_register(addr, func);
+  }
+  return func;
+}
+
+void jit_t::deopt() {
+  enabled = false;
+  for (const auto &pair : compiled_) {
+    if (pair.second) {
+      vm_.native_unregister(pair.first);
+    }
+  }
+  compiled_.clear();
+}
+
+nano_native_t jit_t::compile_(int32_t addr) {
+#if !NANO_JIT_SUPPORTED
+  (void)addr;
+  return nullptr;
+#else
+  const program_t &prog = vm_.program();
+  const function_t *func = prog.function_find(addr);
+  if (!func || func->code_start_ != addr) {
+    return nullptr;
+  }
+  const uint8_t *code = prog.data();
+
+  // collect branch targets so we can let the collector run on loops
+  std::unordered_map<int32_t, size_t> labels;
+  for (int32_t pc = func->code_start_; pc < func->code_end_;) {
+    const instruction_e ins = instruction_e(code[pc]);
+    if (ins == INS_JMP || ins == INS_TJMP || ins == INS_FJMP) {
+      labels[read_operand(code + pc + 1)] = 0;
+    }
+    if (ins == INS_FOR) {
+      labels[read_operand(code + pc + 5)] = 0;
+    }
+    pc += ins_size(ins);
+  }
+
+  emitter_t e;
+  e.byte(0x53);                 // push rbx
+  e.bytes({0x48, 0x89, 0xfb});  // mov rbx, rdi
+  e.call(op_tick, 0, 0, 0);
+
+  for (int32_t pc = func->code_start_; pc < func->code_end_;) {
+    const instruction_e ins = instruction_e(code[pc]);
+    const int32_t size = ins_size(ins);
+    const int32_t next = pc + size;
+    const int32_t o1 = ins_has_operand(ins) ? read_operand(code + pc + 1) : 0;
+    const int32_t o2 = ins_has_two_operands(ins) ?
+                       read_operand(code + pc + 5) : 0;
+
+    auto label = labels.find(pc);
+    if (label != labels.end()) {
+      label->second = e.code.size();
+      e.call(op_tick, 0, 0, 0);
+    }
+
+    const handler_t handler = get_handler(ins);
+    switch (ins) {
+    case INS_JMP:
+      e.jmp(o1);
+      break;
+    case INS_TJMP:
+      e.call(handler, 0, 0, next);
+      e.test_eax();
+      e.jnz(o1);
+      break;
+    case INS_FJMP:
+      e.call(handler, 0, 0, next);
+      e.test_eax();
+      e.jz(o1);
+      break;
+    case INS_FOR:
+      e.call(handler, o1, 0, next);
+      e.cmp_eax_1();
+      e.jz(o2);
+      e.test_eax();
+      e.jnz(emitter_t::exit);
+      break;
+    case INS_RET:
+      e.call(handler, o1, 0, next);
+      e.jmp(emitter_t::exit);
+      break;
+    default:
+      if (!handler) {
+        // unsupported so let the interpreter take over from here
+        e.call(op_interpret, 0, 0, pc);
+        e.jmp(emitter_t::exit);
+        break;
+      }
+      e.call(handler, o1, o2, next);
+      e.test_eax();
+      e.jnz(emitter_t::exit);
+      break;
+    }
+    pc = next;
+  }
+
+  const size_t epilogue = e.code.size();
+  e.byte(0x5b);                 // pop rbx
+  e.byte(0xc3);                 // ret
+
+  if (!e.link(labels, epilogue)) {
+    return nullptr;
+  }
+
+  // copy into executable memory
+  const size_t page = size_t(sysconf(_SC_PAGESIZE));
+  const size_t size = ((e.code.size() + page - 1) / page) * page;
+  void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    return nullptr;
+  }
+  memcpy(mem, e.code.data(), e.code.size());
+  if (mprotect(mem, size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(mem, size);
+    return nullptr;
+  }
+  regions_.push_back(region_t{mem, size});
+  return nano_native_t(mem);
+#endif // NANO_JIT_SUPPORTED
+}
+
+} // namespace nano
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "../lib_common/common.h"
+
+#include "vm.h"
+
+#if defined(NANO_JIT) && defined(__x86_64__) && defined(__linux__)
+#define NANO_JIT_SUPPORTED 1
+#else
+#define NANO_JIT_SUPPORTED 0
+#endif
+
+
+namespace nano {
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+//
+// baseline x86-64 JIT compiler
+//
+// hot functions are translated into a sequence of calls to the same
+// instruction handlers the interpreter uses, with operands passed as
+// immediates and branches resolved to native jumps.  compiled functions are
+// installed as native functions on the vm, and so are entered by CALL and
+// ICALL just like ahead-of-time compiled code.
+//
+struct jit_t {
+
+  jit_t(vm_t &vm);
+  ~jit_t();
+
+  // count a call to a function, returning compiled code once it is hot
+  nano_native_t on_call(int32_t addr);
+
+  // count a backwards jump within a function
+  void on_back_edge(int32_t addr) {
+    counters_[addr] += back_edge_weight;
+  }
+
+  // remove all compiled functions so execution stays in the interpreter
+  void deopt();
+
+  bool enabled;
+
+  // counter value at which a function is compiled, which NANO_JIT_THRESHOLD
+  // overrides
+  uint32_t threshold;
+  static const uint32_t default_threshold = 1000;
+  static const uint32_t back_edge_weight = 10;
+
+protected:
+  // compile a function, returning nullptr if it could not be compiled
+  nano_native_t compile_(int32_t addr);
+
+  vm_t &vm_;
+
+  // call and back-edge counters keyed by function address
+  std::unordered_map<int32_t, uint32_t> counters_;
+
+  // functions which we have compiled
+  std::unordered_map<int32_t, nano_native_t> compiled_;
+
+  // executable code regions
+  struct region_t {
+    void *data;
+    size_t size;
+  };
+  std::vector<region_t> regions_;
+};
+
+} // namespace nano
@@ -0,0 +1,148 @@
+#pragma once
+#include <cstdint>
+
+#include "../lib_common/program.h"
+
+#include "thread.h"
+#include "vm.h"
+
+
+namespace nano {
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+//
+// runtime interface for ahead-of-time compiled code
+//
+// each method does the same work as the matching instruction in the
+// interpreter, but with its operands passed in directly.  control flow is
+// left to the caller.  after any method that can raise an error the caller
+// should check failed() and unwind.  after a call the caller should also
+// check halted() and return, leaving the interpreter to carry on from the
+// thread's program counter when it is resumed.
+//
+struct native_t {
+
+  native_t(thread_t &t)
+    : t_(t)
+  {}
+
+  bool failed() const {
+    return t_.has_error();
+  }
+
+  // true if a syscall such as wait() halted the thread
+  bool halted() const {
+    return t_.halted_;
+  }
+
+  // give the garbage collector a chance to run
+  void tick() {
+    t_.tick_gc_(0);
+  }
+
+  // set the program counter so errors and get_source_line() report the
+  // instruction being executed
+  void at(int32_t pc) {
+    t_.pc_ = pc;
+  }
+
+  // interpret the current function from 'pc' until it returns
+  void interpret(int32_t pc) {
+    const size_t depth = t_.f_.size();
+    t_.pc_ = pc;
+    run_(depth - 1);
+  }
+
+  // arithmetic and logic
+  void add()  { t_.do_INS_ADD_(); }
+  void sub()  { t_.do_INS_SUB_(); }
+  void mul()  { t_.do_INS_MUL_(); }
+  void div()  { t_.do_INS_DIV_(); }
+  void mod()  { t_.do_INS_MOD_(); }
+  void and_() { t_.do_INS_AND_(); }
+  void or_()  { t_.do_INS_OR_();  }
+  void not_() { t_.do_INS_NOT_(); }
+  void neg()  { t_.do_INS_NEG_(); }
+  void lt()   { t_.do_INS_LT_();  }
+  void gt()   { t_.do_INS_GT_();  }
+  void leq()  { t_.do_INS_LEQ_(); }
+  void geq()  { t_.do_INS_GEQ_(); }
+  void eq()   { t_.do_INS_EQ_();  }
+
+  // pop a branch condition
+  bool pop_bool() {
+    // note: test for none here as the nullptr check in value_t::type() may
+    //       be optimized away once inlined
+    const value_t *v = t_.stack_.pop();
+    return v && v->as_bool();
+  }
+
+  // enter the frame for a function call
+  void enter(int32_t callee) {
+    t_.enter_(t_.stack_.head(), t_.pc_, callee);
+  }
+
+  void ret(int32_t operand) {
+    t_.do_INS_RET_(operand);
+  }
+
+  void scall(int32_t num_args, int32_t index) {
+    t_.do_INS_SCALL_(num_args, index);
+  }
+
+  // call a function
+  //
+  // note: callees without a native function are interpreted until they
+  //       return to keep the native stack in step with the frame stack.
+  void call(int32_t num_args, int32_t callee) {
+    const size_t depth = t_.f_.size();
+    t_.do_INS_CALL_(num_args, callee);
+    run_(depth);
+  }
+
+  // indirect call
+  void icall(int32_t num_args) {
+    const size_t depth = t_.f_.size();
+    t_.do_INS_ICALL_(num_args);
+    run_(depth);
+  }
+
+  void pop(int32_t operand)       { t_.do_INS_POP_(operand);       }
+  void new_ary(int32_t operand)   { t_.do_INS_NEW_ARY_(operand);   }
+  void new_int(int32_t operand)   { t_.do_INS_NEW_INT_(operand);   }
+  void new_str(int32_t operand)   { t_.do_INS_NEW_STR_(operand);   }
+  void new_none()                 { t_.do_INS_NEW_NONE_();         }
+  void new_flt(uint32_t bits)     { t_.do_INS_NEW_FLT_(int32_t(bits)); }
+  void new_func(int32_t operand)  { t_.do_INS_NEW_FUNC_(operand);  }
+  void new_scall(int32_t operand) { t_.do_INS_NEW_SCALL_(operand); }
+  void locals(int32_t operand)    { t_.do_INS_LOCALS_(operand);    }
+  void globals(int32_t operand)   { t_.do_INS_GLOBALS_(operand);   }
+  void getv(int32_t operand)      { t_.do_INS_GETV_(operand);      }
+  void setv(int32_t operand)      { t_.do_INS_SETV_(operand);      }
+  void getg(int32_t operand)      { t_.do_INS_GETG_(operand);      }
+  void setg(int32_t operand)      { t_.do_INS_SETG_(operand);      }
+  void deref()                    { t_.do_INS_DEREF_();            }
+  void seta()                     { t_.do_INS_SETA_();             }
+  void getm(int32_t operand)      { t_.do_INS_GETM_(operand);      }
+  void setm(int32_t operand)      { t_.do_INS_SETM_(operand);      }
+  void ary_init(int32_t operand)  { t_.do_INS_ARY_INIT_(operand);  }
+  void ary_local(int32_t operand) { t_.do_INS_ARY_LOCAL_(operand); }
+
+  // step a counted loop, returning true if it should continue
+  bool for_(int32_t offs) {
+    return t_.do_INS_FOR_(offs);
+  }
+
+protected:
+  // interpret until the frame stack unwinds to 'depth' or the thread halts
+  void run_(size_t depth) {
+    while (t_.f_.size() > depth && !t_.finished_ && !t_.halted_) {
+      t_.tick_gc_(0);
+      t_.step_imp_();
+    }
+  }
+
+  thread_t &t_;
+};
+
+} // namespace nano
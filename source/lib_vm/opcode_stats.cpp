@@ -0,0 +1,93 @@
+#include <algorithm>
+
+#include "opcode_stats.h"
+
+
+namespace {
+
+using namespace nano;
+
+const char *type_name(size_t index) {
+  return index + 1 == opcode_stats_t::num_types ?
+    "user" : value_type_name(value_type_t(index));
+}
+
+// return the indices of the 'top' largest non zero counts
+std::vector<size_t> top_counts(const uint64_t *counts, size_t size,
+                               size_t top) {
+  std::vector<size_t> out;
+  for (size_t i = 0; i < size; ++i) {
+    if (counts[i]) {
+      out.push_back(i);
+    }
+  }
+  std::stable_sort(out.begin(), out.end(), [&](size_t a, size_t b) {
+    return counts[a] > counts[b];
+  });
+  if (out.size() > top) {
+    out.resize(top);
+  }
+  return out;
+}
+
+double percent(uint64_t count, uint64_t total) {
+  return total ? (100.0 * double(count)) / double(total) : 0.0;
+}
+
+const char *mnemonic(size_t op) {
+  return ins_mnemonic(instruction_e(op));
+}
+
+} // namespace {}
+
+namespace nano {
+
+opcode_stats_t::opcode_stats_t(size_t code_size)
+  : hits_(code_size, 0)
+  , bigrams_(__INS_COUNT__ * __INS_COUNT__, 0)
+  , binary_(__INS_COUNT__ * num_types * num_types, 0)
+  , prev_(__INS_COUNT__)
+{
+  ops_.fill(0);
+}
+
+void opcode_stats_t::clear() {
+  std::fill(hits_.begin(), hits_.end(), 0);
+  std::fill(bigrams_.begin(), bigrams_.end(), 0);
+  std::fill(binary_.begin(), binary_.end(), 0);
+  ops_.fill(0);
+  prev_ = __INS_COUNT__;
+}
+
+void opcode_stats_t::write(FILE *fd, size_t top) const {
+  uint64_t total = 0;
+  for (uint64_t c : ops_) {
+    total += c;
+  }
+  fprintf(fd, "opcode stats: %llu instructions\n", (unsigned long long)total);
+
+  fprintf(fd, "\n  %6s %12s  %s\n", "", "count", "opcode");
+  for (size_t i : top_counts(ops_.data(), ops_.size(), top)) {
+    fprintf(fd, "  %5.1f%% %12llu  %s\n", percent(ops_[i], total),
+            (unsigned long long)ops_[i], mnemonic(i));
+  }
+
+  fprintf(fd, "\n  %6s %12s  %s\n", "", "count", "bigram");
+  for (size_t i : top_counts(bigrams_.data(), bigrams_.size(), top)) {
+    fprintf(fd, "  %5.1f%% %12llu  %s %s\n", percent(bigrams_[i], total),
+            (unsigned long long)bigrams_[i], mnemonic(i / __INS_COUNT__),
+            mnemonic(i % __INS_COUNT__));
+  }
+
+  fprintf(fd, "\n  %6s %12s  %s\n", "", "count", "binary operands");
+  for (size_t i : top_counts(binary_.data(), binary_.size(), top)) {
+    const size_t op = i / (num_types * num_types);
+    const size_t lhs = (i / num_types) % num_types;
+    const size_t rhs = i % num_types;
+    fprintf(fd, "  %5.1f%% %12llu  %s %s %s\n", percent(binary_[i], ops_[op]),
+            (unsigned long long)binary_[i], mnemonic(op), type_name(lhs),
+            type_name(rhs));
+  }
+}
+
+} // namespace nano
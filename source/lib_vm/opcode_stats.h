@@ -0,0 +1,90 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "../lib_common/instructions.h"
+
+#include "value.h"
+
+// count every instruction executed by the interpreter when built with
+// NANO_OPCODE_STATS.  this slows down the interpreter loop so it is off by
+// default.
+#if !defined(NANO_OPCODE_STATS)
+#define NANO_OPCODE_STATS 0
+#endif
+
+
+namespace nano {
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+//
+// dynamic instruction mix
+//
+// counts of each opcode, each pair of consecutive opcodes and the operand
+// types of each binary operator, along with the hit count of every code
+// address for annotating a disassembly.
+//
+struct opcode_stats_t {
+
+  opcode_stats_t(size_t code_size);
+
+  // count an instruction executed at 'pc'
+  void count(int32_t pc, uint8_t op) {
+    assert(op < __INS_COUNT__);
+    if (pc >= 0 && pc < int32_t(hits_.size())) {
+      ++hits_[pc];
+    }
+    ++ops_[op];
+    if (prev_ < __INS_COUNT__) {
+      ++bigrams_[prev_ * __INS_COUNT__ + op];
+    }
+    prev_ = op;
+  }
+
+  // count the operand types of a binary operator
+  void count_binary(uint8_t op, const value_t *lhs, const value_t *rhs) {
+    assert(op < __INS_COUNT__);
+    const size_t index =
+        (size_t(op) * num_types + type_index_(lhs)) * num_types +
+        type_index_(rhs);
+    ++binary_[index];
+  }
+
+  // hit counts indexed by code address
+  const std::vector<uint64_t> &hits() const {
+    return hits_;
+  }
+
+  uint64_t count(instruction_e op) const {
+    return ops_[op];
+  }
+
+  uint64_t count(instruction_e first, instruction_e second) const {
+    return bigrams_[first * __INS_COUNT__ + second];
+  }
+
+  // write the 'top' opcodes, bigrams and binary operand types
+  void write(FILE *fd, size_t top) const;
+
+  void clear();
+
+  // types are bucketed with all user types sharing the last
+  static const size_t num_types = size_t(val_type_map) + 2;
+
+protected:
+  static size_t type_index_(const value_t *v) {
+    const value_type_t t = v ? v->type() : val_type_unknown;
+    return t < val_type_user ? size_t(t) : num_types - 1;
+  }
+
+  std::vector<uint64_t> hits_;
+  std::array<uint64_t, __INS_COUNT__> ops_;
+  std::vector<uint64_t> bigrams_;
+  std::vector<uint64_t> binary_;
+  // previous opcode, or __INS_COUNT__ before the first
+  uint8_t prev_;
+};
+
+} // namespace nano
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include "../lib_common/program.h"
+#include "../lib_common/source.h"
+
+#include "profiler.h"
+#include "thread.h"
+
+
+namespace {
+
+using namespace nano;
+
+struct entry_t {
+  uint64_t self, total;
+  int32_t addr;
+};
+
+double percent(uint64_t count, uint64_t total) {
+  return total ? (100.0 * double(count)) / double(total) : 0.0;
+}
+
+// source text of a line without the indentation and line ending
+std::string line_text(const source_manager_t &sources, line_t line) {
+  if (line.file < 0 || line.file >= sources.count() || line.line < 1) {
+    return std::string();
+  }
+  std::string out;
+  if (!sources.get_source(line.file).get_line(line.line, out)) {
+    return std::string();
+  }
+  const size_t start = out.find_first_not_of(" \t");
+  const size_t end = out.find_last_not_of(" \t\r\n");
+  if (start == std::string::npos) {
+    return std::string();
+  }
+  return out.substr(start, end - start + 1);
+}
+
+} // namespace {}
+
+namespace nano {
+
+profiler_t::profiler_t(const program_t &program, uint32_t interval)
+  : program_(program)
+  , interval_(std::max<uint32_t>(interval, 1))
+  , countdown_(interval_)
+  , samples_(0)
+{
+}
+
+void profiler_t::sample(const thread_t &thread) {
+  const std::vector<frame_t> &frames = thread.frames();
+  if (frames.empty()) {
+    return;
+  }
+  scratch_.clear();
+  for (const frame_t &f : frames) {
+    scratch_.push_back(f.callee_);
+  }
+  ++stacks_[scratch_];
+  ++lines_[program_.find_line(thread.get_pc())];
+  ++samples_;
+}
+
+void profiler_t::clear() {
+  countdown_ = interval_;
+  samples_ = 0;
+  stacks_.clear();
+  lines_.clear();
+}
+
+const char *profiler_t::function_name_(int32_t addr) const {
+  const function_t *f = program_.function_find(addr);
+  return f ? f->name().c_str() : "?";
+}
+
+void profiler_t::write_collapsed(FILE *fd) const {
+  for (const auto &s : stacks_) {
+    const char *sep = "";
+    for (int32_t addr : s.first) {
+      fprintf(fd, "%s%s", sep, function_name_(addr));
+      sep = ";";
+    }
+    fprintf(fd, " %llu\n", (unsigned long long)s.second);
+  }
+}
+
+void profiler_t::write_report(FILE *fd, size_t top,
+                              const source_manager_t *sources) const {
+  fprintf(fd, "profile: %llu samples, every %u instructions\n",
+          (unsigned long long)samples_, interval_);
+
+  // self samples go to the leaf, total samples once to each function on the
+  // stack so that recursion is not counted twice
+  std::unordered_map<int32_t, entry_t> funcs;
+  std::set<int32_t> seen;
+  for (const auto &s : stacks_) {
+    seen.clear();
+    for (int32_t addr : s.first) {
+      entry_t &e = funcs[addr];
+      e.addr = addr;
+      if (seen.insert(addr).second) {
+        e.total += s.second;
+      }
+    }
+    funcs[s.first.back()].self += s.second;
+  }
+  std::vector<entry_t> by_func;
+  for (const auto &f : funcs) {
+    by_func.push_back(f.second);
+  }
+  std::sort(by_func.begin(), by_func.end(),
+            [](const entry_t &a, const entry_t &b) {
+              return a.self != b.self ? a.self > b.self : a.total > b.total;
+            });
+  fprintf(fd, "\n  %6s %6s %9s  %s\n", "self", "total", "samples", "function");
+  for (size_t i = 0; i < by_func.size() && i < top; ++i) {
+    const entry_t &e = by_func[i];
+    fprintf(fd, "  %5.1f%% %5.1f%% %9llu  %s\n", percent(e.self, samples_),
+            percent(e.total, samples_), (unsigned long long)e.self,
+            function_name_(e.addr));
+  }
+
+  std::vector<std::pair<line_t, uint64_t>> by_line(lines_.begin(),
+                                                   lines_.end());
+  std::stable_sort(by_line.begin(), by_line.end(),
+                   [](const std::pair<line_t, uint64_t> &a,
+                      const std::pair<line_t, uint64_t> &b) {
+                     return a.second > b.second;
+                   });
+  fprintf(fd, "\n  %6s %9s  %s\n", "self", "samples", "line");
+  for (size_t i = 0; i < by_line.size() && i < top; ++i) {
+    const line_t l = by_line[i].first;
+    const uint64_t count = by_line[i].second;
+    fprintf(fd, "  %5.1f%% %9llu  ", percent(count, samples_),
+            (unsigned long long)count);
+    if (l.file < 0) {
+      fprintf(fd, "?\n");
+      continue;
+    }
+    if (sources && l.file < sources->count()) {
+      const std::string text = line_text(*sources, l);
+      fprintf(fd, "%s:%d  %s\n",
+              sources->get_source(l.file).file_path().c_str(), l.line,
+              text.c_str());
+    } else {
+      fprintf(fd, "%d:%d\n", l.file, l.line);
+    }
+  }
+}
+
+} // namespace nano
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+#include "../lib_common/common.h"
+#include "../lib_common/types.h"
+
+
+namespace nano {
+
+struct source_manager_t;
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+//
+// sampling profiler
+//
+// every 'interval' instructions the running thread's call stack and pc are
+// recorded.  threads are resumed in slices which end on sample points so the
+// interpreter loop itself carries no profiling code.  compiled code does not
+// keep the pc up to date so the JIT is disabled while profiling.
+//
+struct profiler_t {
+
+  profiler_t(const program_t &program, uint32_t interval);
+
+  // record the current call stack and line of a thread
+  void sample(const thread_t &thread);
+
+  // discard all samples
+  void clear();
+
+  uint32_t interval() const {
+    return interval_;
+  }
+
+  uint64_t samples() const {
+    return samples_;
+  }
+
+  // write one line per unique call stack ('main;foo;bar 42') in the
+  // collapsed format read by flamegraph tools
+  void write_collapsed(FILE *fd) const;
+
+  // write the 'top' functions by self and total samples and the 'top' lines
+  // by self samples.  'sources' if given is used to name files and show the
+  // source text of each line.
+  void write_report(FILE *fd, size_t top,
+                    const source_manager_t *sources = nullptr) const;
+
+protected:
+  friend struct thread_t;
+
+  // return the name of the function at a code address
+  const char *function_name_(int32_t addr) const;
+
+  const program_t &program_;
+  const uint32_t interval_;
+
+  // instructions until the next sample
+  uint32_t countdown_;
+
+  uint64_t samples_;
+
+  // sample count per call stack of function addresses, root first
+  std::map<std::vector<int32_t>, uint64_t> stacks_;
+
+  // self sample count per source line
+  std::map<line_t, uint64_t> lines_;
+
+  // reused to build the stack of each sample
+  std::vector<int32_t> scratch_;
+};
+
+} // namespace nano
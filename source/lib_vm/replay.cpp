@@ -0,0 +1,298 @@
+#include <cassert>
+#include <cstring>
+
+#include "../lib_common/program.h"
+
+#include "replay.h"
+#include "thread.h"
+
+
+namespace {
+
+using namespace nano;
+
+struct replay_header_t {
+  uint32_t magic;
+  uint32_t version;
+  // hash of the program which was recorded
+  uint64_t program_hash;
+};
+
+static const uint32_t replay_magic =
+    (('L' << 24) | ('P' << 16) | ('R' << 8) | ('N'));
+static const uint32_t replay_version = 1;
+
+// bytes buffered before writing to the log
+static const size_t flush_size = 64 * 1024;
+
+enum : uint8_t {
+  tag_syscall = 'S',
+  tag_resume = 'R',
+  tag_done = 'D',
+};
+
+} // namespace {}
+
+namespace nano {
+
+replay_t::replay_t(const program_t &program, mode_t mode)
+  : program_(program)
+  , mode_(mode)
+  , fd_(nullptr)
+  , read_(0)
+  , written_(0)
+  , diverged_(false)
+{
+}
+
+replay_t::~replay_t() {
+  close();
+}
+
+bool replay_t::open(const char *path, const std::vector<std::string> &inputs) {
+  assert(!fd_);
+  const auto &calls = program_.syscalls();
+  inputs_.assign(calls.size(), false);
+  if (mode_ == e_record) {
+    fd_ = fopen(path, "wb");
+    if (!fd_) {
+      return false;
+    }
+    replay_header_t h;
+    h.magic = replay_magic;
+    h.version = replay_version;
+    h.program_hash = program_.hash();
+    const uint8_t *p = (const uint8_t *)&h;
+    buffer_.assign(p, p + sizeof(h));
+    put_uint_(inputs.size());
+    for (const std::string &name : inputs) {
+      put_uint_(name.size());
+      buffer_.insert(buffer_.end(), name.begin(), name.end());
+    }
+  } else {
+    // the whole log is read up front
+    FILE *fd = fopen(path, "rb");
+    if (!fd) {
+      return false;
+    }
+    uint8_t chunk[4096];
+    size_t got;
+    while ((got = fread(chunk, 1, sizeof(chunk), fd)) > 0) {
+      buffer_.insert(buffer_.end(), chunk, chunk + got);
+    }
+    fclose(fd);
+    replay_header_t h;
+    if (buffer_.size() < sizeof(h)) {
+      return false;
+    }
+    memcpy(&h, buffer_.data(), sizeof(h));
+    if (h.magic != replay_magic || h.version != replay_version ||
+        h.program_hash != program_.hash()) {
+      return false;
+    }
+    read_ = sizeof(h);
+  }
+  // mark the input syscalls, which when replaying are named by the log
+  std::vector<std::string> names;
+  if (mode_ == e_record) {
+    names = inputs;
+  } else {
+    uint64_t count = 0;
+    if (!get_uint_(count)) {
+      return false;
+    }
+    for (uint64_t i = 0; i < count; ++i) {
+      uint64_t size = 0;
+      if (!get_uint_(size) || read_ + size > buffer_.size()) {
+        return false;
+      }
+      names.emplace_back((const char *)buffer_.data() + read_, size_t(size));
+      read_ += size_t(size);
+    }
+  }
+  for (size_t i = 0; i < calls.size(); ++i) {
+    for (const std::string &name : names) {
+      inputs_[i] = inputs_[i] || (calls[i].name_ == name);
+    }
+  }
+  return true;
+}
+
+void replay_t::close() {
+  if (fd_) {
+    flush_();
+    fclose(fd_);
+    fd_ = nullptr;
+  }
+}
+
+void replay_t::record_syscall(thread_t &thread, int32_t index) {
+  const value_t *v = thread.get_stack().peek();
+  put_(tag_syscall);
+  put_uint_(uint64_t(index));
+  switch (v ? v->type() : val_type_none) {
+  case val_type_int:
+    put_(val_type_int);
+    put_int_(v->v);
+    break;
+  case val_type_float: {
+    put_(val_type_float);
+    uint8_t bytes[sizeof(float)];
+    memcpy(bytes, &v->f, sizeof(bytes));
+    buffer_.insert(buffer_.end(), bytes, bytes + sizeof(bytes));
+    break;
+  }
+  case val_type_string:
+    put_(val_type_string);
+    put_uint_(uint64_t(v->strlen()));
+    buffer_.insert(buffer_.end(), v->string(), v->string() + v->strlen());
+    break;
+  default:
+    // other types can not be logged and replay as none
+    put_(val_type_none);
+    break;
+  }
+  if (buffer_.size() >= flush_size) {
+    flush_();
+  }
+}
+
+bool replay_t::replay_syscall(thread_t &thread, int32_t index,
+                              int32_t num_args) {
+  uint64_t logged = 0;
+  uint8_t type = 0;
+  if (!expect_(tag_syscall) || !get_uint_(logged) ||
+      logged != uint64_t(index) || !get_(type)) {
+    diverged_ = true;
+    return false;
+  }
+  value_stack_t &stack = thread.get_stack();
+  stack.discard(uint32_t(num_args));
+  switch (type) {
+  case val_type_int: {
+    int64_t v = 0;
+    diverged_ |= !get_int_(v);
+    stack.push_int(int32_t(v));
+    break;
+  }
+  case val_type_float: {
+    float v = 0.f;
+    if (read_ + sizeof(v) <= buffer_.size()) {
+      memcpy(&v, buffer_.data() + read_, sizeof(v));
+      read_ += sizeof(v);
+    } else {
+      diverged_ = true;
+    }
+    stack.push_float(v);
+    break;
+  }
+  case val_type_string: {
+    uint64_t size = 0;
+    if (!get_uint_(size) || read_ + size > buffer_.size()) {
+      diverged_ = true;
+      size = 0;
+    }
+    stack.push_string(
+        std::string((const char *)buffer_.data() + read_, size_t(size)));
+    read_ += size_t(size);
+    break;
+  }
+  default:
+    stack.push_none();
+    break;
+  }
+  return true;
+}
+
+bool replay_t::resume(uint32_t &cycles) {
+  if (mode_ == e_record) {
+    put_(tag_resume);
+    put_uint_(cycles);
+    return true;
+  }
+  uint64_t logged = 0;
+  if (read_ >= buffer_.size()) {
+    return false;
+  }
+  if (!expect_(tag_resume) || !get_uint_(logged)) {
+    diverged_ = true;
+    return false;
+  }
+  cycles = uint32_t(logged);
+  return true;
+}
+
+void replay_t::resume_done(uint64_t instructions) {
+  if (mode_ == e_record) {
+    put_(tag_done);
+    put_uint_(instructions);
+    if (buffer_.size() >= flush_size) {
+      flush_();
+    }
+    return;
+  }
+  uint64_t logged = 0;
+  if (!expect_(tag_done) || !get_uint_(logged) || logged != instructions) {
+    diverged_ = true;
+  }
+}
+
+void replay_t::put_uint_(uint64_t v) {
+  while (v >= 0x80) {
+    put_(uint8_t(v | 0x80));
+    v >>= 7;
+  }
+  put_(uint8_t(v));
+}
+
+void replay_t::put_int_(int64_t v) {
+  // zigzag so small negative numbers stay short
+  put_uint_((uint64_t(v) << 1) ^ uint64_t(v >> 63));
+}
+
+void replay_t::flush_() {
+  if (fd_ && !buffer_.empty()) {
+    fwrite(buffer_.data(), 1, buffer_.size(), fd_);
+    written_ += buffer_.size();
+  }
+  buffer_.clear();
+}
+
+bool replay_t::get_(uint8_t &byte) {
+  if (read_ >= buffer_.size()) {
+    return false;
+  }
+  byte = buffer_[read_++];
+  return true;
+}
+
+bool replay_t::get_uint_(uint64_t &v) {
+  v = 0;
+  for (uint32_t shift = 0; shift < 64; shift += 7) {
+    uint8_t byte = 0;
+    if (!get_(byte)) {
+      return false;
+    }
+    v |= uint64_t(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool replay_t::get_int_(int64_t &v) {
+  uint64_t u = 0;
+  if (!get_uint_(u)) {
+    return false;
+  }
+  v = int64_t(u >> 1) ^ -int64_t(u & 1);
+  return true;
+}
+
+bool replay_t::expect_(uint8_t tag) {
+  uint8_t byte = 0;
+  return get_(byte) && byte == tag;
+}
+
+} // namespace nano
@@ -0,0 +1,116 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../lib_common/common.h"
+
+
+namespace nano {
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+//
+// record and replay
+//
+// given the same program a run is deterministic apart from the syscalls
+// which read the outside world, such as 'rand', 'getc' or keyboard state,
+// and from how the host drives the scheduler.  when recording, the results
+// of the syscalls the host names as inputs and the cycle budget of each
+// vm_t::resume() are written to a compact log.  when replaying, those
+// syscalls are not called but return the logged values and vm_t::resume()
+// runs with the logged budgets, so the run repeats exactly however fast
+// the host calls it.
+//
+// input syscalls must only push a result.  anything else they do, such as
+// halting the thread, is not replayed.
+//
+// the log is a header followed by a stream of events, each a tag byte and
+// LEB128 encoded fields:
+//
+//    'S' syscall   index, value
+//    'R' resume    cycles
+//    'D' done      instructions executed by the resume
+//
+// a value is a type byte and an int (zigzag encoded), a float (4 bytes), a
+// string (length then bytes) or nothing for none.
+//
+struct replay_t {
+
+  enum mode_t {
+    e_record,
+    e_replay,
+  };
+
+  replay_t(const program_t &program, mode_t mode);
+  ~replay_t();
+
+  // open the log, writing or checking the header.  'inputs' names the
+  // syscalls whose results are logged.
+  bool open(const char *path, const std::vector<std::string> &inputs);
+
+  // flush and close the log
+  void close();
+
+  mode_t mode() const {
+    return mode_;
+  }
+
+  // true if the syscall at 'index' has its results logged
+  bool is_input(int32_t index) const {
+    return index >= 0 && index < int32_t(inputs_.size()) && inputs_[index];
+  }
+
+  // log the result a thread's input syscall left on its stack
+  void record_syscall(thread_t &thread, int32_t index);
+
+  // pop the arguments of an input syscall and push the logged result.
+  // returns false if the log does not hold that syscall next.
+  bool replay_syscall(thread_t &thread, int32_t index, int32_t num_args);
+
+  // log or read the budget of a vm_t::resume().  returns false at the end
+  // of a replayed log.
+  bool resume(uint32_t &cycles);
+
+  // log or check the instructions executed by a vm_t::resume()
+  void resume_done(uint64_t instructions);
+
+  // true if a replay stopped matching its log
+  bool diverged() const {
+    return diverged_;
+  }
+
+  // size of the log so far in bytes
+  uint64_t size() const {
+    return written_ + buffer_.size();
+  }
+
+protected:
+  void put_(uint8_t byte) {
+    buffer_.push_back(byte);
+  }
+
+  void put_uint_(uint64_t v);
+  void put_int_(int64_t v);
+  void flush_();
+
+  bool get_(uint8_t &byte);
+  bool get_uint_(uint64_t &v);
+  bool get_int_(int64_t &v);
+  bool expect_(uint8_t tag);
+
+  const program_t &program_;
+  const mode_t mode_;
+
+  FILE *fd_;
+  std::vector<uint8_t> buffer_;
+  // read position in the buffer when replaying
+  size_t read_;
+  uint64_t written_;
+
+  // input flag for each syscall index
+  std::vector<bool> inputs_;
+  bool diverged_;
+};
+
+} // namespace nano
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <chrono>
 #include <climits>
 #include <cstring>
 
@@ -6,6 +8,12 @@
 #include "instructions.h"
 
 #include "vm.h"
+#include "jit.h"
+#include "profiler.h"
+#include "opcode_stats.h"
+#include "trace_events.h"
+#include "coverage.h"
+#include "replay.h"
 
 /*
  *   s_     STACK LAYOUT
@@ -32,7 +40,26 @@ namespace nano {
 
 namespace {
 
+// none values are null pointers so operands are tested before calling into
+// them
+
+bool both_int(const value_t *l, const value_t *r) {
+  return l && r && l->is_a<val_type_int>() && r->is_a<val_type_int>();
+}
+
+bool both_number(const value_t *l, const value_t *r) {
+  return l && r && l->is_number() && r->is_number();
+}
+
+bool truthy(const value_t *v) {
+  return v && v->as_bool();
+}
+
 bool to_string(char *buf, size_t size, const value_t *val) {
+  if (!val) {
+    snprintf(buf, size, "none");
+    return true;
+  }
   switch (val->type()) {
   case val_type_float:
     snprintf(buf, size, "%f", val->f);
@@ -49,6 +76,10 @@ bool to_string(char *buf, size_t size, const value_t *val) {
   case val_type_func:
     snprintf(buf, size, "function@%d", val->v);
     return true;
+  case val_type_buffer:
+    snprintf(buf, size, "%.*s", val->buffer()->size,
+             (const char *)val->buffer()->data);
+    return true;
   default:
     assert(false);
     return false;
@@ -62,7 +93,9 @@ thread_t::thread_t(vm_t &vm)
   , cycles_(0)
   , finished_(true)
   , halted_(false)
+  , break_skip_(-1)
   , pc_(0)
+  , id_(0)
   , vm_(vm)
   , gc_(*(vm.gc_))
   , stack_(*this, *(vm.gc_))
@@ -73,7 +106,7 @@ thread_t::thread_t(vm_t &vm)
 }
 
 int32_t thread_t::read_operand_() {
-  const uint8_t *c = vm_.program_.data();
+  const uint8_t *c = vm_.code_;
   assert(sizeof(pc_) < vm_.program_.size());
   const int32_t val = *(int32_t *)(c + pc_);
   pc_ += sizeof(int32_t);
@@ -81,34 +114,66 @@ int32_t thread_t::read_operand_() {
 }
 
 uint8_t thread_t::peek_opcode_() {
-  const uint8_t *c = vm_.program_.data();
+  const uint8_t *c = vm_.code_;
   assert(sizeof(pc_) < vm_.program_.size());
   const int8_t val = *(uint8_t *)(c + pc_);
   return val;
 }
 
 uint8_t thread_t::read_opcode_() {
-  const uint8_t *c = vm_.program_.data();
+  const uint8_t *c = vm_.code_;
   assert(sizeof(pc_) < vm_.program_.size());
   const int8_t val = *(uint8_t *)(c + pc_);
   pc_ += sizeof(uint8_t);
   return val;
 }
 
+const user_type_t *thread_t::user_type_(const value_t *l,
+                                        const value_t *r) const {
+  // none operands are null so never call into them
+  const value_type_t lt = l ? l->type() : val_type_none;
+  const value_type_t rt = r ? r->type() : val_type_none;
+  // note: type ids below val_type_user all fit in the low bits
+  if ((lt | rt) < val_type_user) {
+    return nullptr;
+  }
+  return vm_.user_type(lt >= val_type_user ? lt : rt);
+}
+
+bool thread_t::user_lt_(const user_type_t *ut, const value_t *l,
+                        const value_t *r, bool negate) {
+  if (!ut->on_lt || !ut->on_lt(*this, l, r)) {
+    return false;
+  }
+  if (negate && !finished_) {
+    const value_t *o = stack_.pop();
+    stack_.push_int(truthy(o) ? 0 : 1);
+  }
+  return true;
+}
+
 void thread_t::do_INS_ADD_() {
   const value_t *r = stack_.pop();
   const value_t *l = stack_.pop();
   // int like
-  if (l->is_a<val_type_int>() && r->is_a<val_type_int>()) {
+  if (both_int(l, r)) {
     stack_.push_int(l->v + r->v);
     return;
   }
+  // registered user types
+  if (const user_type_t *ut = user_type_(l, r)) {
+    if (ut->on_add && ut->on_add(*this, l, r)) {
+      return;
+    }
+    raise_error(thread_error_t::e_bad_type_operation);
+    return;
+  }
   // float like
-  if (l->is_number() && r->is_number()) {
+  if (both_number(l, r)) {
     stack_.push_float(l->as_float() + r->as_float());
     return;
   }
-  if (l->is_a<val_type_string>()) {
+  if (l && l->is_a<val_type_string>()) {
     char rbuf[16] = {0};
     to_string(rbuf, sizeof(rbuf), r);
     int32_t rsize = int32_t(strlen(rbuf));
@@ -121,7 +186,7 @@ void thread_t::do_INS_ADD_() {
     stack_.push(s);
     return;
   }
-  if (r->is_a<val_type_string>()) {
+  if (r && r->is_a<val_type_string>()) {
     char lbuf[16] = {0};
     to_string(lbuf, sizeof(lbuf), l);
     int32_t lsize = int32_t(strlen(lbuf));
@@ -147,12 +212,20 @@ void thread_t::do_INS_SUB_() {
   const value_t *r = stack_.pop();
   const value_t *l = stack_.pop();
   // int like
-  if (l->is_a<val_type_int>() && r->is_a<val_type_int>()) {
+  if (both_int(l, r)) {
     stack_.push_int(l->v - r->v);
     return;
   }
+  // registered user types
+  if (const user_type_t *ut = user_type_(l, r)) {
+    if (ut->on_sub && ut->on_sub(*this, l, r)) {
+      return;
+    }
+    raise_error(thread_error_t::e_bad_type_operation);
+    return;
+  }
   // float like
-  if (l->is_number() && r->is_number()) {
+  if (both_number(l, r)) {
     stack_.push_float(l->as_float() - r->as_float());
     return;
   }
@@ -169,12 +242,20 @@ void thread_t::do_INS_MUL_() {
   const value_t *r = stack_.pop();
   const value_t *l = stack_.pop();
   // int like
-  if (l->is_a<val_type_int>() && r->is_a<val_type_int>()) {
+  if (both_int(l, r)) {
     stack_.push_int(l->v * r->v);
     return;
   }
+  // registered user types
+  if (const user_type_t *ut = user_type_(l, r)) {
+    if (ut->on_mul && ut->on_mul(*this, l, r)) {
+      return;
+    }
+    raise_error(thread_error_t::e_bad_type_operation);
+    return;
+  }
   // float like
-  if (l->is_number() && r->is_number()) {
+  if (both_number(l, r)) {
     stack_.push_float(l->as_float() * r->as_float());
     return;
   }
@@ -192,7 +273,7 @@ void thread_t::do_INS_DIV_() {
   const value_t *r = stack_.pop();
   const value_t *l = stack_.pop();
   // int like
-  if (l->is_a<val_type_int>() && r->is_a<val_type_int>()) {
+  if (both_int(l, r)) {
     if (r->v == 0) {
       set_error_(thread_error_t::e_bad_divide_by_zero);
     } else {
@@ -201,8 +282,16 @@ void thread_t::do_INS_DIV_() {
     }
     return;
   }
+  // registered user types
+  if (const user_type_t *ut = user_type_(l, r)) {
+    if (ut->on_div && ut->on_div(*this, l, r)) {
+      return;
+    }
+    raise_error(thread_error_t::e_bad_type_operation);
+    return;
+  }
   // float like divide
-  if (l->is_number() && r->is_number()) {
+  if (both_number(l, r)) {
     stack_.push_float(l->as_float() / r->as_float());
     return;
   }
@@ -219,7 +308,7 @@ void thread_t::do_INS_MOD_() {
   const value_t *r = stack_.pop();
   const value_t *l = stack_.pop();
   // int like
-  if (l->is_a<val_type_int>() && r->is_a<val_type_int>()) {
+  if (both_int(l, r)) {
     if (r->v == 0) {
       set_error_(thread_error_t::e_bad_divide_by_zero);
     } else {
@@ -228,29 +317,37 @@ void thread_t::do_INS_MOD_() {
     }
     return;
   }
+  // registered user types
+  if (const user_type_t *ut = user_type_(l, r)) {
+    if (ut->on_mod && ut->on_mod(*this, l, r)) {
+      return;
+    }
+    raise_error(thread_error_t::e_bad_type_operation);
+    return;
+  }
   raise_error(thread_error_t::e_bad_type_operation);
 }
 
 void thread_t::do_INS_AND_() {
   const value_t *r = stack_.pop();
   const value_t *l = stack_.pop();
-  stack_.push_int(l->as_bool() && r->as_bool());
+  stack_.push_int(truthy(l) && truthy(r));
 }
 
 void thread_t::do_INS_OR_() {
   const value_t *r = stack_.pop();
   const value_t *l = stack_.pop();
-  stack_.push_int(l->as_bool() || r->as_bool());
+  stack_.push_int(truthy(l) || truthy(r));
 }
 
 void thread_t::do_INS_NOT_() {
   const value_t *l = stack_.pop();
-  stack_.push_int(!l->as_bool());
+  stack_.push_int(!truthy(l));
 }
 
 void thread_t::do_INS_NEG_() {
   const value_t *o = stack_.pop();
-  if (o->is_a<val_type_int>()) {
+  if (o && o->is_a<val_type_int>()) {
     stack_.push_int(-o->v);
     return;
   }
@@ -261,12 +358,19 @@ void thread_t::do_INS_LT_() {
   const value_t *r = stack_.pop();
   const value_t *l = stack_.pop();
   // integer only comparison
-  if (l->is_a<val_type_int>() && r->is_a<val_type_int>()) {
+  if (both_int(l, r)) {
     stack_.push_int(l->v < r->v ? 1 : 0);
     return;
   }
+  // registered user types
+  if (const user_type_t *ut = user_type_(l, r)) {
+    if (!user_lt_(ut, l, r, false)) {
+      raise_error(thread_error_t::e_bad_type_operation);
+    }
+    return;
+  }
   // float like comparison
-  if (l->is_number() && r->is_number()) {
+  if (both_number(l, r)) {
     stack_.push_int(l->as_float() < r->as_float() ? 1 : 0);
     return;
   }
@@ -277,12 +381,19 @@ void thread_t::do_INS_GT_() {
   const value_t *r = stack_.pop();
   const value_t *l = stack_.pop();
   // integer only comparison
-  if (l->is_a<val_type_int>() && r->is_a<val_type_int>()) {
+  if (both_int(l, r)) {
     stack_.push_int(l->v > r->v ? 1 : 0);
     return;
   }
+  // registered user types derive every ordering from on_lt
+  if (const user_type_t *ut = user_type_(l, r)) {
+    if (!user_lt_(ut, r, l, false)) {
+      raise_error(thread_error_t::e_bad_type_operation);
+    }
+    return;
+  }
   // float like comparison
-  if (l->is_number() && r->is_number()) {
+  if (both_number(l, r)) {
     stack_.push_int(l->as_float() > r->as_float() ? 1 : 0);
     return;
   }
@@ -293,12 +404,19 @@ void thread_t::do_INS_LEQ_() {
   const value_t *r = stack_.pop();
   const value_t *l = stack_.pop();
   // integer only comparison
-  if (l->is_a<val_type_int>() && r->is_a<val_type_int>()) {
+  if (both_int(l, r)) {
     stack_.push_int(l->v <= r->v ? 1 : 0);
     return;
   }
+  // registered user types derive every ordering from on_lt
+  if (const user_type_t *ut = user_type_(l, r)) {
+    if (!user_lt_(ut, r, l, true)) {
+      raise_error(thread_error_t::e_bad_type_operation);
+    }
+    return;
+  }
   // float like comparison
-  if (l->is_number() && r->is_number()) {
+  if (both_number(l, r)) {
     stack_.push_int(l->as_float() <= r->as_float() ? 1 : 0);
     return;
   }
@@ -309,11 +427,18 @@ void thread_t::do_INS_GEQ_() {
   const value_t *r = stack_.pop();
   const value_t *l = stack_.pop();
   // integer only comparison
-  if (l->is_a<val_type_int>() && r->is_a<val_type_int>()) {
+  if (both_int(l, r)) {
     stack_.push_int(l->v >= r->v ? 1 : 0);
     return;
   }
-  if (l->is_number() && r->is_number()) {
+  // registered user types derive every ordering from on_lt
+  if (const user_type_t *ut = user_type_(l, r)) {
+    if (!user_lt_(ut, l, r, true)) {
+      raise_error(thread_error_t::e_bad_type_operation);
+    }
+    return;
+  }
+  if (both_number(l, r)) {
     stack_.push_int(l->as_float() >= r->as_float() ? 1 : 0);
     return;
   }
@@ -323,11 +448,25 @@ void thread_t::do_INS_GEQ_() {
 void thread_t::do_INS_EQ_() {
   const value_t *r = stack_.pop();
   const value_t *l = stack_.pop();
+  // none is only equal to none
+  if (l == nullptr || r == nullptr) {
+    stack_.push_int(l == r ? 1 : 0);
+    return;
+  }
   // integer only comparison
-  if (l->is_a<val_type_int>() && r->is_a<val_type_int>()) {
+  if (both_int(l, r)) {
     stack_.push_int(l->v == r->v ? 1 : 0);
     return;
   }
+  // registered user types
+  if (const user_type_t *ut = user_type_(l, r)) {
+    if (ut->on_equals && ut->on_equals(*this, l, r)) {
+      return;
+    }
+    // otherwise a user value is only equal to itself
+    stack_.push_int(l == r ? 1 : 0);
+    return;
+  }
   if (l->is_a<val_type_string>() &&
       r->is_a<val_type_string>()) {
     int32_t res = 0;
@@ -352,7 +491,7 @@ void thread_t::do_INS_EQ_() {
     return;
   }
   // float like comparison
-  if (l->is_number() && r->is_number()) {
+  if (both_number(l, r)) {
     // XXX: use epsilon here?
     stack_.push_int(
       l->as_float() == r->as_float() ? 1 : 0);
@@ -367,36 +506,33 @@ void thread_t::do_INS_EQ_() {
   raise_error(thread_error_t::e_bad_type_operation);
 }
 
-void thread_t::do_INS_JMP_() {
-  pc_ = read_operand_();
+void thread_t::do_INS_JMP_(int32_t operand) {
+  back_edge_(operand);
+  pc_ = operand;
 }
 
-void thread_t::do_INS_TJMP_() {
-  const int32_t operand = read_operand_();
+void thread_t::do_INS_TJMP_(int32_t operand) {
   const value_t *o = stack_.pop();
-  if (o->as_bool()) {
+  if (truthy(o)) {
     pc_ = operand;
   }
 }
 
-void thread_t::do_INS_FJMP_() {
-  const int32_t operand = read_operand_();
+void thread_t::do_INS_FJMP_(int32_t operand) {
   const value_t *o = stack_.pop();
-  if (!o->as_bool()) {
+  if (!truthy(o)) {
     pc_ = operand;
   }
 }
 
-void thread_t::do_INS_CALL_() {
-  const int32_t num_args = read_operand_();
+void thread_t::do_INS_CALL_(int32_t num_args, int32_t callee) {
   (void)num_args;
-  const int32_t callee = read_operand_();
   // new frame
   enter_(stack_.head(), pc_, callee);
+  enter_native_();
 }
 
-void thread_t::do_INS_RET_() {
-  const int32_t operand = read_operand_();
+void thread_t::do_INS_RET_(int32_t operand) {
   // pop return value
   value_t *sval = stack_.pop();
   // remove arguments and local vars
@@ -411,24 +547,82 @@ void thread_t::do_INS_RET_() {
   }
 }
 
+void thread_t::enter_native_() {
+  if (nano_native_t func = vm_.native_find(pc_)) {
+    func(*this);
+    return;
+  }
+#if NANO_JIT_SUPPORTED
+  if (vm_.jit_->enabled) {
+    if (nano_native_t func = vm_.jit_->on_call(pc_)) {
+      func(*this);
+    }
+  }
+#endif
+}
+
+void thread_t::back_edge_(int32_t target) {
+#if NANO_JIT_SUPPORTED
+  if (target < pc_ && vm_.jit_->enabled) {
+    vm_.jit_->on_back_edge(frame_().callee_);
+  }
+#else
+  (void)target;
+#endif
+}
+
 void thread_t::do_syscall_(int32_t operand, int32_t num_args) {
   const auto &calls = vm_.program_.syscalls();
   assert(operand >= 0 && operand < int32_t(calls.size()));
   nano_syscall_t sys = calls[operand].call_;
   assert(sys);
+  replay_t *replay = vm_.replay_.get();
+  if (replay && replay->is_input(operand) &&
+      replay->mode() == replay_t::e_replay &&
+      replay->replay_syscall(*this, operand, num_args)) {
+    vm_.counters_.syscalls.add(1);
+    return;
+  }
+  trace_events_t *trace = vm_.trace_events_.get();
+  // reading the clock costs as much as a cheap syscall so they are only
+  // timed while tracing or profiling
+  const bool timed = trace || vm_.profiling_;
+  const uint64_t start = timed ? clock_ns_(trace) : 0;
   sys(*this, num_args);
+  const uint64_t end = timed ? clock_ns_(trace) : 0;
+  if (replay && replay->is_input(operand) &&
+      replay->mode() == replay_t::e_record) {
+    replay->record_syscall(*this, operand);
+  }
+  vm_.counters_.syscalls.add(1);
+  if (timed) {
+    vm_.counters_.syscall_time_ns.add(end - start);
+  }
+  if (trace) {
+    trace->complete(trace_event_t::e_syscall, start, end, uint64_t(operand));
+  }
 }
 
-void thread_t::do_INS_SCALL_() {
-  const int32_t num_args = read_operand_();
-  const int32_t operand = read_operand_();
+uint64_t thread_t::clock_ns_(const trace_events_t *trace) {
+  // share the trace clock so one reading serves both
+  if (trace) {
+    return trace->now();
+  }
+  return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count());
+}
+
+void thread_t::do_INS_SCALL_(int32_t num_args, int32_t operand) {
   do_syscall_(operand, num_args);
 }
 
-void thread_t::do_INS_ICALL_() {
-  const int32_t num_args = read_operand_();
+void thread_t::do_INS_ICALL_(int32_t num_args) {
   value_t *callee = stack_.pop();
-  assert(callee);
+  if (!callee) {
+    set_error_(thread_error_t::e_bad_type_operation);
+    return;
+  }
   if (callee->is_a<val_type_syscall>()) {
     const int32_t operand = callee->v;
     do_syscall_(operand, num_args);
@@ -444,33 +638,31 @@ void thread_t::do_INS_ICALL_() {
     }
     // new frame
     enter_(stack_.head(), pc_, addr);
+    enter_native_();
     return;
   }
   set_error_(thread_error_t::e_bad_type_operation);
 }
 
-void thread_t::do_INS_POP_() {
-  const int32_t operand = read_operand_();
+void thread_t::do_INS_POP_(int32_t operand) {
   for (int32_t i = 0; i < operand; ++i) {
     stack_.pop();
   };
 }
 
-void thread_t::do_INS_NEW_INT_() {
-  value_t *op = gc_.new_int(read_operand_());
+void thread_t::do_INS_NEW_INT_(int32_t operand) {
+  value_t *op = gc_.new_int(operand);
   stack_.push(op);
 }
 
-void thread_t::do_INS_NEW_STR_() {
-  const int32_t index = read_operand_();
+void thread_t::do_INS_NEW_STR_(int32_t index) {
   const auto &str_tab = vm_.program_.strings();
   assert(index < (int32_t)str_tab.size());
   const std::string &s = str_tab[index];
   stack_.push_string(s);
 }
 
-void thread_t::do_INS_NEW_ARY_() {
-  const int32_t index = read_operand_();
+void thread_t::do_INS_NEW_ARY_(int32_t index) {
   assert(index > 0);
   stack_.push(gc_.new_array(index));
 }
@@ -479,52 +671,46 @@ void thread_t::do_INS_NEW_NONE_() {
   stack_.push_none();
 }
 
-void thread_t::do_INS_NEW_FLT_() {
-  uint32_t bits = read_operand_();
-  float val = *(const float*)(&bits);
+void thread_t::do_INS_NEW_FLT_(int32_t operand) {
+  // the operand holds the bits of the float
+  float val;
+  memcpy(&val, &operand, sizeof(val));
   value_t *op = gc_.new_float(val);
   stack_.push(op);
 }
 
-void thread_t::do_INS_NEW_FUNC_() {
-  const int32_t index = read_operand_();
+void thread_t::do_INS_NEW_FUNC_(int32_t index) {
   assert(index >= 0);
   stack_.push_func(index);
 }
 
-void thread_t::do_INS_NEW_SCALL_() {
-  const int32_t index = read_operand_();
+void thread_t::do_INS_NEW_SCALL_(int32_t index) {
   assert(index >= 0);
   stack_.push_syscall(index);
 }
 
-void thread_t::do_INS_GLOBALS_() {
-  const int32_t operand = read_operand_();
+void thread_t::do_INS_GLOBALS_(int32_t operand) {
   if (operand) {
     vm_.g_.resize(operand);
     memset(vm_.g_.data(), 0, sizeof(value_t*) * operand);
   }
 }
 
-void thread_t::do_INS_LOCALS_() {
-  const int32_t operand = read_operand_();
+void thread_t::do_INS_LOCALS_(int32_t operand) {
   if (operand) {
     stack_.reserve(operand);
   }
 }
 
-void thread_t::do_INS_GETV_() {
-  const int32_t operand = read_operand_();
+void thread_t::do_INS_GETV_(int32_t operand) {
   stack_.push(getv_(operand));
 }
 
-void thread_t::do_INS_SETV_() {
-  const int32_t operand = read_operand_();
+void thread_t::do_INS_SETV_(int32_t operand) {
   setv_(operand, stack_.pop());
 }
 
-void thread_t::do_INS_GETG_() {
-  const int32_t operand = read_operand_();
+void thread_t::do_INS_GETG_(int32_t operand) {
   if (operand < 0 || operand >= int32_t(vm_.g_.size())) {
     set_error_(thread_error_t::e_bad_get_global);
   } else {
@@ -532,8 +718,7 @@ void thread_t::do_INS_GETG_() {
   }
 }
 
-void thread_t::do_INS_SETG_() {
-  const int32_t operand = read_operand_();
+void thread_t::do_INS_SETG_(int32_t operand) {
   if (operand < 0 || operand >= int32_t(vm_.g_.size())) {
     set_error_(thread_error_t::e_bad_set_global);
   } else {
@@ -545,6 +730,14 @@ void thread_t::do_INS_DEREF_() {
   value_t *a = stack_.pop();
   value_t *i = stack_.pop();
 
+  if (a && a->is_user()) {
+    const user_type_t *ut = vm_.user_type(a->type());
+    if (!(ut && ut->on_array_get && ut->on_array_get(*this, a, i))) {
+      raise_error(thread_error_t::e_bad_type_operation);
+    }
+    return;
+  }
+
   // check user handlers for this action
   // XXX: can we try it at the end
   if (vm_.handlers.on_array_get) {
@@ -557,7 +750,17 @@ void thread_t::do_INS_DEREF_() {
     raise_error(thread_error_t::e_bad_array_object);
     return;
   }
-  if (i->type() != val_type_int) {
+  if (a->type() == val_type_map) {
+    if (!value_gc_t::map_key_valid(i)) {
+      raise_error(thread_error_t::e_bad_array_index);
+      return;
+    }
+    bool found = false;
+    value_t *out = gc_.map_get(a, i, found);
+    stack_.push(out ? out : gc_.new_none());
+    return;
+  }
+  if (!i || i->type() != val_type_int) {
     raise_error(thread_error_t::e_bad_array_index);
     return;
   }
@@ -580,6 +783,33 @@ void thread_t::do_INS_DEREF_() {
     stack_.push_int(ch);
     return;
   }
+  if (a->is_packed()) {
+    if (index < 0 || index >= a->packed_size()) {
+      raise_error(thread_error_t::e_bad_array_bounds);
+      return;
+    }
+    switch (a->type()) {
+    case val_type_int32_array:
+      stack_.push_int(a->int32_array()[index]);
+      break;
+    case val_type_float32_array:
+      stack_.push_float(a->float32_array()[index]);
+      break;
+    default:
+      stack_.push_int(a->uint8_array()[index]);
+      break;
+    }
+    return;
+  }
+  if (a->type() == val_type_buffer) {
+    const buffer_t *buf = a->buffer();
+    if (index < 0 || index >= buf->size) {
+      raise_error(thread_error_t::e_bad_array_bounds);
+      return;
+    }
+    stack_.push_int(buf->data[index]);
+    return;
+  }
   raise_error(thread_error_t::e_bad_type_operation);
 }
 
@@ -588,6 +818,14 @@ void thread_t::do_INS_SETA_() {
   value_t *i = stack_.pop();
   value_t *v = stack_.pop();
 
+  if (a && a->is_user()) {
+    const user_type_t *ut = vm_.user_type(a->type());
+    if (!(ut && ut->on_array_set && ut->on_array_set(*this, a, i, v))) {
+      raise_error(thread_error_t::e_bad_type_operation);
+    }
+    return;
+  }
+
   // check user handlers for this action
   // XXX: try this at the end
   if (vm_.handlers.on_array_set) {
@@ -596,11 +834,34 @@ void thread_t::do_INS_SETA_() {
     }
   }
 
+  if (!a) {
+    raise_error(thread_error_t::e_bad_array_object);
+    return;
+  }
+  if (a->type() == val_type_buffer) {
+    seta_buffer_(a->buffer(), i, v);
+    return;
+  }
+  if (a->is_packed()) {
+    seta_packed_(a, i, v);
+    return;
+  }
+  if (a->type() == val_type_map) {
+    if (!value_gc_t::map_key_valid(i)) {
+      raise_error(thread_error_t::e_bad_array_index);
+      return;
+    }
+    if (!gc_.map_set(a, i, v && v->is_value_type() ? gc_.copy(*v) : v)) {
+      // the heap has no room for a larger table
+      raise_error(thread_error_t::e_bad_argument);
+    }
+    return;
+  }
   if (a->type() != val_type_array) {
     raise_error(thread_error_t::e_bad_array_object);
     return;
   }
-  if (i->type() != val_type_int) {
+  if (!i || i->type() != val_type_int) {
     raise_error(thread_error_t::e_bad_array_index);
     return;
   }
@@ -609,7 +870,7 @@ void thread_t::do_INS_SETA_() {
     raise_error(thread_error_t::e_bad_array_bounds);
     return;
   }
-  if (v->is_a<val_type_array>()) {
+  if (!v || !v->is_value_type()) {
     // we dont want to copy in this case since arrays are 'reference' type
     // objects. perhaps this can be copied into gc_.copy() soon.
     a->array()[index] = v;
@@ -619,21 +880,168 @@ void thread_t::do_INS_SETA_() {
   }
 }
 
-void thread_t::do_INS_SETM_() {
+void thread_t::seta_buffer_(buffer_t *buf, const value_t *i, const value_t *v) {
+  if (!buf->writable) {
+    raise_error(thread_error_t::e_bad_type_operation);
+    return;
+  }
+  if (!i || i->type() != val_type_int) {
+    raise_error(thread_error_t::e_bad_array_index);
+    return;
+  }
+  const int32_t index = i->v;
+  if (index < 0 || index >= buf->size) {
+    raise_error(thread_error_t::e_bad_array_bounds);
+    return;
+  }
+  if (!v || v->type() != val_type_int) {
+    raise_error(thread_error_t::e_bad_type_operation);
+    return;
+  }
+  buf->data[index] = uint8_t(v->v);
+}
+
+void thread_t::seta_packed_(value_t *a, const value_t *i, const value_t *v) {
+  if (!i || i->type() != val_type_int) {
+    raise_error(thread_error_t::e_bad_array_index);
+    return;
+  }
+  const int32_t index = i->v;
+  if (index < 0 || index >= a->packed_size()) {
+    raise_error(thread_error_t::e_bad_array_bounds);
+    return;
+  }
+  if (!v || !v->is_number()) {
+    raise_error(thread_error_t::e_bad_type_operation);
+    return;
+  }
+  // numbers are converted to the element type, wrapping for uint8
+  switch (a->type()) {
+  case val_type_int32_array:
+    a->int32_array()[index] = v->as_int();
+    break;
+  case val_type_float32_array:
+    a->float32_array()[index] = v->as_float();
+    break;
+  default:
+    a->uint8_array()[index] = uint8_t(v->as_int());
+    break;
+  }
+}
+
+bool thread_t::member_resolve_(value_t *obj, int32_t operand,
+                               bool set, member_ic_t &ic) {
+  const value_type_t type = obj ? obj->type() : val_type_none;
+  ic.kind = member_ic_t::ic_empty;
+  ic.type = type;
+  ic.member = operand;
+  ic.user = nullptr;
+  ic.slot = -1;
+  if (!obj) {
+    return false;
+  }
+  if (obj->is_user()) {
+    const user_type_t *ut = vm_.user_type(type);
+    const int32_t slot = vm_.member_slot_(type, operand);
+    const bool hook = set ? ut && ut->member_set : ut && ut->member_get;
+    if (hook && slot >= 0) {
+      ic.kind = member_ic_t::ic_user_slot;
+      ic.user = ut;
+      ic.slot = slot;
+    }
+    return ic.kind != member_ic_t::ic_empty;
+  }
+  if (!set && vm_.program_.strings()[operand] == "length") {
+    if (type == val_type_array) {
+      ic.kind = member_ic_t::ic_array_length;
+    }
+    if (type == val_type_buffer) {
+      ic.kind = member_ic_t::ic_buffer_length;
+    }
+    if (obj->is_packed()) {
+      ic.kind = member_ic_t::ic_packed_length;
+    }
+    if (type == val_type_map) {
+      ic.kind = member_ic_t::ic_map_length;
+    }
+  }
+  return ic.kind != member_ic_t::ic_empty;
+}
+
+void thread_t::getm_cached_(const member_ic_t &ic, value_t *obj) {
+  switch (ic.kind) {
+  case member_ic_t::ic_array_length:
+    stack_.push_int(obj->array_size());
+    break;
+  case member_ic_t::ic_buffer_length:
+    stack_.push_int(obj->buffer()->size);
+    break;
+  case member_ic_t::ic_packed_length:
+    stack_.push_int(obj->packed_size());
+    break;
+  case member_ic_t::ic_map_length:
+    stack_.push_int(obj->map()->count);
+    break;
+  case member_ic_t::ic_user_slot:
+    if (!ic.user->member_get(*this, obj, ic.slot)) {
+      raise_error(thread_error_t::e_bad_member_access);
+    }
+    break;
+  default:
+    assert(false);
+  }
+}
+
+void thread_t::setm_cached_(const member_ic_t &ic, value_t *obj,
+                            value_t *expr) {
+  // only user types have members which can be set
+  assert(ic.kind == member_ic_t::ic_user_slot);
+  if (!ic.user->member_set(*this, obj, expr, ic.slot)) {
+    raise_error(thread_error_t::e_bad_member_access);
+  }
+}
+
+void thread_t::do_INS_GETM_(int32_t operand) {
 
   // pop value and operands
   value_t *obj = stack_.pop();
-  value_t *expr = stack_.pop();
-  const int32_t operand = read_operand_();
+
+  // try the inline cache for this instruction
+  member_ic_t *ic = vm_.member_ic_(pc_ - ins_size(INS_GETM));
+  if (ic && obj && ic->type == obj->type() && ic->member == operand &&
+      ic->kind != member_ic_t::ic_empty) {
+    getm_cached_(*ic, obj);
+    return;
+  }
 
   // get the member string
   const auto &strtab = vm_.program_.strings();
   assert(strtab.size() > operand);
-  const std::string &member = vm_.program_.strings()[operand];
 
-  // try the user handler
-  if (vm_.handlers.on_member_set) {
-    if (vm_.handlers.on_member_set(*this, obj, expr, member)) {
+  // resolve the member and update the cache
+  member_ic_t resolved;
+  if (member_resolve_(obj, operand, false, resolved)) {
+    if (ic) {
+      *ic = resolved;
+    }
+    getm_cached_(resolved, obj);
+    return;
+  }
+
+  const std::string &member = strtab[operand];
+
+  if (obj && obj->is_user()) {
+    const user_type_t *ut = vm_.user_type(obj->type());
+    if (!(ut && ut->on_member_get && ut->on_member_get(*this, obj, member))) {
+      raise_error(thread_error_t::e_bad_member_access);
+    }
+    return;
+  }
+
+  // try a user handler if one is provided
+  if (vm_.handlers.on_member_get) {
+    if (vm_.handlers.on_member_get(*this, obj, member)) {
+      // user says it was handled
       return;
     }
   }
@@ -641,29 +1049,47 @@ void thread_t::do_INS_SETM_() {
   raise_error(thread_error_t::e_bad_member_access);
 }
 
-void thread_t::do_INS_GETM_() {
+void thread_t::do_INS_SETM_(int32_t operand) {
 
   // pop value and operands
   value_t *obj = stack_.pop();
-  const int32_t operand = read_operand_();
+  value_t *expr = stack_.pop();
+
+  // try the inline cache for this instruction
+  member_ic_t *ic = vm_.member_ic_(pc_ - ins_size(INS_SETM));
+  if (ic && obj && ic->type == obj->type() && ic->member == operand &&
+      ic->kind == member_ic_t::ic_user_slot) {
+    setm_cached_(*ic, obj, expr);
+    return;
+  }
+
+  // resolve the member and update the cache
+  member_ic_t resolved;
+  if (member_resolve_(obj, operand, true, resolved)) {
+    if (ic) {
+      *ic = resolved;
+    }
+    setm_cached_(resolved, obj, expr);
+    return;
+  }
 
   // get the member string
   const auto &strtab = vm_.program_.strings();
   assert(strtab.size() > operand);
-  const std::string &member = vm_.program_.strings()[operand];
+  const std::string &member = strtab[operand];
 
-  if (obj->is_a<val_type_array>()) {
-    if (member == "length") {
-      const int32_t size = obj->array_size();
-      stack_.push_int(size);
-      return;
+  if (obj && obj->is_user()) {
+    const user_type_t *ut = vm_.user_type(obj->type());
+    if (!(ut && ut->on_member_set &&
+          ut->on_member_set(*this, obj, expr, member))) {
+      raise_error(thread_error_t::e_bad_member_access);
     }
+    return;
   }
 
-  // try a user handler if one is provided
-  if (vm_.handlers.on_member_get) {
-    if (vm_.handlers.on_member_get(*this, obj, member)) {
-      // user says it was handled
+  // try the user handler
+  if (vm_.handlers.on_member_set) {
+    if (vm_.handlers.on_member_set(*this, obj, expr, member)) {
       return;
     }
   }
@@ -671,8 +1097,7 @@ void thread_t::do_INS_GETM_() {
   raise_error(thread_error_t::e_bad_member_access);
 }
 
-void thread_t::do_INS_ARY_INIT_() {
-  const int32_t operand = read_operand_();
+void thread_t::do_INS_ARY_INIT_(int32_t operand) {
   assert(operand > 0);
   value_t *array = gc_.new_array(operand);
   value_t **data = array->array();
@@ -683,11 +1108,73 @@ void thread_t::do_INS_ARY_INIT_() {
   stack_.push(array);
 }
 
+void thread_t::do_INS_BREAK_() {
+  const int32_t pc = pc_ - 1;
+  const bool breakpoint = vm_.breakpoint_at_(pc);
+  if (breakpoint && break_skip_ != pc) {
+    // halt before the instruction executes
+    pc_ = pc;
+    break_skip_ = pc;
+    halted_ = true;
+    return;
+  }
+  // execute the instruction INS_BREAK replaced
+  break_skip_ = -1;
+  dispatch_(vm_.program_.data()[pc]);
+  if (vm_.coverage_ && vm_.coverage_->hit(pc, pc_) && !breakpoint) {
+    // this probe is finished with so let the code run at full speed
+    vm_.code_restore_(pc);
+  }
+}
+
+void thread_t::do_INS_ARY_LOCAL_(int32_t operand) {
+  assert(operand > 0);
+  value_t *array = scratch_.new_array(operand);
+  if (!array) {
+    // scratch space is exhausted so fall back to the heap
+    array = gc_.new_array(operand);
+  }
+  value_t **data = array->array();
+  for (int i = operand - 1; i >= 0; --i) {
+    value_t *obj = stack_.pop();
+    data[i] = obj;
+  }
+  stack_.push(array);
+}
+
+bool thread_t::do_INS_FOR_(int32_t offs) {
+  const value_t *end = stack_.pop();
+  const value_t *v = getv_(offs);
+  // increment the loop variable
+  value_t *n = nullptr;
+  if (v->is_a<val_type_int>()) {
+    n = gc_.new_int(v->v + 1);
+  } else if (v->is_a<val_type_float>()) {
+    n = gc_.new_float(v->f + 1.f);
+  } else {
+    raise_error(thread_error_t::e_bad_type_operation);
+    return false;
+  }
+  setv_(offs, n);
+  // integer only comparison
+  if (n->is_a<val_type_int>() && end->is_a<val_type_int>()) {
+    return n->v < end->v;
+  }
+  // float like comparison
+  if (end->is_number()) {
+    return n->as_float() < end->as_float();
+  }
+  raise_error(thread_error_t::e_bad_type_operation);
+  return false;
+}
+
 void thread_t::reset() {
   error_ = thread_error_t::e_success;
   stack_.clear();
+  scratch_.clear();
   f_.clear();
   halted_ = false;
+  break_skip_ = -1;
   finished_ = false;
 }
 
@@ -698,8 +1185,10 @@ bool thread_t::prepare(const function_t &func, int32_t argc,
   finished_ = true;
   cycles_ = 0;
   halted_ = false;
+  break_skip_ = -1;
 
   stack_.clear();
+  scratch_.clear();
 
   // load the target pc (entry point)
   pc_ = func.code_start_;
@@ -730,10 +1219,30 @@ bool thread_t::prepare(const function_t &func, int32_t argc,
   return true;
 }
 
+void thread_t::count_opcode_(uint8_t opcode) {
+  if (opcode >= __INS_COUNT__) {
+    return;
+  }
+  opcode_stats_t &stats = *vm_.opcode_stats_;
+  stats.count(pc_ - 1, opcode);
+  if (ins_is_binary_op(instruction_e(opcode))) {
+    const int32_t head = stack_.head();
+    stats.count_binary(opcode, stack_.get(head - 2), stack_.get(head - 1));
+  }
+}
+
 void thread_t::step_imp_() {
   // fetch opcode
   const uint8_t opcode = read_opcode_();
-  // dispatch
+#if NANO_OPCODE_STATS
+  count_opcode_(opcode);
+#endif
+  dispatch_(opcode);
+  // increment cycle count
+  ++cycles_;
+}
+
+void thread_t::dispatch_(uint8_t opcode) {
   switch (opcode) {
   case INS_ADD:      do_INS_ADD_();        break;
   case INS_SUB:      do_INS_SUB_();        break;
@@ -749,49 +1258,54 @@ void thread_t::step_imp_() {
   case INS_LEQ:      do_INS_LEQ_();        break;
   case INS_GEQ:      do_INS_GEQ_();        break;
   case INS_EQ:       do_INS_EQ_();         break;
-  case INS_JMP:      do_INS_JMP_();        break;
-  case INS_TJMP:     do_INS_TJMP_();       break;
-  case INS_FJMP:     do_INS_FJMP_();       break;
-  case INS_CALL:     do_INS_CALL_();       break;
-  case INS_RET:      do_INS_RET_();        break;
-  case INS_SCALL:    do_INS_SCALL_();      break;
-  case INS_ICALL:    do_INS_ICALL_();      break;
-  case INS_POP:      do_INS_POP_();        break;
-  case INS_NEW_ARY:  do_INS_NEW_ARY_();    break;
-  case INS_NEW_INT:  do_INS_NEW_INT_();    break;
-  case INS_NEW_STR:  do_INS_NEW_STR_();    break;
+  case INS_JMP:      do_INS_JMP_(read_operand_()); break;
+  case INS_TJMP:     do_INS_TJMP_(read_operand_()); break;
+  case INS_FJMP:     do_INS_FJMP_(read_operand_()); break;
+  case INS_CALL: {
+    const int32_t num_args = read_operand_();
+    do_INS_CALL_(num_args, read_operand_());
+    break;
+  }
+  case INS_RET:      do_INS_RET_(read_operand_()); break;
+  case INS_SCALL: {
+    const int32_t num_args = read_operand_();
+    do_INS_SCALL_(num_args, read_operand_());
+    break;
+  }
+  case INS_ICALL:    do_INS_ICALL_(read_operand_()); break;
+  case INS_POP:      do_INS_POP_(read_operand_()); break;
+  case INS_NEW_ARY:  do_INS_NEW_ARY_(read_operand_()); break;
+  case INS_NEW_INT:  do_INS_NEW_INT_(read_operand_()); break;
+  case INS_NEW_STR:  do_INS_NEW_STR_(read_operand_()); break;
   case INS_NEW_NONE: do_INS_NEW_NONE_();   break;
-  case INS_NEW_FLT:  do_INS_NEW_FLT_();    break;
-  case INS_NEW_FUNC: do_INS_NEW_FUNC_();   break;
-  case INS_NEW_SCALL: do_INS_NEW_SCALL_(); break;
-  case INS_LOCALS:   do_INS_LOCALS_();     break;
-  case INS_GLOBALS:  do_INS_GLOBALS_();    break;
-  case INS_GETV:     do_INS_GETV_();       break;
-  case INS_SETV:     do_INS_SETV_();       break;
-  case INS_GETG:     do_INS_GETG_();       break;
-  case INS_SETG:     do_INS_SETG_();       break;
+  case INS_NEW_FLT:  do_INS_NEW_FLT_(read_operand_()); break;
+  case INS_NEW_FUNC: do_INS_NEW_FUNC_(read_operand_()); break;
+  case INS_NEW_SCALL: do_INS_NEW_SCALL_(read_operand_()); break;
+  case INS_LOCALS:   do_INS_LOCALS_(read_operand_()); break;
+  case INS_GLOBALS:  do_INS_GLOBALS_(read_operand_()); break;
+  case INS_GETV:     do_INS_GETV_(read_operand_()); break;
+  case INS_SETV:     do_INS_SETV_(read_operand_()); break;
+  case INS_GETG:     do_INS_GETG_(read_operand_()); break;
+  case INS_SETG:     do_INS_SETG_(read_operand_()); break;
   case INS_DEREF:    do_INS_DEREF_();      break;
   case INS_SETA:     do_INS_SETA_();       break;
-  case INS_GETM:     do_INS_GETM_();       break;
-  case INS_SETM:     do_INS_SETM_();       break;
-  case INS_ARY_INIT: do_INS_ARY_INIT_();   break;
+  case INS_GETM:     do_INS_GETM_(read_operand_()); break;
+  case INS_SETM:     do_INS_SETM_(read_operand_()); break;
+  case INS_ARY_INIT: do_INS_ARY_INIT_(read_operand_()); break;
+  case INS_FOR: {
+    const int32_t offs = read_operand_();
+    const int32_t target = read_operand_();
+    if (do_INS_FOR_(offs)) {
+      back_edge_(target);
+      pc_ = target;
+    }
+    break;
+  }
+  case INS_ARY_LOCAL: do_INS_ARY_LOCAL_(read_operand_()); break;
+  case INS_BREAK:    do_INS_BREAK_();      break;
   default:
     set_error_(thread_error_t::e_bad_opcode);
   }
-  // check for any breakpoints
-  if (!breakpoints_.empty()) {
-    // check if the source line is in our list
-    const line_t l = get_source_line();
-    if (breakpoints_.count(l)) {
-      if (l != last_line_) {
-        halted_ = true;
-      }
-    }
-    // keep track of the last source line we were on
-    last_line_ = l;
-  }
-  // increment cycle count
-  ++cycles_;
 }
 
 void thread_t::enter_(uint32_t sp, uint32_t pc, uint32_t callee) {
@@ -801,6 +1315,7 @@ void thread_t::enter_(uint32_t sp, uint32_t pc, uint32_t callee) {
   frame_().return_ = pc;
   frame_().terminal_ = false;
   frame_().callee_ = callee;
+  frame_().scratch_ = scratch_.head();
   // jump to the new function
   pc_ = callee;
 }
@@ -814,6 +1329,8 @@ uint32_t thread_t::leave_() {
     const uint32_t ret_pc = frame_().return_;
     // we have finished if this frame was terminal
     finished_ = frame_().terminal_;
+    // free any arrays allocated by this frame
+    scratch_.release(frame_().scratch_);
     f_.pop_back();
     // if we have no more frames then we have reached the end anyway
     finished_ |= f_.empty();
@@ -828,8 +1345,12 @@ bool thread_t::step_inst() {
   if (finished_) {
     return false;
   }
+  vm_.jit_deopt();
   vm_.gc_collect();
+  // stepping does not stop at breakpoints
+  break_skip_ = pc_;
   step_imp_();
+  break_skip_ = -1;
   return !has_error();
 }
 
@@ -837,11 +1358,14 @@ bool thread_t::step_line() {
   if (finished_) {
     return false;
   }
+  vm_.jit_deopt();
   // get the current source line
   const line_t line = get_source_line();
   // step until the source line changes
   do {
+    break_skip_ = pc_;
     step_imp_();
+    break_skip_ = -1;
     if (finished_) {
       break;
     }
@@ -852,7 +1376,7 @@ bool thread_t::step_line() {
 }
 
 line_t thread_t::get_source_line() const {
-  return vm_.program_.get_line(pc_);
+  return vm_.program_.find_line(pc_);
 }
 
 void thread_t::tick_gc_(int32_t cycles) {
@@ -866,11 +1390,83 @@ bool thread_t::resume(int32_t cycles) {
   if (finished_) {
     return false;
   }
+  const uint32_t start = cycles_;
+  bool ok;
+  if (vm_.trace_events_) {
+    ok = resume_traced_(*vm_.trace_events_, cycles);
+  } else if (vm_.profiling_) {
+    ok = resume_sampled_(*vm_.profiler_, cycles);
+  } else {
+    ok = resume_(cycles);
+  }
+  vm_counters_t &counters = vm_.counters_;
+  counters.instructions.add(cycles_ - start);
+  if (finished_) {
+    counters.threads_finished.add(1);
+    if (has_error()) {
+      counters.threads_errored.add(1);
+    }
+  }
+  return ok;
+}
+
+bool thread_t::resume_traced_(trace_events_t &trace, int32_t cycles) {
+  trace.tid = id_;
+  const uint64_t start = trace.now();
+  const uint32_t cycles_start = cycles_;
+  const bool ok = vm_.profiling_ ? resume_sampled_(*vm_.profiler_, cycles)
+                                 : resume_(cycles);
+  trace.complete(trace_event_t::e_resume, start, cycles_ - cycles_start);
+  if (finished_) {
+    trace.instant(trace_event_t::e_thread_finish, id_, uint64_t(error_));
+  }
+  trace.tid = 0;
+  // wake the writer early rather than let the ring fill up
+  if (trace.pending() * 2 > trace.capacity()) {
+    trace.kick();
+  }
+  return ok;
+}
+
+bool thread_t::resume_sampled_(profiler_t &profiler, int32_t cycles) {
+  while (cycles > 0) {
+    const int32_t slice = std::min(cycles, int32_t(profiler.countdown_));
+    const uint32_t start = cycles_;
+    if (!resume_(slice)) {
+      return false;
+    }
+    const uint32_t ran = cycles_ - start;
+    cycles -= slice;
+    if (ran >= profiler.countdown_) {
+      profiler.countdown_ = profiler.interval_;
+      if (!finished_) {
+        profiler.sample(*this);
+      }
+    } else {
+      profiler.countdown_ -= ran;
+    }
+    if (finished_ || halted_) {
+      break;
+    }
+  }
+  return !has_error();
+}
+
+bool thread_t::resume_(int32_t cycles) {
   halted_ = false;
+  // attribute allocations to our instructions
+  gc_.alloc_site(&pc_);
+  // a new thread may start in a native function, which may also halt before
+  // an instruction has been counted
+  if (cycles_ == 0 && !f_.empty() && pc_ == frame_().callee_) {
+    enter_native_();
+  }
   // while we should keep processing instructions
   for (; cycles; --cycles) {
-    tick_gc_(cycles);
-    step_imp_();
+    if (!finished_ && !halted_) {
+      tick_gc_(cycles);
+      step_imp_();
+    }
     if (finished_) {
       if (has_error()) {
         if (vm_.handlers.on_thread_error) {
@@ -886,6 +1482,7 @@ bool thread_t::resume(int32_t cycles) {
       break;
     }
   }
+  gc_.alloc_site(nullptr);
   // cycles timeout
   return !has_error();
 }
@@ -901,18 +1498,15 @@ void thread_t::setv_(int32_t offs, value_t *val) {
 }
 
 void thread_t::breakpoint_add(line_t line) {
-  breakpoints_.insert(line);
+  vm_.breakpoint_add(line);
 }
 
 void thread_t::breakpoint_remove(line_t line) {
-  auto itt = breakpoints_.find(line);
-  if (itt != breakpoints_.end()) {
-    breakpoints_.erase(itt);
-  }
+  vm_.breakpoint_remove(line);
 }
 
 void thread_t::breakpoint_clear() {
-  breakpoints_.clear();
+  vm_.breakpoint_clear();
 }
 
 } // namespace nano
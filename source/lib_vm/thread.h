@@ -16,6 +16,9 @@
 namespace nano {
 
 struct vm_t;
+struct member_ic_t;
+struct profiler_t;
+struct trace_events_t;
 
 struct frame_t {
   // stack pointer
@@ -29,6 +32,9 @@ struct frame_t {
 
   // we should terminate after this frame
   bool terminal_;
+
+  // frame scratch head on entry
+  size_t scratch_;
 };
 
 struct thread_t {
@@ -93,6 +99,11 @@ struct thread_t {
 
   void reset();
 
+  // return the id of this thread, unique within its vm
+  uint32_t id() const {
+    return id_;
+  }
+
   // return the program counter
   int32_t get_pc() const {
     return pc_;
@@ -102,6 +113,7 @@ struct thread_t {
     return f_;
   }
 
+  // note: breakpoints are shared by every thread in the vm
   void breakpoint_add(line_t line);
   void breakpoint_remove(line_t line);
   void breakpoint_clear();
@@ -119,15 +131,11 @@ struct thread_t {
 
 protected:
   friend struct vm_t;
+  friend struct native_t;
 
   // should only be constructed via vm_t
   thread_t(vm_t &vm);
 
-  // when we resume a thread we must keep track of the previous source line.
-  // we need to do this so we can resume from a breakpoint without hitting it
-  // again.
-  line_t last_line_;
-
   // set when a thread raises and error
   thread_error_t error_;
 
@@ -140,9 +148,16 @@ protected:
   // syscalls can set to true to halt execution
   bool halted_;
 
+  // address of a breakpoint which the next instruction executed steps over,
+  // or -1
+  int32_t break_skip_;
+
   // program counter
   int32_t pc_;
 
+  // assigned by the vm on creation
+  uint32_t id_;
+
   // parent virtual machine
   vm_t &vm_;
 
@@ -156,8 +171,8 @@ protected:
   friend struct value_stack_t;
   value_stack_t stack_;
 
-  // breakpoint list
-  std::set<line_t> breakpoints_;
+  // arrays that can't escape their stack frame
+  scratch_t scratch_;
 
   // tick the garbage collector
   void tick_gc_(int32_t cycles);
@@ -165,12 +180,59 @@ protected:
   // step a single instruction (internal)
   void step_imp_();
 
+  // execute an opcode which has been read from the code
+  void dispatch_(uint8_t opcode);
+
+  // count an instruction for the instruction mix
+  void count_opcode_(uint8_t opcode);
+
+  // run for a number of cycles, stopping early if we halt or finish
+  bool resume_(int32_t cycles);
+
+  // resume recording a trace event for the slice
+  bool resume_traced_(trace_events_t &trace, int32_t cycles);
+
+  // resume in slices which end where the profiler takes a sample
+  bool resume_sampled_(profiler_t &profiler, int32_t cycles);
+
   // frame control
   void enter_(uint32_t sp, uint32_t ret, uint32_t callee);
   uint32_t leave_();
 
   // syscall helper
   void do_syscall_(int32_t index, int32_t num_args);
+  static uint64_t clock_ns_(const trace_events_t *trace);
+
+  // run a native function for the frame that was just entered
+  void enter_native_();
+
+  // return the registered type of either operand if it is a user type
+  const user_type_t *user_type_(const value_t *l, const value_t *r) const;
+
+  // push 'l < r' using a user type's on_lt, or its negation, returning false
+  // if the type has no ordering
+  bool user_lt_(const user_type_t *ut, const value_t *l, const value_t *r,
+                bool negate);
+
+  // resolve a member access into an inline cache entry, returning false if
+  // it must be handled by name
+  bool member_resolve_(value_t *obj, int32_t operand, bool set,
+                       member_ic_t &ic);
+
+  // perform a resolved member get
+  void getm_cached_(const member_ic_t &ic, value_t *obj);
+
+  // perform a resolved member set
+  void setm_cached_(const member_ic_t &ic, value_t *obj, value_t *expr);
+
+  // write a number into a packed array
+  void seta_packed_(value_t *a, const value_t *i, const value_t *v);
+
+  // write a byte into a host buffer
+  void seta_buffer_(buffer_t *buf, const value_t *i, const value_t *v);
+
+  // report a backwards branch to the JIT compiler
+  void back_edge_(int32_t target);
 
   // current stack frame
   const frame_t &frame_() const {
@@ -211,32 +273,35 @@ protected:
   void do_INS_LEQ_();
   void do_INS_GEQ_();
   void do_INS_EQ_();
-  void do_INS_JMP_();
-  void do_INS_TJMP_();
-  void do_INS_FJMP_();
-  void do_INS_CALL_();
-  void do_INS_RET_();
-  void do_INS_SCALL_();
-  void do_INS_ICALL_();
-  void do_INS_POP_();
-  void do_INS_NEW_STR_();
-  void do_INS_NEW_ARY_();
+  void do_INS_JMP_(int32_t operand);
+  void do_INS_TJMP_(int32_t operand);
+  void do_INS_FJMP_(int32_t operand);
+  void do_INS_CALL_(int32_t num_args, int32_t callee);
+  void do_INS_RET_(int32_t operand);
+  void do_INS_SCALL_(int32_t num_args, int32_t index);
+  void do_INS_ICALL_(int32_t operand);
+  void do_INS_POP_(int32_t operand);
+  void do_INS_NEW_STR_(int32_t operand);
+  void do_INS_NEW_ARY_(int32_t operand);
   void do_INS_NEW_NONE_();
-  void do_INS_NEW_INT_();
-  void do_INS_NEW_FLT_();
-  void do_INS_NEW_FUNC_();
-  void do_INS_NEW_SCALL_();
-  void do_INS_LOCALS_();
-  void do_INS_GLOBALS_();
-  void do_INS_GETV_();
-  void do_INS_SETV_();
-  void do_INS_GETG_();
-  void do_INS_SETG_();
+  void do_INS_NEW_INT_(int32_t operand);
+  void do_INS_NEW_FLT_(int32_t operand);
+  void do_INS_NEW_FUNC_(int32_t operand);
+  void do_INS_NEW_SCALL_(int32_t operand);
+  void do_INS_LOCALS_(int32_t operand);
+  void do_INS_GLOBALS_(int32_t operand);
+  void do_INS_GETV_(int32_t operand);
+  void do_INS_SETV_(int32_t operand);
+  void do_INS_GETG_(int32_t operand);
+  void do_INS_SETG_(int32_t operand);
   void do_INS_DEREF_();
   void do_INS_SETA_();
-  void do_INS_GETM_();
-  void do_INS_SETM_();
-  void do_INS_ARY_INIT_();
+  void do_INS_GETM_(int32_t operand);
+  void do_INS_SETM_(int32_t operand);
+  void do_INS_ARY_INIT_(int32_t operand);
+  bool do_INS_FOR_(int32_t offs);
+  void do_INS_ARY_LOCAL_(int32_t operand);
+  void do_INS_BREAK_();
 };
 
 } // namespace nano
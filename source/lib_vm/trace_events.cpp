@@ -0,0 +1,163 @@
+#include <cassert>
+#include <cinttypes>
+
+#include "../lib_common/program.h"
+
+#include "trace_events.h"
+
+
+namespace {
+
+using namespace nano;
+
+size_t round_pow2(size_t x) {
+  size_t out = 64;
+  while (out < x) {
+    out *= 2;
+  }
+  return out;
+}
+
+// how often the writer drains the ring when not kicked
+const std::chrono::milliseconds writer_interval(20);
+
+// microseconds as expected by the trace viewer
+double usec(uint64_t ns) {
+  return double(ns) / 1000.0;
+}
+
+} // namespace {}
+
+namespace nano {
+
+trace_events_t::trace_events_t(const program_t &program, size_t capacity)
+  : tid(0)
+  , program_(program)
+  , start_(std::chrono::steady_clock::now())
+  , events_(new trace_event_t[round_pow2(capacity)])
+  , mask_(round_pow2(capacity) - 1)
+  , head_(0)
+  , tail_(0)
+  , dropped_(0)
+  , fd_(nullptr)
+  , first_(true)
+  , kicked_(false)
+  , stop_(false)
+{
+}
+
+trace_events_t::~trace_events_t() {
+  close();
+}
+
+bool trace_events_t::open(const char *path) {
+  {
+    std::lock_guard<std::mutex> guard(flush_lock_);
+    assert(!fd_);
+    fd_ = fopen(path, "w");
+    if (!fd_) {
+      return false;
+    }
+    fprintf(fd_, "{\"traceEvents\":[\n");
+    first_ = true;
+  }
+  assert(!writer_.joinable());
+  stop_ = false;
+  writer_ = std::thread(&trace_events_t::writer_main_, this);
+  return true;
+}
+
+void trace_events_t::writer_main_() {
+  std::unique_lock<std::mutex> lock(wake_lock_);
+  while (!stop_) {
+    wake_.wait_for(lock, writer_interval, [this] {
+      return stop_ || kicked_.load(std::memory_order_acquire);
+    });
+    lock.unlock();
+    kicked_.store(false, std::memory_order_release);
+    flush();
+    lock.lock();
+  }
+}
+
+void trace_events_t::flush() {
+  std::lock_guard<std::mutex> guard(flush_lock_);
+  uint64_t tail = tail_.load(std::memory_order_relaxed);
+  const uint64_t head = head_.load(std::memory_order_acquire);
+  for (; tail != head; ++tail) {
+    if (fd_) {
+      write_(events_[tail & mask_]);
+    }
+  }
+  tail_.store(tail, std::memory_order_release);
+  if (fd_) {
+    fflush(fd_);
+  }
+}
+
+void trace_events_t::close() {
+  if (writer_.joinable()) {
+    {
+      std::lock_guard<std::mutex> guard(wake_lock_);
+      stop_ = true;
+    }
+    wake_.notify_one();
+    writer_.join();
+  }
+  flush();
+  std::lock_guard<std::mutex> guard(flush_lock_);
+  if (!fd_) {
+    return;
+  }
+  fprintf(fd_, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":"
+               "{\"dropped_events\":%" PRIu64 "}}\n", dropped());
+  fclose(fd_);
+  fd_ = nullptr;
+}
+
+void trace_events_t::write_(const trace_event_t &e) {
+  const char *sep = first_ ? "" : ",\n";
+  first_ = false;
+  switch (e.kind) {
+  case trace_event_t::e_resume:
+    fprintf(fd_, "%s{\"name\":\"resume\",\"cat\":\"vm\",\"ph\":\"X\","
+                 "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,"
+                 "\"args\":{\"cycles\":%" PRIu64 "}}",
+            sep, usec(e.ts), usec(e.dur), e.tid, e.arg);
+    break;
+  case trace_event_t::e_syscall: {
+    const auto &calls = program_.syscalls();
+    const char *name =
+        e.arg < calls.size() ? calls[size_t(e.arg)].name_.c_str() : "?";
+    fprintf(fd_, "%s{\"name\":\"%s\",\"cat\":\"syscall\",\"ph\":\"X\","
+                 "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+            sep, name, usec(e.ts), usec(e.dur), e.tid);
+    break;
+  }
+  case trace_event_t::e_gc:
+    fprintf(fd_, "%s{\"name\":\"gc_collect\",\"cat\":\"gc\",\"ph\":\"X\","
+                 "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,"
+                 "\"args\":{\"bytes_copied\":%" PRIu64 "}}",
+            sep, usec(e.ts), usec(e.dur), e.tid, e.arg);
+    break;
+  case trace_event_t::e_thread_create: {
+    // name the thread after its entry function
+    const function_t *f = program_.function_find(int32_t(e.arg));
+    const char *name = f ? f->name().c_str() : "?";
+    fprintf(fd_, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                 "\"tid\":%u,\"args\":{\"name\":\"%s\"}},\n"
+                 "{\"name\":\"thread_create\",\"cat\":\"vm\",\"ph\":\"i\","
+                 "\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+            sep, e.tid, name, usec(e.ts), e.tid);
+    break;
+  }
+  case trace_event_t::e_thread_finish:
+    fprintf(fd_, "%s{\"name\":\"thread_finish\",\"cat\":\"vm\",\"ph\":\"i\","
+                 "\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,"
+                 "\"args\":{\"error\":%" PRIu64 "}}",
+            sep, usec(e.ts), e.tid, e.arg);
+    break;
+  }
+}
+
+} // namespace nano
@@ -0,0 +1,149 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "../lib_common/common.h"
+
+
+namespace nano {
+
+struct trace_event_t {
+
+  enum kind_t : uint8_t {
+    // a thread_t::resume() slice, 'arg' is the cycles executed
+    e_resume,
+    // a syscall, 'arg' is its index in the syscall table
+    e_syscall,
+    // a collection, 'arg' is the bytes copied
+    e_gc,
+    // thread creation, 'arg' is the entry function address
+    e_thread_create,
+    // thread finish, 'arg' is the error code
+    e_thread_finish,
+  };
+
+  // start time and duration in nanoseconds since tracing began
+  uint64_t ts;
+  uint64_t dur;
+  uint64_t arg;
+  uint32_t tid;
+  kind_t kind;
+};
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+//
+// chrome trace event recorder
+//
+// the vm pushes events into a fixed size single producer ring buffer without
+// locking.  while a trace file is open a writer thread drains the ring into
+// a trace event JSON file that can be opened by chrome://tracing or
+// perfetto, so the vm never formats or writes events itself.  events pushed
+// while the ring is full are dropped and counted.
+//
+struct trace_events_t {
+
+  trace_events_t(const program_t &program, size_t capacity);
+  ~trace_events_t();
+
+  // start writing a trace file
+  bool open(const char *path);
+
+  // write all pending events to the trace file
+  void flush();
+
+  // stop the writer, flush and finish the trace file
+  void close();
+
+  // ask the writer to drain the ring now rather than at its next interval
+  void kick() {
+    if (!kicked_.exchange(true, std::memory_order_acq_rel)) {
+      std::lock_guard<std::mutex> guard(wake_lock_);
+      wake_.notify_one();
+    }
+  }
+
+  // nanoseconds since tracing began
+  uint64_t now() const {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start_).count());
+  }
+
+  // record an event which started at 'ts' and ends now
+  void complete(trace_event_t::kind_t kind, uint64_t ts, uint64_t arg) {
+    push_(trace_event_t{ts, now() - ts, arg, tid, kind});
+  }
+
+  // record an event which ran from 'ts' until 'end'
+  void complete(trace_event_t::kind_t kind, uint64_t ts, uint64_t end,
+                uint64_t arg) {
+    push_(trace_event_t{ts, end - ts, arg, tid, kind});
+  }
+
+  // record an event which happens now
+  void instant(trace_event_t::kind_t kind, uint32_t id, uint64_t arg) {
+    push_(trace_event_t{now(), 0, arg, id, kind});
+  }
+
+  // number of events waiting to be flushed
+  size_t pending() const {
+    return size_t(head_.load(std::memory_order_acquire) -
+                  tail_.load(std::memory_order_acquire));
+  }
+
+  size_t capacity() const {
+    return mask_ + 1;
+  }
+
+  uint64_t dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  // id of the thread being resumed, which syscalls and collections are
+  // attributed to
+  uint32_t tid;
+
+protected:
+  void push_(const trace_event_t &e) {
+    const uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) > mask_) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    events_[head & mask_] = e;
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+  void write_(const trace_event_t &e);
+
+  // background writer thread body
+  void writer_main_();
+
+  const program_t &program_;
+  const std::chrono::steady_clock::time_point start_;
+
+  std::unique_ptr<trace_event_t[]> events_;
+  const size_t mask_;
+  std::atomic<uint64_t> head_;
+  std::atomic<uint64_t> tail_;
+  std::atomic<uint64_t> dropped_;
+
+  // consumers are serialised
+  std::mutex flush_lock_;
+  FILE *fd_;
+  bool first_;
+
+  std::thread writer_;
+  std::mutex wake_lock_;
+  std::condition_variable wake_;
+  std::atomic<bool> kicked_;
+  // guarded by 'wake_lock_'
+  bool stop_;
+};
+
+} // namespace nano
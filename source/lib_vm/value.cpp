@@ -23,6 +23,17 @@ void value_stack_t::push_syscall(const int32_t index) {
   push(gc_.new_syscall(index));
 }
 
+value_t *value_stack_t::push_user(value_type_t type) {
+  value_t *v = gc_.new_user(type);
+  push(v);
+  return v;
+}
+
+void value_stack_t::push_buffer(uint8_t *data, int32_t size, bool writable,
+                                buffer_t::release_t release, void *user) {
+  push(gc_.new_buffer(data, size, writable, release, user));
+}
+
 void value_stack_t::push_int(const int32_t v) {
   push(gc_.new_int(v));
 }
@@ -43,6 +54,26 @@ void value_stack_t::set_error(thread_error_t error) {
   thread_.raise_error(error);
 }
 
+const char *value_type_name(value_type_t type) {
+  switch (type) {
+  case val_type_unknown:       return "unknown";
+  case val_type_none:          return "none";
+  case val_type_int:           return "int";
+  case val_type_string:        return "string";
+  case val_type_array:         return "array";
+  case val_type_float:         return "float";
+  case val_type_func:          return "func";
+  case val_type_syscall:       return "syscall";
+  case val_type_buffer:        return "buffer";
+  case val_type_int32_array:   return "int32_array";
+  case val_type_float32_array: return "float32_array";
+  case val_type_uint8_array:   return "uint8_array";
+  case val_type_map:           return "map";
+  default:
+    return type >= val_type_user ? "user" : "unknown";
+  }
+}
+
 std::string value_t::to_string() const {
   char temp[32] = {'\0'};
   switch (this ? type_ : val_type_none) {
@@ -55,7 +86,26 @@ std::string value_t::to_string() const {
   case val_type_array:
     snprintf(temp, sizeof(temp), "%p", this);
     return std::string("array@") + temp;
+  case val_type_buffer:
+    snprintf(temp, sizeof(temp), "%p", buffer()->data);
+    return std::string("buffer@") + temp;
+  case val_type_int32_array:
+    snprintf(temp, sizeof(temp), "%p", this);
+    return std::string("int32_array@") + temp;
+  case val_type_float32_array:
+    snprintf(temp, sizeof(temp), "%p", this);
+    return std::string("float32_array@") + temp;
+  case val_type_uint8_array:
+    snprintf(temp, sizeof(temp), "%p", this);
+    return std::string("uint8_array@") + temp;
+  case val_type_map:
+    snprintf(temp, sizeof(temp), "%p", this);
+    return std::string("map@") + temp;
   default:
+    if (is_user()) {
+      snprintf(temp, sizeof(temp), "%p", this);
+      return std::string("user@") + temp;
+    }
     assert(!"unknown");
     return "";
   }
@@ -12,6 +12,7 @@ namespace nano {
 
 struct thread_t;
 struct value_gc_t;
+struct value_t;
 enum class thread_error_t;
 
 enum value_type_t {
@@ -23,10 +24,141 @@ enum value_type_t {
   val_type_float,
   val_type_func,
   val_type_syscall,
+  val_type_buffer,
+  val_type_int32_array,
+  val_type_float32_array,
+  val_type_uint8_array,
+  val_type_map,
 
   val_type_user = 0x100,
 };
 
+// return the name of a value type, with all user types named 'user'
+const char *value_type_name(value_type_t type);
+
+// host owned memory referenced by a buffer value
+//
+// the memory is never copied or moved by the collector.  'release' is called
+// once no buffer value refers to it any more, or when the vm is reset.
+struct buffer_t {
+
+  typedef void (*release_t)(void *user, uint8_t *data, int32_t size);
+
+  uint8_t *data;
+  int32_t size;
+  bool writable;
+  release_t release;
+  void *user;
+
+  // collection in which this buffer was last reached
+  uint32_t mark;
+};
+
+// slot in the open addressed table of a map
+struct map_slot_t {
+
+  enum state_t : uint32_t {
+    empty,
+    full,
+    deleted,
+  };
+
+  value_t *key;
+  value_t *value;
+  // cached hash of the key
+  uint32_t hash;
+  state_t state;
+};
+
+// a map value holds a pointer to its table so the table can be replaced when
+// it grows while the map value keeps its identity
+struct map_t {
+
+  struct table_t {
+    // power of two
+    int32_t capacity;
+    // full and deleted slots
+    int32_t used;
+
+    map_slot_t *slots() {
+      return (map_slot_t*)(this + 1);
+    }
+  };
+
+  table_t *table;
+  int32_t count;
+
+  // collection in which this map was last reached
+  uint32_t mark;
+};
+
+// descriptor for a host defined type
+//
+// values of a registered type carry 'size' bytes of host data on the script
+// heap.  the data is moved by the collector so must not hold pointers into
+// itself.  any hook may be nullptr, and a hook returns false to let the
+// operation fail with a type error.
+struct user_type_t {
+
+  typedef bool (*binary_t)(thread_t &t, const value_t *l, const value_t *r);
+
+  user_type_t()
+    : name(nullptr)
+    , size(0)
+    , trace(nullptr)
+    , finalise(nullptr)
+    , on_add(nullptr)
+    , on_sub(nullptr)
+    , on_mul(nullptr)
+    , on_div(nullptr)
+    , on_mod(nullptr)
+    , on_lt(nullptr)
+    , on_equals(nullptr)
+    , on_member_get(nullptr)
+    , on_member_set(nullptr)
+    , on_array_get(nullptr)
+    , on_array_set(nullptr)
+    , member_resolve(nullptr)
+    , member_get(nullptr)
+    , member_set(nullptr)
+  {}
+
+  const char *name;
+
+  // size of the host data
+  size_t size;
+
+  // pass any values referenced from the host data to value_gc_t::trace()
+  void (*trace)(value_gc_t &gc, value_t *self);
+
+  // called once a value has been collected
+  void (*finalise)(value_t *self);
+
+  // operators, called when either operand is of this type
+  binary_t on_add;
+  binary_t on_sub;
+  binary_t on_mul;
+  binary_t on_div;
+  binary_t on_mod;
+  binary_t on_lt;
+  binary_t on_equals;
+
+  // member and array access
+  bool (*on_member_get)(thread_t &t, value_t *obj, const std::string &member);
+  bool (*on_member_set)(thread_t &t, value_t *obj, value_t *expr, const std::string &member);
+  bool (*on_array_get)(thread_t &t, value_t *a, const value_t *index);
+  bool (*on_array_set)(thread_t &t, value_t *a, const value_t *index, value_t *val);
+
+  // resolve a member name to a slot, or -1 if there is no such member
+  //
+  // names are resolved once when the type is registered and the slot is
+  // cached per instruction, so member_get and member_set are used in place
+  // of on_member_get and on_member_set wherever a slot is known.
+  int32_t (*member_resolve)(const std::string &member);
+  bool (*member_get)(thread_t &t, value_t *obj, int32_t slot);
+  bool (*member_set)(thread_t &t, value_t *obj, value_t *expr, int32_t slot);
+};
+
 struct value_t {
 
   value_t()
@@ -75,6 +207,65 @@ struct value_t {
     return (value_t**)(this + 1);
   }
 
+  buffer_t *buffer() const {
+    assert(type() == val_type_buffer);
+    return *(buffer_t**)(this + 1);
+  }
+
+  // true for arrays which store their elements unboxed
+  bool is_packed() const {
+    return type() >= val_type_int32_array &&
+           type() <= val_type_uint8_array;
+  }
+
+  int32_t packed_size() const {
+    assert(is_packed());
+    return v;
+  }
+
+  int32_t *int32_array() const {
+    assert(type() == val_type_int32_array);
+    return (int32_t*)(this + 1);
+  }
+
+  float *float32_array() const {
+    assert(type() == val_type_float32_array);
+    return (float*)(this + 1);
+  }
+
+  uint8_t *uint8_array() const {
+    assert(type() == val_type_uint8_array);
+    return (uint8_t*)(this + 1);
+  }
+
+  // size in bytes of an element of a packed array type
+  static size_t packed_stride(value_type_t type) {
+    switch (type) {
+    case val_type_int32_array:   return sizeof(int32_t);
+    case val_type_float32_array: return sizeof(float);
+    case val_type_uint8_array:   return sizeof(uint8_t);
+    default:                     assert(false); return 0;
+    }
+  }
+
+  map_t *map() const {
+    assert(type() == val_type_map);
+    return (map_t*)(this + 1);
+  }
+
+  bool is_user() const {
+    return type() >= val_type_user;
+  }
+
+  // host data of a registered user type
+  void *user_data() const {
+    assert(is_user());
+    return (uint8_t*)(this + 1) + user_header;
+  }
+
+  // bytes between the value and the host data of a user type
+  static const size_t user_header = 8;
+
   value_type_t type() const {
     return this == nullptr ?
       value_type_t::val_type_none :
@@ -114,13 +305,18 @@ struct value_t {
   int32_t as_bool() const {
     switch (type()) {
     case val_type_array:
+    case val_type_buffer:
+    case val_type_int32_array:
+    case val_type_float32_array:
+    case val_type_uint8_array:
+    case val_type_map:
     case val_type_func:
     case val_type_syscall: return true;
     case val_type_none:    return false;
     case val_type_string:  return v != 0;
     case val_type_float:   return f != 0.f;
     case val_type_int:     return v != 0;
-    default:               assert(false);
+    default:               assert(is_user()); return true;
     }
     return 0;
   }
@@ -129,17 +325,25 @@ struct value_t {
 
   bool is_value_type() const {
     switch (type()) {
-    // XXX: and user types?
     case val_type_array:
+    case val_type_buffer:
+    case val_type_int32_array:
+    case val_type_float32_array:
+    case val_type_uint8_array:
+    case val_type_map:
       return false;
+    default:
+      break;
     }
-    return true;
+    return !is_user();
   }
 
   union {
     // int value
     // string length if string
     // array length if array
+    // buffer size if buffer
+    // element count if packed array
     int32_t v;
     // floating point value
     float f;
@@ -147,6 +351,7 @@ struct value_t {
 
 protected:
   friend struct value_gc_t;
+  friend struct scratch_t;
 
   // note: dont check this directly, please use type() instead as 'this' ptr
   //       can be nullptr
@@ -175,6 +380,14 @@ struct value_stack_t {
   // push a new syscall
   void push_syscall(const int32_t number);
 
+  // push a new value of a registered user type and return it so its host
+  // data can be filled in
+  value_t *push_user(value_type_t type);
+
+  // push a buffer referencing host memory
+  void push_buffer(uint8_t *data, int32_t size, bool writable,
+                   buffer_t::release_t release, void *user);
+
   void clear() {
     stack_.clear();
   }
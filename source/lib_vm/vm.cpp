@@ -1,11 +1,20 @@
+#include <algorithm>
+#include <chrono>
 #include <climits>
 #include <cstring>
 
 #include "program.h"
 #include "instructions.h"
+#include "image.h"
 
 #include "vm.h"
 #include "thread.h"
+#include "jit.h"
+#include "profiler.h"
+#include "opcode_stats.h"
+#include "trace_events.h"
+#include "coverage.h"
+#include "replay.h"
 
 using namespace nano;
 
@@ -13,26 +22,334 @@ namespace nano {
 
 vm_t::vm_t(program_t &program)
   : program_(program)
-  , gc_(new value_gc_t) {}
+  , code_(program.data())
+  , gc_(new value_gc_t)
+  , profiling_(false)
+  , next_thread_id_(1)
+  , patches_(0)
+  , jit_unpatched_(false)
+{
+  member_prepare_();
+#if NANO_JIT_SUPPORTED
+  jit_.reset(new jit_t(*this));
+#endif
+#if NANO_OPCODE_STATS
+  // compiled code does not pass through the interpreter loop
+  jit_enable(false);
+  opcode_stats_.reset(new opcode_stats_t(program_.size()));
+#endif
+}
 
 vm_t::~vm_t() {
+  trace_events_stop();
+  if (opcode_stats_) {
+    // written to the file named by NANO_OPCODE_STATS or stderr
+    const char *path = getenv("NANO_OPCODE_STATS");
+    FILE *fd = path ? fopen(path, "a") : nullptr;
+    opcode_stats_->write(fd ? fd : stderr, 30);
+    if (fd) {
+      fclose(fd);
+    }
+  }
   reset();
 }
 
 void vm_t::gc_collect() {
+  const auto start = std::chrono::steady_clock::now();
+  const uint64_t trace_start = trace_events_ ? trace_events_->now() : 0;
+  const size_t to_used = gc_->to_space_used();
+  counters_.heap_peak.max(gc_->heap_used());
+  for (thread_t *t : threads_) {
+    gc_->scratch_add(&t->scratch_);
+  }
   // traverse globals
   gc_->trace(g_.data(), g_.size());
+  // traverse host handles
+  gc_->trace(handles_.data(), handles_.size());
+  gc_->trace(scoped_.data(), scoped_.size());
   // traverse thread stack
   for (thread_t *t : threads_) {
     gc_->trace(t->stack_.data(), t->stack_.head());
+    t->scratch_.trace(*gc_);
   }
+  const size_t copied = gc_->to_space_used() - to_used;
   // collect
   gc_->collect();
+  if (trace_events_) {
+    trace_events_->complete(trace_event_t::e_gc, trace_start, copied);
+  }
+  const auto took = std::chrono::steady_clock::now() - start;
+  const uint64_t ns = uint64_t(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(took).count());
+  counters_.gc_time_ns.add(ns);
+  counters_.gc_pause_max_ns.max(ns);
+  counters_.collections.add(1);
+  counters_.bytes_copied.add(copied);
+  counters_.heap_mark.set(gc_->heap_used(), gc_->bytes_allocated());
+}
+
+vm_stats_t vm_t::stats() const {
+  vm_stats_t s;
+  s.instructions = counters_.instructions.get();
+  s.threads_created = counters_.threads_created.get();
+  s.threads_finished = counters_.threads_finished.get();
+  s.threads_errored = counters_.threads_errored.get();
+  s.collections = counters_.collections.get();
+  s.gc_time_ns = counters_.gc_time_ns.get();
+  s.gc_pause_max_ns = counters_.gc_pause_max_ns.get();
+  // read the mark first so the allocation total is never behind it
+  uint64_t heap_after_gc = 0;
+  uint64_t allocated_at_gc = 0;
+  counters_.heap_mark.get(heap_after_gc, allocated_at_gc);
+  s.bytes_allocated = gc_->bytes_allocated();
+  s.bytes_copied = counters_.bytes_copied.get();
+  s.syscalls = counters_.syscalls.get();
+  s.syscall_time_ns = counters_.syscall_time_ns.get();
+  // the heap only grows by allocation between collections.  a reset zeroes
+  // the allocation total before the mark so it may briefly be the smaller.
+  const uint64_t since_gc = s.bytes_allocated > allocated_at_gc ?
+                            s.bytes_allocated - allocated_at_gc : 0;
+  s.heap_used = heap_after_gc + since_gc;
+  s.heap_peak = std::max(counters_.heap_peak.get(), s.heap_used);
+  s.threads_live = counters_.threads_live.get();
+  s.threads_waiting = counters_.threads_waiting.get();
+  return s;
+}
+
+void vm_t::member_prepare_() {
+  const uint8_t *code = program_.data();
+  const int32_t size = int32_t(program_.size());
+  const auto &strings = program_.strings();
+  member_ic_index_.assign(size, -1);
+  for (int32_t pc = 0; pc < size;) {
+    const instruction_e ins = instruction_e(code[pc]);
+    if (ins == INS_GETM || ins == INS_SETM) {
+      int32_t member = 0;
+      memcpy(&member, code + pc + 1, sizeof(member));
+      if (member >= 0 && member < int32_t(strings.size())) {
+        member_ids_[strings[member]] = member;
+      }
+      member_ic_index_[pc] = int32_t(member_ics_.size());
+      member_ic_t ic;
+      ic.kind = member_ic_t::ic_empty;
+      ic.type = val_type_unknown;
+      ic.member = -1;
+      ic.user = nullptr;
+      ic.slot = -1;
+      member_ics_.push_back(ic);
+    }
+    pc += ins_size(ins);
+  }
+}
+
+int32_t vm_t::member_id(const std::string &name) const {
+  auto itt = member_ids_.find(name);
+  return itt == member_ids_.end() ? -1 : itt->second;
+}
+
+value_type_t vm_t::user_type_register(const user_type_t &desc) {
+  const value_type_t type = gc_->user_type_register(&desc);
+  // resolve every member name the program uses up front
+  const auto &strings = program_.strings();
+  std::vector<int32_t> slots(strings.size(), -1);
+  if (desc.member_resolve) {
+    const uint8_t *code = program_.data();
+    for (int32_t pc = 0; pc < int32_t(member_ic_index_.size()); ++pc) {
+      if (member_ic_index_[pc] < 0) {
+        continue;
+      }
+      int32_t member = 0;
+      memcpy(&member, code + pc + 1, sizeof(member));
+      if (member >= 0 && member < int32_t(strings.size())) {
+        slots[member] = desc.member_resolve(strings[member]);
+      }
+    }
+  }
+  member_slots_.push_back(std::move(slots));
+  assert(member_slots_.size() == size_t(type - val_type_user + 1));
+  return type;
+}
+
+int32_t vm_t::handle_new(value_t *v) {
+  if (!handles_free_.empty()) {
+    const int32_t index = handles_free_.back();
+    handles_free_.pop_back();
+    handles_[index] = v;
+    return index;
+  }
+  handles_.push_back(v);
+  return int32_t(handles_.size() - 1);
+}
+
+void vm_t::handle_release(int32_t index) {
+  assert(index >= 0 && index < int32_t(handles_.size()));
+  handles_[index] = nullptr;
+  handles_free_.push_back(index);
+}
+
+void vm_t::jit_enable(bool enable) {
+  if (jit_) {
+    jit_->enabled = enable;
+  }
+}
+
+void vm_t::jit_deopt() {
+  if (jit_) {
+    jit_->deopt();
+  }
+}
+
+void vm_t::profiler_start(uint32_t interval) {
+  // compiled code does not keep the pc up to date
+  jit_enable(false);
+  jit_deopt();
+  profiler_.reset(new profiler_t(program_, interval));
+  profiling_ = true;
+}
+
+void vm_t::breakpoint_add(line_t line) {
+  if (!breakpoints_.insert(line).second) {
+    return;
+  }
+  std::vector<int32_t> pcs;
+  program_.line_pcs(line, pcs);
+  for (const int32_t pc : pcs) {
+    code_patch_(pc);
+  }
+}
+
+void vm_t::breakpoint_remove(line_t line) {
+  if (!breakpoints_.erase(line)) {
+    return;
+  }
+  std::vector<int32_t> pcs;
+  program_.line_pcs(line, pcs);
+  for (const int32_t pc : pcs) {
+    // a thread halted here should stop again if the breakpoint returns
+    for (thread_t *t : threads_) {
+      if (t->break_skip_ == pc) {
+        t->break_skip_ = -1;
+      }
+    }
+    // keep any coverage probe in place
+    if (!coverage_ || !coverage_->pending(pc)) {
+      code_restore_(pc);
+    }
+  }
+}
+
+void vm_t::breakpoint_clear() {
+  while (!breakpoints_.empty()) {
+    breakpoint_remove(*breakpoints_.begin());
+  }
+}
+
+bool vm_t::breakpoint_at_(int32_t pc) const {
+  return !breakpoints_.empty() &&
+         breakpoints_.count(program_.get_line(uint32_t(pc))) != 0;
+}
+
+void vm_t::coverage_start() {
+  coverage_.reset(new coverage_t(program_));
+  for (const int32_t pc : coverage_->probes()) {
+    code_patch_(pc);
+  }
+}
+
+bool vm_t::replay_record(const char *path,
+                         const std::vector<std::string> &inputs) {
+  replay_.reset(new replay_t(program_, replay_t::e_record));
+  if (!replay_->open(path, inputs)) {
+    replay_.reset();
+    return false;
+  }
+  return true;
+}
+
+bool vm_t::replay_start(const char *path) {
+  replay_.reset(new replay_t(program_, replay_t::e_replay));
+  if (!replay_->open(path, std::vector<std::string>())) {
+    replay_.reset();
+    return false;
+  }
+  return true;
+}
+
+void vm_t::replay_stop() {
+  replay_.reset();
+}
+
+void vm_t::code_patch_(int32_t pc) {
+  if (pc < 0 || pc >= int32_t(program_.size())) {
+    return;
+  }
+  if (patched_.empty()) {
+    // compiled code does not execute the patched code
+    jit_unpatched_ = jit_ && jit_->enabled;
+    jit_enable(false);
+    jit_deopt();
+    patched_.assign(program_.data(), program_.end());
+    code_ = patched_.data();
+  }
+  if (patched_[pc] != INS_BREAK) {
+    patched_[pc] = INS_BREAK;
+    ++patches_;
+  }
+}
+
+void vm_t::code_restore_(int32_t pc) {
+  if (pc < 0 || pc >= int32_t(patched_.size()) ||
+      patched_[pc] != INS_BREAK) {
+    return;
+  }
+  patched_[pc] = program_.data()[pc];
+  assert(patches_ > 0);
+  if (--patches_ == 0) {
+    // nothing is patched so go back to the program code and the JIT
+    code_ = program_.data();
+    patched_.clear();
+    jit_enable(jit_unpatched_ && !profiling_);
+  }
+}
+
+void vm_t::profiler_stop() {
+  profiling_ = false;
+}
+
+bool vm_t::trace_events_start(const char *path, size_t capacity) {
+  trace_events_stop();
+  trace_events_.reset(new trace_events_t(program_, capacity));
+  if (!trace_events_->open(path)) {
+    trace_events_.reset();
+    return false;
+  }
+  return true;
+}
+
+void vm_t::trace_events_flush() {
+  if (trace_events_) {
+    trace_events_->flush();
+  }
+}
+
+void vm_t::trace_events_stop() {
+  if (trace_events_) {
+    trace_events_->close();
+    trace_events_.reset();
+  }
 }
 
 void vm_t::reset() {
   // reset the garbage collector
   gc_->reset();
+  counters_.reset();
+  // handles stay valid but no longer hold a value
+  for (value_t *&v : handles_) {
+    v = nullptr;
+  }
+  for (value_t *&v : scoped_) {
+    v = nullptr;
+  }
   // delete all threads
   for (thread_t *t : threads_) {
     delete t;
@@ -49,7 +366,82 @@ bool vm_t::call_init() {
   if (!t) {
     return false;
   }
-  return resume(1024 * 8);
+  // run until all globals have been initialized
+  while (!t->finished() && !t->has_error()) {
+    if (!t->resume(128 * 1024)) {
+      break;
+    }
+  }
+  return !t->has_error();
+}
+
+namespace {
+// snapshot file header
+struct snapshot_header_t {
+  uint32_t magic;
+  uint32_t version;
+  // snapshots hold raw pointers so must be loaded on a matching platform
+  uint32_t ptr_size;
+  uint32_t num_globals;
+  // hash of the program which produced the snapshot
+  uint64_t program_hash;
+};
+
+static const uint32_t snapshot_magic =
+    (('P' << 24) | ('N' << 16) | ('S' << 8) | ('N'));
+static const uint32_t snapshot_version = 1;
+} // namespace {}
+
+bool vm_t::snapshot_save(const char *path) {
+  for (const thread_t *t : threads_) {
+    if (!t->finished()) {
+      return false;
+    }
+  }
+  FILE *fd = fopen(path, "wb");
+  if (!fd) {
+    return false;
+  }
+  snapshot_header_t h;
+  h.magic = snapshot_magic;
+  h.version = snapshot_version;
+  h.ptr_size = sizeof(void *);
+  h.num_globals = uint32_t(g_.size());
+  h.program_hash = program_.hash();
+  bool ok = fwrite(&h, sizeof(h), 1, fd) == 1;
+  ok = ok && gc_->snapshot_save(fd, g_.data(), g_.size());
+  return (fclose(fd) == 0) && ok;
+}
+
+bool vm_t::snapshot_load(const char *path) {
+  reset();
+  g_.clear();
+  image::mapping_t m;
+  if (!m.open(path)) {
+    return false;
+  }
+  snapshot_header_t h;
+  if (m.size() < sizeof(h)) {
+    return false;
+  }
+  memcpy(&h, m.data(), sizeof(h));
+  if (h.magic != snapshot_magic ||
+      h.version != snapshot_version ||
+      h.ptr_size != sizeof(void *)) {
+    return false;
+  }
+  // the heap holds code addresses and syscall indices so the program must
+  // match the one the snapshot was taken from
+  if (h.program_hash != program_.hash()) {
+    return false;
+  }
+  g_.resize(h.num_globals, nullptr);
+  if (!gc_->snapshot_load(m.data() + sizeof(h), m.size() - sizeof(h),
+                          g_.data(), g_.size())) {
+    g_.clear();
+    return false;
+  }
+  return true;
 }
 
 bool vm_t::call_once(const function_t &func,
@@ -84,18 +476,41 @@ thread_t *vm_t::new_thread(const function_t &func,
     return nullptr;
   }
   thread_t *inst = t.get();
+  inst->id_ = next_thread_id_++;
+  if (trace_events_) {
+    trace_events_->instant(trace_event_t::e_thread_create, inst->id_,
+                           uint64_t(func.code_start_));
+  }
   // insert into the thread list
   threads_.push_front(t.release());
+  counters_.threads_created.add(1);
+  counters_.threads_live.set(threads_.size());
   return inst;
 }
 
 bool vm_t::resume(uint32_t cycles) {
+  if (!replay_) {
+    return resume_(cycles);
+  }
+  // the budget comes from the log when replaying
+  if (!replay_->resume(cycles)) {
+    return false;
+  }
+  const uint64_t start = counters_.instructions.get();
+  const bool ok = resume_(cycles);
+  replay_->resume_done(counters_.instructions.get() - start);
+  return ok;
+}
+
+bool vm_t::resume_(uint32_t cycles) {
+  uint64_t waiting = 0;
   auto itt = threads_.begin();
   for (; itt != threads_.end();) {
     thread_t *t = *itt;
     assert(t);
     if (t->waits) {
       --t->waits;
+      ++waiting;
       ++itt;
       continue;
     }
@@ -103,6 +518,7 @@ bool vm_t::resume(uint32_t cycles) {
       // delete the thread
       delete t;
       itt = threads_.erase(itt);
+      counters_.threads_live.set(threads_.size());
       continue;
     }
     // we will be advancing regardless
@@ -110,9 +526,11 @@ bool vm_t::resume(uint32_t cycles) {
     if (!t->resume(cycles)) {
       // thread has an error
       assert(t->has_error());
+      counters_.threads_waiting.set(waiting);
       return false;
     }
   }
+  counters_.threads_waiting.set(waiting);
   return true;
 }
 
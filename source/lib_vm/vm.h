@@ -8,16 +8,30 @@
 #include <cstdlib>
 #include <memory>
 #include <list>
+#include <unordered_map>
 
 #include "../lib_common/common.h"
 #include "../lib_common/types.h"
 
 #include "vm_gc.h"
+#include "vm_stats.h"
 
 
 namespace nano {
 
 struct thread_t;
+struct jit_t;
+struct profiler_t;
+struct opcode_stats_t;
+struct coverage_t;
+struct replay_t;
+struct trace_events_t;
+
+// a natively compiled function
+//
+// note: called with its stack frame already entered, it must return the same
+//       way the INS_RET instruction does.
+typedef void (*nano_native_t)(thread_t &t);
 
 struct handlers_t {
 
@@ -58,6 +72,27 @@ struct handlers_t {
   bool (*on_div)(thread_t &t, const value_t *l, const value_t *r);
 };
 
+// inline cache for a GETM or SETM instruction
+struct member_ic_t {
+
+  enum kind_t {
+    ic_empty,
+    ic_array_length,
+    ic_buffer_length,
+    ic_packed_length,
+    ic_map_length,
+    ic_user_slot,
+  };
+
+  kind_t kind;
+  // receiver type and member this entry was filled for
+  value_type_t type;
+  int32_t member;
+  // resolved user type slot
+  const user_type_t *user;
+  int32_t slot;
+};
+
 struct vm_t {
 
   vm_t(program_t &program);
@@ -68,6 +103,13 @@ struct vm_t {
   // call the init function
   bool call_init();
 
+  // save the globals and heap to a snapshot file
+  // note: all threads must have finished, as when call_init() returns
+  bool snapshot_save(const char *path);
+
+  // restore the globals and heap from a snapshot in place of call_init()
+  bool snapshot_load(const char *path);
+
   // execute a single function
   // XXX: this return value could die and is not safe
   // XXX: remove return value and error field
@@ -107,6 +149,145 @@ struct vm_t {
     return program_;
   }
 
+  // execute a native function in place of the bytecode function at 'addr'
+  void native_register(int32_t addr, nano_native_t func) {
+    natives_[addr] = func;
+  }
+
+  nano_native_t native_find(int32_t addr) const {
+    if (natives_.empty()) {
+      return nullptr;
+    }
+    auto itt = natives_.find(addr);
+    return itt == natives_.end() ? nullptr : itt->second;
+  }
+
+  void native_unregister(int32_t addr) {
+    natives_.erase(addr);
+  }
+
+  // register a host defined type, returning its type id
+  // note: the descriptor must outlive the vm
+  value_type_t user_type_register(const user_type_t &desc);
+
+  const user_type_t *user_type(value_type_t type) const {
+    return gc_->user_type(type);
+  }
+
+  // return the id of a member name accessed by the program, or -1 if it is
+  // never accessed.  ids are the operands of GETM and SETM.
+  int32_t member_id(const std::string &name) const;
+
+  // host handles
+  //
+  // a handle is a slot the garbage collector treats as a root and updates
+  // when the value it holds is moved.  persistent handles live until they
+  // are released, scoped handles until their handle_scope_t is destroyed.
+  // see handle.h for the RAII wrappers.
+  int32_t handle_new(value_t *v);
+  void handle_release(int32_t index);
+
+  value_t *handle_get(int32_t index) const {
+    assert(index >= 0 && index < int32_t(handles_.size()));
+    return handles_[index];
+  }
+
+  void handle_set(int32_t index, value_t *v) {
+    assert(index >= 0 && index < int32_t(handles_.size()));
+    handles_[index] = v;
+  }
+
+  // enable or disable the JIT compiler (when built with NANO_JIT)
+  void jit_enable(bool enable);
+
+  // discard all JIT compiled code and stay in the interpreter
+  void jit_deopt();
+
+  // start sampling the running thread every 'interval' instructions
+  // note: this discards any previous profile
+  void profiler_start(uint32_t interval = 1000);
+
+  // stop sampling, keeping the profile
+  void profiler_stop();
+
+  // return the profile, or nullptr if the profiler was never started
+  const profiler_t *profiler() const {
+    return profiler_.get();
+  }
+
+  // record allocations by code address and type, and take a census of the
+  // live heap at each collection
+  void alloc_tracker_start() {
+    gc_->alloc_tracker_start();
+  }
+
+  // return the allocation records, or nullptr if tracking was never started
+  const alloc_tracker_t *alloc_tracker() const {
+    return gc_->alloc_tracker();
+  }
+
+  // start writing a chrome trace event file of thread slices, syscalls and
+  // collections.  up to 'capacity' events are buffered while a background
+  // writer thread drains them to the file.
+  bool trace_events_start(const char *path, size_t capacity = 1 << 16);
+
+  // write out the buffered events
+  // note: this may be called from another OS thread while the vm runs
+  void trace_events_flush();
+
+  // flush and finish the trace file
+  void trace_events_stop();
+
+  // return the instruction counters, or nullptr unless built with
+  // NANO_OPCODE_STATS
+  const opcode_stats_t *opcode_stats() const {
+    return opcode_stats_.get();
+  }
+
+  // halt any thread about to execute the first instruction of 'line'
+  //
+  // breakpoints are patched into a private copy of the code as INS_BREAK so
+  // instructions on other lines run at full speed.
+  void breakpoint_add(line_t line);
+  void breakpoint_remove(line_t line);
+  void breakpoint_clear();
+
+  const std::set<line_t> &breakpoints() const {
+    return breakpoints_;
+  }
+
+  // record which basic blocks and branch outcomes execute from now on
+  void coverage_start();
+
+  // return the coverage, or nullptr if it was never started
+  const coverage_t *coverage() const {
+    return coverage_.get();
+  }
+
+  // record the results of the 'inputs' syscalls and the scheduler budgets
+  // to a log, see replay.h
+  bool replay_record(const char *path, const std::vector<std::string> &inputs);
+
+  // replay a log recorded from the same program
+  bool replay_start(const char *path);
+
+  // finish recording or replaying
+  void replay_stop();
+
+  // return the active recording or replay, or nullptr
+  const replay_t *replay() const {
+    return replay_.get();
+  }
+
+  // return a snapshot of the vm statistics
+  // note: this may be called from another OS thread while the vm runs
+  vm_stats_t stats() const;
+
+  // return the number of bytes currently allocated on the heap
+  size_t heap_used() const {
+    return gc_->heap_used();
+  }
+
   // handlers
   handlers_t handlers;
 
@@ -116,15 +297,107 @@ protected:
   // the currently bound program
   program_t &program_;
 
+  // the code being executed, the program's or a patched copy
+  const uint8_t *code_;
+
   // garbage collector
   std::unique_ptr<value_gc_t> gc_;
   void gc_collect();
 
+  // statistics
+  vm_counters_t counters_;
+
   // globals
   std::vector<value_t*> g_;
 
   // threads
   std::list<thread_t *> threads_;
+
+  // native functions keyed by code address
+  std::unordered_map<int32_t, nano_native_t> natives_;
+
+  // build the member tables and inline caches for the program
+  void member_prepare_();
+
+  // return the inline cache for the instruction at 'pc', if it has one
+  member_ic_t *member_ic_(int32_t pc) {
+    if (pc < 0 || pc >= int32_t(member_ic_index_.size())) {
+      return nullptr;
+    }
+    const int32_t index = member_ic_index_[pc];
+    return index < 0 ? nullptr : &member_ics_[index];
+  }
+
+  // return the slot for a member of a user type, or -1
+  int32_t member_slot_(value_type_t type, int32_t member) const {
+    const size_t index = size_t(type) - val_type_user;
+    if (index >= member_slots_.size()) {
+      return -1;
+    }
+    const std::vector<int32_t> &slots = member_slots_[index];
+    return (member >= 0 && member < int32_t(slots.size())) ? slots[member] : -1;
+  }
+
+  // member names accessed by the program mapped to their ids
+  std::unordered_map<std::string, int32_t> member_ids_;
+
+  // inline cache index for each code address, or -1
+  std::vector<int32_t> member_ic_index_;
+  std::vector<member_ic_t> member_ics_;
+
+  // resolved user type slots indexed by type and member id
+  std::vector<std::vector<int32_t>> member_slots_;
+
+  // host handle slots and a free list of released slots
+  std::vector<value_t*> handles_;
+  std::vector<int32_t> handles_free_;
+
+  // stack of scoped handles
+  friend struct handle_scope_t;
+  std::vector<value_t*> scoped_;
+
+  // JIT compiler, if supported
+  std::unique_ptr<jit_t> jit_;
+
+  // sampling profiler and if it is taking samples
+  std::unique_ptr<profiler_t> profiler_;
+  bool profiling_;
+
+  // instruction counters when built with NANO_OPCODE_STATS
+  std::unique_ptr<opcode_stats_t> opcode_stats_;
+
+  // trace event recorder, if tracing
+  std::unique_ptr<trace_events_t> trace_events_;
+
+  // id given to the next thread created
+  uint32_t next_thread_id_;
+
+  // record or replay log, if active
+  std::unique_ptr<replay_t> replay_;
+
+  // schedule each thread once
+  bool resume_(uint32_t cycles);
+
+  // breakpoint lines
+  std::set<line_t> breakpoints_;
+
+  // coverage probes, if collecting coverage
+  std::unique_ptr<coverage_t> coverage_;
+
+  // a copy of the code with INS_BREAK patched over breakpoints and probes,
+  // made when the first is placed and dropped when the last is removed
+  std::vector<uint8_t> patched_;
+  int32_t patches_;
+
+  // if the JIT was enabled before the code was patched
+  bool jit_unpatched_;
+
+  // patch INS_BREAK over the instruction at 'pc' or restore it
+  void code_patch_(int32_t pc);
+  void code_restore_(int32_t pc);
+
+  // true if 'pc' is the start of a breakpoint line
+  bool breakpoint_at_(int32_t pc) const;
 };
 
 } // namespace nano
@@ -4,19 +4,42 @@
 
 #define HARDCORE 0
 
+namespace {
+
+using namespace nano;
+
+// size in bytes of a heap value including its payload
+size_t value_size(const value_t *v) {
+  switch (v->type()) {
+  case val_type_string:
+    return sizeof(value_t) + v->strlen() + 1;
+  case val_type_array:
+    return sizeof(value_t) + v->array_size() * sizeof(value_t *);
+  case val_type_buffer:
+    return sizeof(value_t) + sizeof(buffer_t *);
+  case val_type_int32_array:
+  case val_type_float32_array:
+  case val_type_uint8_array:
+    return sizeof(value_t) +
+           v->packed_size() * value_t::packed_stride(v->type());
+  default:
+    return sizeof(value_t);
+  }
+}
+
+} // namespace {}
+
 namespace nano {
 
 value_t *value_gc_t::new_int(const int32_t value) {
-  value_t *v = space_to().alloc<value_t>(0);
-  assert(v);
+  value_t *v = alloc_(val_type_int, 0);
   v->type_ = val_type_int;
   v->v = value;
   return v;
 }
 
 value_t *value_gc_t::new_float(const float value) {
-  value_t *v = space_to().alloc<value_t>(0);
-  assert(v);
+  value_t *v = alloc_(val_type_float, 0);
   v->type_ = val_type_float;
   v->f = value;
   return v;
@@ -24,8 +47,7 @@ value_t *value_gc_t::new_float(const float value) {
 
 value_t *value_gc_t::new_array(int32_t value) {
   size_t size = value * sizeof(value_t *);
-  value_t *v = space_to().alloc<value_t>(size);
-  assert(v);
+  value_t *v = alloc_(val_type_array, size);
   v->type_ = val_type_array;
   assert(value > 0);
   memset(v->array(), 0, size);
@@ -35,8 +57,7 @@ value_t *value_gc_t::new_array(int32_t value) {
 
 value_t *value_gc_t::new_string(const std::string &value) {
   const int32_t size = int32_t(value.size());
-  value_t *v = space_to().alloc<value_t>(value.size() + 1);
-  assert(v);
+  value_t *v = alloc_(val_type_string, value.size() + 1);
   v->type_ = val_type_string;
   v->v = size;
   // copy string
@@ -47,8 +68,7 @@ value_t *value_gc_t::new_string(const std::string &value) {
 }
 
 value_t *value_gc_t::new_string(int32_t len) {
-  value_t *v = space_to().alloc<value_t>(len + 1);
-  assert(v);
+  value_t *v = alloc_(val_type_string, len + 1);
   v->type_ = val_type_string;
   v->v = len;
   v->string()[0] = '\0';
@@ -60,21 +80,164 @@ value_t *value_gc_t::new_none() {
 }
 
 value_t *value_gc_t::new_func(uint32_t offset) {
-  value_t *v = space_to().alloc<value_t>(0);
-  assert(v);
+  value_t *v = alloc_(val_type_func, 0);
   v->type_ = val_type_func;
   v->v = offset;
   return v;
 }
 
 value_t *value_gc_t::new_syscall(uint32_t index) {
-  value_t *v = space_to().alloc<value_t>(0);
-  assert(v);
+  value_t *v = alloc_(val_type_syscall, 0);
   v->type_ = val_type_syscall;
   v->v = index;
   return v;
 }
 
+value_t *value_gc_t::new_packed(value_type_t type, int32_t value) {
+  assert(value >= 0);
+  const size_t size = value * value_t::packed_stride(type);
+  value_t *v = alloc_(type, size);
+  v->type_ = type;
+  v->v = value;
+  memset((uint8_t *)(v + 1), 0, size);
+  return v;
+}
+
+value_t *value_gc_t::new_buffer(uint8_t *data, int32_t size, bool writable,
+                                buffer_t::release_t release, void *user) {
+  assert(size >= 0);
+  std::unique_ptr<buffer_t> buf(new buffer_t);
+  buf->data = data;
+  buf->size = size;
+  buf->writable = writable;
+  buf->release = release;
+  buf->user = user;
+  // must be reached by the next trace to stay alive
+  buf->mark = epoch_ - 1;
+  value_t *v = alloc_(val_type_buffer, sizeof(buffer_t *));
+  v->type_ = val_type_buffer;
+  v->v = size;
+  *(buffer_t **)(v + 1) = buf.get();
+  buffers_.push_back(std::move(buf));
+  return v;
+}
+
+value_type_t value_gc_t::user_type_register(const user_type_t *desc) {
+  assert(desc);
+  user_types_.push_back(desc);
+  return value_type_t(val_type_user + user_types_.size() - 1);
+}
+
+value_t *value_gc_t::new_user(value_type_t type) {
+  const user_type_t *desc = user_type(type);
+  assert(desc);
+  const size_t size = value_t::user_header + desc->size;
+  value_t *v = alloc_(type, size);
+  memset((uint8_t *)(v + 1), 0, size);
+  v->type_ = type;
+  v->v = 0;
+  // must be reached by the next trace to stay alive
+  user_mark_(v) = epoch_ - 1;
+  if (desc->finalise) {
+    finalise_.push_back(v);
+  }
+  return v;
+}
+
+void value_gc_t::trace_user_(value_t *&v) {
+  const user_type_t *desc = user_type(v->type());
+  assert(desc);
+  if (space_to().owns(v)) {
+    // not moving, but still trace its references once per collection
+    if (user_mark_(v) != epoch_) {
+      user_mark_(v) = epoch_;
+      if (desc->trace) {
+        desc->trace(*this, v);
+      }
+    }
+    return;
+  }
+  assert(space_from().owns(v));
+  if (value_t *x = forward_find(v)) {
+    v = x;
+    return;
+  }
+  // move first so that cycles back to this value find the forward
+  const size_t size = sizeof(value_t) + value_t::user_header + desc->size;
+  value_t *n = space_to().alloc<value_t>(size - sizeof(value_t));
+  assert(n);
+  memcpy(n, v, size);
+  forward_add(v, n);
+  moved_(v, n);
+  v = n;
+  user_mark_(n) = epoch_;
+  if (desc->trace) {
+    desc->trace(*this, n);
+  }
+}
+
+void value_gc_t::finalise_users_(bool all) {
+  size_t j = 0;
+  for (size_t i = 0; i < finalise_.size(); ++i) {
+    value_t *v = finalise_[i];
+    if (!all) {
+      if (value_t *x = forward_find(v)) {
+        finalise_[j++] = x;
+        continue;
+      }
+      if (user_mark_(v) == epoch_) {
+        finalise_[j++] = v;
+        continue;
+      }
+    }
+    user_type(v->type())->finalise(v);
+  }
+  finalise_.resize(all ? 0 : j);
+}
+
+void value_gc_t::release_buffers_(bool all) {
+  size_t j = 0;
+  for (size_t i = 0; i < buffers_.size(); ++i) {
+    buffer_t *b = buffers_[i].get();
+    if (!all && b->mark == epoch_) {
+      buffers_[j++] = std::move(buffers_[i]);
+      continue;
+    }
+    if (b->release) {
+      b->release(b->user, b->data, b->size);
+    }
+  }
+  buffers_.resize(all ? 0 : j);
+}
+
+value_t *scratch_t::new_array(int32_t value) {
+  assert(value > 0);
+  const size_t size = sizeof(value_t) + value * sizeof(value_t *);
+  if (head_ + size > capacity) {
+    return nullptr;
+  }
+  if (!data_) {
+    data_.reset(new uint8_t[capacity]);
+  }
+  value_t *v = (value_t*)(data_.get() + head_);
+  head_ += size;
+  v->type_ = val_type_array;
+  v->v = value;
+  memset(v->array(), 0, value * sizeof(value_t *));
+  return v;
+}
+
+void scratch_t::trace(value_gc_t &gc) {
+  size_t offs = 0;
+  while (offs < head_) {
+    value_t *v = (value_t*)(data_.get() + offs);
+    assert(v->type() == val_type_array);
+    const int32_t size = v->array_size();
+    gc.trace(v->array(), size);
+    offs += sizeof(value_t) + size * sizeof(value_t *);
+  }
+}
+
 bool value_gc_t::should_collect() const {
   const size_t x = (space_to().size() * 100) / space_to().capacity();
 #if HARDCORE
@@ -101,15 +264,48 @@ value_t *value_gc_t::copy(const value_t &a) {
     return new_func(a.v);
   case val_type_syscall:
     return new_syscall(a.v);
+  case val_type_buffer: {
+    // buffers are references so share the host memory
+    value_t *v = alloc_(val_type_buffer, sizeof(buffer_t *));
+    v->type_ = val_type_buffer;
+    v->v = a.v;
+    *(buffer_t **)(v + 1) = a.buffer();
+    return v;
+  }
   case val_type_none:
     return nullptr;
   default:
+    // packed arrays, maps and user types are references so share the value
+    if (a.is_packed() || a.type() == val_type_map || a.is_user()) {
+      return const_cast<value_t *>(&a);
+    }
     assert(false);
     return nullptr;
   }
 }
 
 void value_gc_t::collect() {
+  if (tracker_) {
+    // everything left in the to space is live
+    const arena_t &to = space_to();
+    tracker_->census(
+      [&](const value_t *v) { return to.owns(v); },
+      [](const value_t *v) {
+        size_t size = value_size(v);
+        if (v->type() == val_type_map) {
+          const map_t::table_t *table = v->map()->table;
+          size += sizeof(map_t) + sizeof(map_t::table_t) +
+                  table->capacity * sizeof(map_slot_t);
+        }
+        return size;
+      });
+  }
+  // buffers and user values which were not reached while tracing are now
+  // garbage
+  release_buffers_(false);
+  finalise_users_(false);
+  ++epoch_;
+  scratch_.clear();
   swap();
   space_to().clear();
   forward_clear();
@@ -123,20 +319,47 @@ void value_gc_t::trace(value_t **list, size_t num) {
   for (size_t i = 0; i < num; ++i) {
     value_t *&v = list[i];
 
+    // released host handles leave null slots behind
+    if (v == nullptr) {
+      continue;
+    }
+
+    // user types and maps manage their own tracing
+    if (v->is_user()) {
+      trace_user_(v);
+      continue;
+    }
+    if (v->type() == val_type_map) {
+      trace_map_(v);
+      continue;
+    }
+
     // a value may be new yet contain referenced to old data therefore we must
     // visit these nodes regardless
     switch (v->type()) {
-    case val_type_array:
+    case val_type_array: {
       // collect child elements
       const int32_t size = v->array_size();
       trace(v->array(), size);
+      break;
+    }
+    case val_type_buffer:
+      // keep the host memory alive
+      v->buffer()->mark = epoch_;
+      break;
+    default:
+      break;
     }
 
     // already collected so skip to avoid cyclic trace loops
     if (to.owns(v)) {
       continue;
     }
-    assert(v == nullptr || space_from().owns(v));
+    // frame scratch arrays live outside of the heap and are never moved
+    if (v && !space_from().owns(v)) {
+      assert(v->type() == val_type_array && scratch_owns_(v));
+      continue;
+    }
 
     switch (v->type()) {
     case val_type_none: {
@@ -149,6 +372,7 @@ void value_gc_t::trace(value_t **list, size_t num) {
       value_t *n = to.alloc<value_t>(0);
       n->type_ = v->type();
       n->v = v->v;
+      moved_(v, n);
       list[i] = n;
       break;
     }
@@ -156,6 +380,17 @@ void value_gc_t::trace(value_t **list, size_t num) {
       value_t *n = to.alloc<value_t>(0);
       n->type_ = v->type();
       n->f = v->f;
+      moved_(v, n);
+      list[i] = n;
+      break;
+    }
+    case val_type_buffer: {
+      // only the header moves, the host memory stays where it is
+      value_t *n = to.alloc<value_t>(sizeof(buffer_t *));
+      n->type_ = v->type();
+      n->v = v->v;
+      *(buffer_t **)(n + 1) = v->buffer();
+      moved_(v, n);
       list[i] = n;
       break;
     }
@@ -166,6 +401,24 @@ void value_gc_t::trace(value_t **list, size_t num) {
       n->type_ = v->type();
       n->v = size;
       memcpy(n->string(), v->string(), size + 1);
+      moved_(v, n);
+      list[i] = n;
+      break;
+    }
+    case val_type_int32_array:
+    case val_type_float32_array:
+    case val_type_uint8_array: {
+      // packed arrays are references so must keep their identity
+      if (value_t *x = forward_find(v)) {
+        list[i] = x;
+        break;
+      }
+      // the elements are opaque so just move the whole block
+      const size_t size = value_size(v);
+      value_t *n = to.alloc<value_t>(size - sizeof(value_t));
+      memcpy(n, v, size);
+      forward_add(v, n);
+      moved_(v, n);
       list[i] = n;
       break;
     }
@@ -187,6 +440,7 @@ void value_gc_t::trace(value_t **list, size_t num) {
       memcpy(n->array(), v->array(), size * sizeof(value_t *));
       // keep track of forwarded global arrays that may have to move
       forward_add(v, n);
+      moved_(v, n);
       list[i] = n;
       break;
     }
@@ -196,4 +450,173 @@ void value_gc_t::trace(value_t **list, size_t num) {
   }
 }
 
+// heap snapshots
+//
+//    uint64_t  heap size
+//    uintptr_t roots [count]
+//    uint8_t   heap [heap size]
+//
+// references are stored as an offset into the heap plus one, so that none is
+// zero, and are relocated when loaded.
+bool value_gc_t::snapshot_save(FILE *fd,
+                               value_t *const *roots,
+                               size_t count) const {
+  // assign every reachable value an offset in the heap image
+  std::unordered_map<const value_t *, uintptr_t> offsets;
+  std::vector<const value_t *> order;
+  std::vector<const value_t *> work(roots, roots + count);
+  uint64_t head = 0;
+  while (!work.empty()) {
+    const value_t *v = work.back();
+    work.pop_back();
+    if (!v || offsets.count(v)) {
+      continue;
+    }
+    if (v->type() == val_type_buffer || v->type() == val_type_map ||
+        v->is_user()) {
+      // host memory, user data and maps can not be saved
+      return false;
+    }
+    offsets[v] = uintptr_t(head);
+    order.push_back(v);
+    head += value_size(v);
+    if (v->type() == val_type_array) {
+      value_t **elms = v->array();
+      work.insert(work.end(), elms, elms + v->array_size());
+    }
+  }
+  auto ref = [&](const value_t *v) -> uintptr_t {
+    return v ? offsets.find(v)->second + 1 : 0;
+  };
+  // build the heap image
+  std::vector<uint8_t> heap(size_t(head), 0);
+  for (const value_t *v : order) {
+    uint8_t *dst = heap.data() + offsets[v];
+    memcpy(dst, v, value_size(v));
+    if (v->type() == val_type_array) {
+      uintptr_t *elms = (uintptr_t *)(dst + sizeof(value_t));
+      for (int32_t i = 0; i < v->array_size(); ++i) {
+        elms[i] = ref(v->array()[i]);
+      }
+    }
+  }
+  std::vector<uintptr_t> root_refs(count);
+  for (size_t i = 0; i < count; ++i) {
+    root_refs[i] = ref(roots[i]);
+  }
+  // write it out
+  bool ok = true;
+  ok &= fwrite(&head, sizeof(head), 1, fd) == 1;
+  if (count) {
+    ok &= fwrite(root_refs.data(), sizeof(uintptr_t), count, fd) == count;
+  }
+  if (head) {
+    ok &= fwrite(heap.data(), 1, heap.size(), fd) == heap.size();
+  }
+  return ok;
+}
+
+bool value_gc_t::snapshot_load(const uint8_t *data, size_t size,
+                               value_t **roots, size_t count) {
+  reset();
+  // check the sizes match
+  uint64_t heap_size = 0;
+  if (size < sizeof(heap_size)) {
+    return false;
+  }
+  memcpy(&heap_size, data, sizeof(heap_size));
+  const size_t roots_size = count * sizeof(uintptr_t);
+  if (size - sizeof(heap_size) < roots_size ||
+      size - sizeof(heap_size) - roots_size != heap_size) {
+    return false;
+  }
+  const uint8_t *root_refs = data + sizeof(heap_size);
+  // copy the heap into the to space
+  uint8_t *base = nullptr;
+  if (heap_size) {
+    base = space_to().alloc_bytes(size_t(heap_size));
+    if (!base) {
+      return false;
+    }
+    bytes_allocated_.add(size_t(heap_size));
+    memcpy(base, root_refs + roots_size, size_t(heap_size));
+  }
+  // check the heap is well formed and find where each value starts
+  std::vector<bool> starts(size_t(heap_size), false);
+  for (uint64_t offs = 0; offs < heap_size;) {
+    if (heap_size - offs < sizeof(value_t)) {
+      reset();
+      return false;
+    }
+    value_t *v = (value_t *)(base + offs);
+    switch (v->type_) {
+    case val_type_int:
+    case val_type_float:
+    case val_type_func:
+    case val_type_syscall:
+      break;
+    case val_type_string:
+    case val_type_array:
+    case val_type_int32_array:
+    case val_type_float32_array:
+    case val_type_uint8_array:
+      if (v->v < 0 || (v->type_ == val_type_array && v->v == 0)) {
+        reset();
+        return false;
+      }
+      break;
+    default:
+      reset();
+      return false;
+    }
+    const uint64_t vsize = value_size(v);
+    if (vsize > heap_size - offs) {
+      reset();
+      return false;
+    }
+    if (v->type_ == val_type_string && v->string()[v->v] != '\0') {
+      reset();
+      return false;
+    }
+    starts[size_t(offs)] = true;
+    offs += vsize;
+  }
+  // relocate a reference
+  auto fix = [&](value_t *&out, uintptr_t r) -> bool {
+    if (r == 0) {
+      out = nullptr;
+      return true;
+    }
+    if (r - 1 >= heap_size || !starts[r - 1]) {
+      return false;
+    }
+    out = (value_t *)(base + r - 1);
+    return true;
+  };
+  for (uint64_t offs = 0; offs < heap_size;) {
+    value_t *v = (value_t *)(base + offs);
+    if (v->type_ == val_type_array) {
+      value_t **elms = v->array();
+      for (int32_t i = 0; i < v->array_size(); ++i) {
+        uintptr_t r;
+        memcpy(&r, elms + i, sizeof(r));
+        if (!fix(elms[i], r)) {
+          reset();
+          return false;
+        }
+      }
+    }
+    offs += value_size(v);
+  }
+  for (size_t i = 0; i < count; ++i) {
+    uintptr_t r;
+    memcpy(&r, root_refs + i * sizeof(uintptr_t), sizeof(r));
+    if (!fix(roots[i], r)) {
+      reset();
+      return false;
+    }
+  }
+  return true;
+}
+
 } // namespace nano
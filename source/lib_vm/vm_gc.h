@@ -1,13 +1,17 @@
 #pragma once
 #include <cassert>
+#include <cstdio>
 #include <string>
 #include <set>
 #include <vector>
 #include <array>
 #include <unordered_map>
 #include <unordered_set>
+#include <memory>
 
 #include "value.h"
+#include "alloc_tracker.h"
+#include "vm_stats.h"
 
 namespace nano {
 
@@ -34,6 +38,16 @@ struct arena_t {
     return nullptr;
   }
 
+  // allocate a raw block of memory
+  uint8_t *alloc_bytes(size_t size) {
+    if ((head_ + size) < data_.size()) {
+      uint8_t *out = data_.data() + head_;
+      head_ += size;
+      return out;
+    }
+    return nullptr;
+  }
+
   void clear() {
     head_ = 0;
 #if 0
@@ -61,6 +75,52 @@ protected:
   const void *const end_;
 };
 
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+//
+// stack like allocator for arrays which never escape their stack frame
+//
+// arrays here are never moved by the garbage collector, but their elements
+// must still be traced as they can reference heap values.
+//
+struct scratch_t {
+
+  scratch_t()
+    : head_(0)
+  {}
+
+  // allocate a new array or return nullptr if there is no space left
+  value_t *new_array(int32_t size);
+
+  // current allocation head
+  size_t head() const {
+    return head_;
+  }
+
+  // release everything allocated after a given head
+  void release(size_t head) {
+    assert(head <= head_);
+    head_ = head;
+  }
+
+  void clear() {
+    head_ = 0;
+  }
+
+  // trace the elements of all live arrays
+  void trace(struct value_gc_t &gc);
+
+  bool owns(const value_t *v) const {
+    const uint8_t *p = (const uint8_t*)v;
+    return data_ && p >= data_.get() && p < data_.get() + capacity;
+  }
+
+  static const size_t capacity = 1024 * 16;
+
+protected:
+  size_t head_;
+  std::unique_ptr<uint8_t[]> data_;
+};
+
 // ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
 //
 // ultra simple halt-the-world garbage collector
@@ -83,27 +143,153 @@ struct value_gc_t {
 
   value_t *new_syscall(uint32_t index);
 
+  // allocate a packed array of 'size' zeroed elements
+  value_t *new_packed(value_type_t type, int32_t size);
+
+  value_t *new_map();
+
+  // return the value stored for a key, setting 'found' if the key exists
+  // note: keys must be int or string
+  value_t *map_get(const value_t *map, const value_t *key, bool &found) const;
+
+  // insert or replace the value for a key, returning false if the table
+  // could not grow
+  bool map_set(value_t *map, const value_t *key, value_t *value);
+
+  // remove a key returning true if it was present
+  bool map_remove(value_t *map, const value_t *key);
+
+  static bool map_key_valid(const value_t *key) {
+    return key &&
+           (key->type() == val_type_int || key->type() == val_type_string);
+  }
+
+  value_t *new_buffer(uint8_t *data, int32_t size, bool writable,
+                      buffer_t::release_t release, void *user);
+
+  // allocate a value of a registered user type with zeroed host data
+  value_t *new_user(value_type_t type);
+
+  // register a user type returning its type id
+  // note: the descriptor must outlive the collector
+  value_type_t user_type_register(const user_type_t *desc);
+
+  const user_type_t *user_type(value_type_t type) const {
+    const size_t index = size_t(type) - val_type_user;
+    return index < user_types_.size() ? user_types_[index] : nullptr;
+  }
+
   value_t *copy(const value_t &v);
 
   void collect();
 
   void trace(value_t **input, size_t count);
 
+  // note scratch memory which traced values may point into until the next
+  // collect()
+  void scratch_add(const scratch_t *scratch) {
+    scratch_.push_back(scratch);
+  }
+
   value_gc_t()
     : flipflop_(0)
+    , epoch_(0)
   {}
 
+  ~value_gc_t() {
+    release_buffers_(true);
+    finalise_users_(true);
+  }
+
   bool should_collect() const;
 
+  // bytes allocated in both half spaces
+  size_t heap_used() const {
+    return space_from().size() + space_to().size();
+  }
+
+  // total bytes allocated since the last reset
+  // note: this may be read from any OS thread
+  uint64_t bytes_allocated() const {
+    return bytes_allocated_.get();
+  }
+
+  // bytes allocated in the half space values are moved into
+  size_t to_space_used() const {
+    return space_to().size();
+  }
+
+  // longest string a host may ask to allocate.  a collection runs before an
+  // instruction once a half space is three quarters full, so an eighth of
+  // one always fits
+  size_t max_string() const {
+    return space_to().capacity() / 8;
+  }
+
+  // start recording allocations, discarding any previous records
+  void alloc_tracker_start() {
+    tracker_.reset(new alloc_tracker_t);
+  }
+
+  const alloc_tracker_t *alloc_tracker() const {
+    return tracker_.get();
+  }
+
+  // attribute allocations to the instruction before '*pc', or to the host
+  // when nullptr
+  void alloc_site(const int32_t *pc) {
+    if (tracker_) {
+      tracker_->site(pc);
+    }
+  }
+
+  // write all values reachable from 'roots' as a relocatable heap image
+  bool snapshot_save(FILE *fd, value_t *const *roots, size_t count) const;
+
+  // load a heap image written by snapshot_save(), setting 'roots' to point
+  // at the restored values
+  bool snapshot_load(const uint8_t *data, size_t size,
+                     value_t **roots, size_t count);
+
   void reset() {
     space_from().clear();
     space_to().clear();
     forward_.clear();
+    scratch_.clear();
     flipflop_ = 0;
+    release_buffers_(true);
+    finalise_users_(true);
+    if (tracker_) {
+      tracker_->heap_reset();
+    }
+    bytes_allocated_.set(0);
   }
 
 protected:
 
+  // allocate a value with 'extra' bytes of payload in the to space
+  value_t *alloc_(value_type_t type, size_t extra) {
+    value_t *v = space_to().alloc<value_t>(extra);
+    assert(v);
+    bytes_allocated_.add(sizeof(value_t) + extra);
+    if (tracker_) {
+      tracker_->on_alloc(v, type, sizeof(value_t) + extra);
+    }
+    return v;
+  }
+
+  // note a value moved by the collector
+  void moved_(const value_t *from, const value_t *to) {
+    if (tracker_) {
+      tracker_->on_move(from, to);
+    }
+  }
+
+  // allocation tracker, if enabled
+  std::unique_ptr<alloc_tracker_t> tracker_;
+
+  counter_t bytes_allocated_;
+
   arena_t &space_from() {
     return space_[flipflop_ & 1];
   }
@@ -144,8 +330,56 @@ protected:
   // up when we need.
   std::unordered_map<const value_t *, value_t *> forward_;
 
+  // true if a value lives in known scratch memory
+  bool scratch_owns_(const value_t *v) const {
+    for (const scratch_t *s : scratch_) {
+      if (s->owns(v)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // scratch memory of the current collection
+  std::vector<const scratch_t *> scratch_;
+
   uint32_t flipflop_;
   std::array<arena_t, 2> space_;
+
+  // release buffers not reached during the last trace, or all of them
+  void release_buffers_(bool all);
+
+  // live host buffers
+  std::vector<std::unique_ptr<buffer_t>> buffers_;
+  uint32_t epoch_;
+
+  // trace a map value, moving it and its table if needed
+  void trace_map_(value_t *&v);
+
+  // find the slot for a key, or the slot it should be inserted into
+  static map_slot_t *map_find_(map_t::table_t *table, const value_t *key,
+                               uint32_t hash);
+
+  // allocate a new table and move all full slots into it, returning false if
+  // there is no room for it
+  bool map_resize_(map_t *map, int32_t capacity);
+
+  // trace a user type value, moving it if needed
+  void trace_user_(value_t *&v);
+
+  // finalise user values not reached during the last trace, or all of them
+  void finalise_users_(bool all);
+
+  // collection in which a user value was last reached
+  static uint32_t &user_mark_(value_t *v) {
+    return *(uint32_t*)(v + 1);
+  }
+
+  // registered user types indexed by type id
+  std::vector<const user_type_t*> user_types_;
+
+  // user values which have a finaliser
+  std::vector<value_t*> finalise_;
 };
 
 } // namespce nano
@@ -0,0 +1,213 @@
+#include <string.h>
+
+#include "vm_gc.h"
+
+
+namespace {
+
+using namespace nano;
+
+uint32_t key_hash(const value_t *key) {
+  if (key->type() == val_type_int) {
+    const uint32_t x = uint32_t(key->v) * 2654435761u;
+    return x ^ (x >> 16);
+  }
+  // fnv-1a
+  uint32_t h = 2166136261u;
+  const char *s = key->string();
+  for (int32_t i = 0; i < key->strlen(); ++i) {
+    h = (h ^ uint8_t(s[i])) * 16777619u;
+  }
+  return h;
+}
+
+bool key_equals(const value_t *a, const value_t *b) {
+  if (a->type() != b->type()) {
+    return false;
+  }
+  if (a->type() == val_type_int) {
+    return a->v == b->v;
+  }
+  return a->strlen() == b->strlen() &&
+         memcmp(a->string(), b->string(), a->strlen()) == 0;
+}
+
+size_t table_size(int32_t capacity) {
+  return sizeof(map_t::table_t) + capacity * sizeof(map_slot_t);
+}
+
+// initial capacity of a new map
+const int32_t min_capacity = 8;
+
+} // namespace {}
+
+namespace nano {
+
+value_t *value_gc_t::new_map() {
+  value_t *v = alloc_(val_type_map, sizeof(map_t));
+  v->type_ = val_type_map;
+  v->v = 0;
+  map_t *m = v->map();
+  m->table = nullptr;
+  m->count = 0;
+  // must be reached by the next trace to be traced
+  m->mark = epoch_ - 1;
+  const bool ok = map_resize_(m, min_capacity);
+  assert(ok);
+  (void)ok;
+  return v;
+}
+
+map_slot_t *value_gc_t::map_find_(map_t::table_t *table, const value_t *key,
+                                  uint32_t hash) {
+  map_slot_t *slots = table->slots();
+  const uint32_t mask = uint32_t(table->capacity - 1);
+  map_slot_t *tomb = nullptr;
+  // note: there is always at least one empty slot so this terminates
+  for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+    map_slot_t &s = slots[i];
+    switch (s.state) {
+    case map_slot_t::empty:
+      return tomb ? tomb : &s;
+    case map_slot_t::deleted:
+      tomb = tomb ? tomb : &s;
+      break;
+    case map_slot_t::full:
+      if (s.hash == hash && key_equals(s.key, key)) {
+        return &s;
+      }
+      break;
+    }
+  }
+}
+
+bool value_gc_t::map_resize_(map_t *map, int32_t capacity) {
+  assert((capacity & (capacity - 1)) == 0);
+  const size_t size = table_size(capacity);
+  // a table must be moved by later collections along with everything else
+  // which is live, so one may only take a quarter of a half space
+  if (size > space_to().capacity() / 4) {
+    return false;
+  }
+  map_t::table_t *table = (map_t::table_t *)space_to().alloc_bytes(size);
+  if (!table) {
+    // the old table is left as it was
+    return false;
+  }
+  memset(table, 0, size);
+  bytes_allocated_.add(size);
+  if (tracker_) {
+    tracker_->on_grow(val_type_map, size);
+  }
+  table->capacity = capacity;
+  table->used = 0;
+  if (map_t::table_t *old = map->table) {
+    for (int32_t i = 0; i < old->capacity; ++i) {
+      const map_slot_t &s = old->slots()[i];
+      if (s.state == map_slot_t::full) {
+        *map_find_(table, s.key, s.hash) = s;
+        ++table->used;
+      }
+    }
+  }
+  map->table = table;
+  return true;
+}
+
+value_t *value_gc_t::map_get(const value_t *map, const value_t *key,
+                             bool &found) const {
+  assert(map_key_valid(key));
+  const map_slot_t *s = map_find_(map->map()->table, key, key_hash(key));
+  found = s->state == map_slot_t::full;
+  return found ? s->value : nullptr;
+}
+
+bool value_gc_t::map_set(value_t *map, const value_t *key, value_t *value) {
+  assert(map_key_valid(key));
+  map_t *m = map->map();
+  const uint32_t hash = key_hash(key);
+  map_slot_t *s = map_find_(m->table, key, hash);
+  if (s->state == map_slot_t::full) {
+    s->value = value;
+    return true;
+  }
+  // keep the load factor under 3/4 counting deleted slots
+  if ((m->table->used + 1) * 4 > m->table->capacity * 3) {
+    int32_t capacity = min_capacity;
+    while (capacity < (m->count + 1) * 2) {
+      capacity *= 2;
+    }
+    if (!map_resize_(m, capacity)) {
+      return false;
+    }
+    s = map_find_(m->table, key, hash);
+  }
+  if (s->state == map_slot_t::empty) {
+    ++m->table->used;
+  }
+  s->key = copy(*key);
+  s->value = value;
+  s->hash = hash;
+  s->state = map_slot_t::full;
+  ++m->count;
+  return true;
+}
+
+bool value_gc_t::map_remove(value_t *map, const value_t *key) {
+  assert(map_key_valid(key));
+  map_t *m = map->map();
+  map_slot_t *s = map_find_(m->table, key, key_hash(key));
+  if (s->state != map_slot_t::full) {
+    return false;
+  }
+  s->key = nullptr;
+  s->value = nullptr;
+  s->state = map_slot_t::deleted;
+  --m->count;
+  return true;
+}
+
+void value_gc_t::trace_map_(value_t *&v) {
+  if (space_to().owns(v)) {
+    // not moving, but still trace its contents once per collection
+    if (v->map()->mark == epoch_) {
+      return;
+    }
+  }
+  else {
+    assert(space_from().owns(v));
+    if (value_t *x = forward_find(v)) {
+      v = x;
+      return;
+    }
+    // move first so that cycles back to this map find the forward
+    const size_t size = sizeof(value_t) + sizeof(map_t);
+    value_t *n = space_to().alloc<value_t>(sizeof(map_t));
+    assert(n);
+    memcpy(n, v, size);
+    forward_add(v, n);
+    moved_(v, n);
+    v = n;
+  }
+  map_t *m = v->map();
+  m->mark = epoch_;
+  // move the table
+  map_t::table_t *table = m->table;
+  if (!space_to().owns((const value_t *)table)) {
+    const size_t size = table_size(table->capacity);
+    map_t::table_t *n = (map_t::table_t *)space_to().alloc_bytes(size);
+    assert(n);
+    memcpy(n, table, size);
+    m->table = table = n;
+  }
+  // trace the keys and values
+  for (int32_t i = 0; i < table->capacity; ++i) {
+    map_slot_t &s = table->slots()[i];
+    if (s.state == map_slot_t::full) {
+      trace(&s.key, 1);
+      trace(&s.value, 1);
+    }
+  }
+}
+
+} // namespace nano
@@ -0,0 +1,153 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+
+
+namespace nano {
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+//
+// a statistic written only by the vm's OS thread and readable from any
+// other.  updates are plain relaxed loads and stores so cost the same as a
+// normal integer.
+//
+struct counter_t {
+
+  counter_t()
+    : v_(0)
+  {}
+
+  void add(uint64_t n) {
+    v_.store(v_.load(std::memory_order_relaxed) + n,
+             std::memory_order_relaxed);
+  }
+
+  void set(uint64_t n) {
+    v_.store(n, std::memory_order_relaxed);
+  }
+
+  void max(uint64_t n) {
+    if (n > get()) {
+      set(n);
+    }
+  }
+
+  uint64_t get() const {
+    return v_.load(std::memory_order_relaxed);
+  }
+
+protected:
+  std::atomic<uint64_t> v_;
+};
+
+// the heap in use after the last collection and the allocation total then,
+// so the heap in use can be found without reading the arenas.  both are
+// written under a sequence count so a reader on another OS thread always
+// sees a pair from the same collection.
+//
+struct heap_mark_t {
+
+  heap_mark_t()
+    : seq_(0)
+    , used_(0)
+    , allocated_(0)
+  {}
+
+  void set(uint64_t used, uint64_t allocated) {
+    // the count is odd while the pair is being written
+    const uint64_t seq = seq_.load(std::memory_order_relaxed);
+    seq_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    used_.store(used, std::memory_order_relaxed);
+    allocated_.store(allocated, std::memory_order_relaxed);
+    seq_.store(seq + 2, std::memory_order_release);
+  }
+
+  void get(uint64_t &used, uint64_t &allocated) const {
+    for (;;) {
+      const uint64_t seq = seq_.load(std::memory_order_acquire);
+      used = used_.load(std::memory_order_relaxed);
+      allocated = allocated_.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if ((seq & 1) == 0 && seq == seq_.load(std::memory_order_relaxed)) {
+        return;
+      }
+    }
+  }
+
+protected:
+  std::atomic<uint64_t> seq_;
+  std::atomic<uint64_t> used_;
+  std::atomic<uint64_t> allocated_;
+};
+
+// a snapshot of the vm statistics, see vm_t::stats()
+//
+// each field is read atomically but the snapshot as a whole is not, so
+// related fields may be a few updates apart.
+struct vm_stats_t {
+
+  // instructions executed by all threads
+  uint64_t instructions;
+
+  uint64_t threads_created;
+  uint64_t threads_finished;
+  // threads which finished with an error, also counted as finished
+  uint64_t threads_errored;
+
+  uint64_t collections;
+  // total and longest time spent tracing and collecting
+  uint64_t gc_time_ns;
+  uint64_t gc_pause_max_ns;
+
+  // bytes allocated on the heap, and moved by the collector
+  uint64_t bytes_allocated;
+  uint64_t bytes_copied;
+
+  uint64_t syscalls;
+  // total time spent in syscalls, only measured while tracing or profiling
+  uint64_t syscall_time_ns;
+
+  // gauges
+
+  // bytes currently allocated on the heap
+  uint64_t heap_used;
+  // most heap bytes in use when a collection started
+  uint64_t heap_peak;
+
+  // threads held by the scheduler and how many of those are waiting
+  uint64_t threads_live;
+  uint64_t threads_waiting;
+};
+
+// the live counters behind vm_stats_t
+struct vm_counters_t {
+  counter_t instructions;
+  counter_t threads_created;
+  counter_t threads_finished;
+  counter_t threads_errored;
+  counter_t collections;
+  counter_t gc_time_ns;
+  counter_t gc_pause_max_ns;
+  counter_t bytes_copied;
+  counter_t syscalls;
+  counter_t syscall_time_ns;
+  counter_t heap_peak;
+  heap_mark_t heap_mark;
+  counter_t threads_live;
+  counter_t threads_waiting;
+
+  void reset() {
+    for (counter_t *c : {&instructions, &threads_created, &threads_finished,
+                         &threads_errored, &collections, &gc_time_ns,
+                         &gc_pause_max_ns, &bytes_copied, &syscalls,
+                         &syscall_time_ns, &heap_peak, &threads_live,
+                         &threads_waiting}) {
+      c->set(0);
+    }
+    heap_mark.set(0, 0);
+  }
+};
+
+} // namespace nano
@@ -0,0 +1,66 @@
+#! /usr/bin/python
+
+# run a program with 'nano_driver -m' and check the allocation report
+# attributes the most bytes to the allocating line.
+
+from __future__ import print_function
+import os
+from common import DRIVER, run, check_main
+
+
+ALLOC = '''
+var keep = new_array(100)
+
+function junk(n)
+  var s = ""
+  var i = 0
+  for (i = 0 to n)
+    s = "abcdefgh" + i
+  end
+  return s
+end
+
+function main()
+  var j = 0
+  for (j = 0 to 100)
+    keep[j] = new_float32_array(256)
+  end
+  for (j = 0 to 20)
+    junk(1000)
+  end
+  return 0
+end
+'''
+
+
+def check_alloc(temp):
+    src = os.path.join(temp, 'alloc.ccml')
+    out = os.path.join(temp, 'alloc.txt')
+    with open(src, 'w') as fd:
+        fd.write(ALLOC)
+    res = run([DRIVER, '-m', out, src])
+    if res[0] != 0:
+        print('failed to run!')
+        print(res[1], res[2])
+        return False
+    with open(out) as fd:
+        report = fd.read()
+    allocs, census = report.split('heap census')
+    # the rows by line come after the rows by type
+    top_alloc = allocs.split('line\n')[1].splitlines()[0].split()
+    live = [l.split() for l in census.split('line\n')[1].splitlines()]
+    if top_alloc[2] != 'string' or not top_alloc[3].endswith('alloc.ccml:8'):
+        print('expected the string concat to allocate the most')
+        print(report)
+        return False
+    # every kept array should still be live
+    if not any(l[1:3] == ['100', 'float32_array'] and
+               l[3].endswith('alloc.ccml:16') for l in live if len(l) == 4):
+        print('expected the kept arrays in the census')
+        print(report)
+        return False
+    return True
+
+
+if __name__ == '__main__':
+    check_main(check_alloc)
@@ -0,0 +1,92 @@
+#! /usr/bin/python
+
+# compile each xpass and regression test to C++ with 'nano_comp -c', build it
+# into the console driver and check the output and any runtime error lines
+# match the interpreter.
+
+from __future__ import print_function
+import os
+import re
+import shutil
+from common import DRIVER, COMP, LIBS, SOURCE, CXX, run, show_diff, in_temp
+from common import programs, report, tried, passed
+
+
+CXXFLAGS = ['-std=c++14', '-O1', '-DNANO_AOT',
+            '-I' + SOURCE, '-I' + os.path.join(SOURCE, 'lib_common')]
+LDFLAGS = ['-L' + LIBS, '-lnano_lib_builtin', '-lnano_lib_compiler',
+           '-lnano_lib_vm', '-lnano_lib_common']
+
+
+# runtime errors as the driver reports them on stderr
+ERROR_LINE = re.compile(r'^file \d+, line:\d+ - .*$', re.MULTILINE)
+
+
+def errors(res):
+    return ERROR_LINE.findall(res[2])
+
+
+def build_driver(temp):
+    objs = []
+    for name in ['driver', 'console']:
+        obj = os.path.join(temp, name + '.o')
+        ret, out, err = run([CXX] + CXXFLAGS +
+                            ['-c', os.path.join(SOURCE, 'driver', name + '.cpp'),
+                             '-o', obj])
+        if ret != 0:
+            print(err)
+            return None
+        objs.append(obj)
+    return objs
+
+
+def do_aot(temp, driver_obj, path):
+    print('{0}'.format(path))
+    tried.add(path)
+    base = os.path.basename(path)
+    src = os.path.join(temp, base)
+    shutil.copy(path, src)
+
+    expect = run([DRIVER, src])
+
+    # generate C++ for this program
+    ret, out, err = run([COMP, src, '-c'])
+    if ret != 0:
+        # programs that fail to compile have nothing to compare
+        if expect[0] != 0:
+            passed.add(path)
+        else:
+            print('{0} unable to compile!'.format(base))
+        return
+
+    exe = os.path.join(temp, 'driver_aot')
+    ret, out, err = run([CXX] + CXXFLAGS +
+                        driver_obj + [src + '.cpp', '-o', exe] + LDFLAGS)
+    if ret != 0:
+        print('{0} generated code failed to build!'.format(base))
+        print(err)
+        return
+
+    got = run([exe, src])
+    if got[0] != expect[0] or got[1] != expect[1]:
+        print('{0} differs from the interpreter!'.format(base))
+        show_diff(got, expect)
+    elif errors(got) != errors(expect):
+        print('{0} reports errors on other lines!'.format(base))
+        print('got {0}\nexp {1}'.format(errors(got), errors(expect)))
+    else:
+        passed.add(path)
+
+
+def main(temp):
+    driver_obj = build_driver(temp)
+    if not driver_obj:
+        print('unable to build driver')
+        exit(1)
+    for path in programs(['./xpass', './regression']):
+        do_aot(temp, driver_obj, path)
+
+
+if __name__ == '__main__':
+    in_temp(main)
+    report()
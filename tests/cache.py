@@ -0,0 +1,93 @@
+#! /usr/bin/python
+
+# build a program importing another with 'nano_driver -c' and check that a
+# second run loads the cache entry, that editing the imported file misses
+# and that an entry written by another cache version is rebuilt.
+
+from __future__ import print_function
+import os
+import struct
+from common import DRIVER, run, check_main
+
+
+MAIN = '''
+import "lib.ccml"
+function main()
+  return twice(21)
+end
+'''
+
+LIB = '''
+function twice(x)
+  return x * {0}
+end
+'''
+
+
+def entries(cache):
+    return sorted(f for f in os.listdir(cache) if f.endswith('.nbc'))
+
+
+def inode(cache, name):
+    # entries are renamed into place so a rewrite gives a new file
+    return os.stat(os.path.join(cache, name)).st_ino
+
+
+def check(temp):
+    cache = os.path.join(temp, 'cache')
+    os.mkdir(cache)
+    src = os.path.join(temp, 'main.ccml')
+    lib = os.path.join(temp, 'lib.ccml')
+    with open(src, 'w') as fd:
+        fd.write(MAIN)
+    with open(lib, 'w') as fd:
+        fd.write(LIB.format(2))
+
+    # miss, writing an entry
+    res = run([DRIVER, '-c', cache, src])
+    if res[1] != 'exit: 42\n' or len(entries(cache)) != 1:
+        print('expected one entry after the first run!')
+        print(res[1], res[2])
+        return False
+    name = entries(cache)[0]
+    ino = inode(cache, name)
+
+    # hit, leaving the entry alone
+    res = run([DRIVER, '-c', cache, src])
+    if res[1] != 'exit: 42\n' or inode(cache, name) != ino:
+        print('expected a cache hit!')
+        print(res[1], res[2])
+        return False
+
+    # editing an import keeps the key but must rebuild the entry
+    with open(lib, 'w') as fd:
+        fd.write(LIB.format(3))
+    res = run([DRIVER, '-c', cache, src])
+    if res[1] != 'exit: 63\n' or inode(cache, name) == ino:
+        print('expected a miss after the import changed!')
+        print(res[1], res[2])
+        return False
+
+    # an entry from another cache version is rejected and rewritten
+    path = os.path.join(cache, name)
+    with open(path, 'r+b') as fd:
+        fd.seek(4)
+        version = struct.unpack('<i', fd.read(4))[0]
+        fd.seek(4)
+        fd.write(struct.pack('<i', version + 1))
+    ino = inode(cache, name)
+    res = run([DRIVER, '-c', cache, src])
+    if res[1] != 'exit: 63\n' or inode(cache, name) == ino:
+        print('expected an entry of another version to be rebuilt!')
+        print(res[1], res[2])
+        return False
+    with open(path, 'rb') as fd:
+        fd.seek(4)
+        if struct.unpack('<i', fd.read(4))[0] != version:
+            print('expected the entry to be rewritten at the current version')
+            return False
+    return True
+
+
+if __name__ == '__main__':
+    check_main(check)
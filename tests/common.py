@@ -0,0 +1,88 @@
+# helpers shared by the test scripts.  each script is run from this
+# directory against the programs in ../build.
+
+from __future__ import print_function
+import os
+import shutil
+import subprocess
+import tempfile
+import time
+
+
+DRIVER = '../build/nano_driver'
+COMP = '../build/nano_comp'
+LIBS = '../build'
+SOURCE = '../source'
+CXX = os.environ.get('CXX', 'g++')
+
+
+# names of the tests tried and passed by scripts which run many
+tried = set()
+passed = set()
+
+
+def run(args, stdin=None, env=None):
+    proc = subprocess.Popen(
+        args,
+        stdin=subprocess.PIPE,
+        stdout=subprocess.PIPE,
+        stderr=subprocess.PIPE,
+        universal_newlines=True,
+        env=env)
+    out, err = proc.communicate(stdin)
+    return proc.returncode, out, err
+
+
+def write(path, text):
+    with open(path, 'w') as fd:
+        fd.write(text)
+    return path
+
+
+def timed(args, count, env=None):
+    best = None
+    for i in range(count):
+        start = time.time()
+        run(args, env=env)
+        took = time.time() - start
+        best = took if best is None else min(best, took)
+    return best
+
+
+def programs(dirs):
+    for d in dirs:
+        for f in sorted(os.listdir(d)):
+            root, ext = os.path.splitext(f)
+            if ext == '.ccml':
+                yield os.path.join(d, f)
+
+
+def show_diff(got, expect):
+    print('got ----\n{0}\n({1})\n--------'.format(got[1].strip(), got[0]))
+    print('exp ----\n{0}\n({1})\n--------'.format(expect[1].strip(),
+                                                  expect[0]))
+
+
+def in_temp(func):
+    temp = tempfile.mkdtemp()
+    try:
+        return func(temp)
+    finally:
+        shutil.rmtree(temp)
+
+
+def check_main(*checks):
+    # run each check in a fresh directory, stopping at the first to fail
+    ok = all(in_temp(check) for check in checks)
+    print('passed' if ok else 'failed')
+    exit(0 if ok else 1)
+
+
+def report():
+    print('{0} of {1} passed'.format(len(passed), len(tried)))
+    if len(passed) != len(tried):
+        print('failed:')
+        for x in sorted(tried - passed):
+            print('   {0}'.format(x))
+        exit(1)
+    exit(0)
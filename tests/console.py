@@ -0,0 +1,62 @@
+#! /usr/bin/python
+
+# check 'gets' reads a line longer than any buffer and 'read' the bytes
+# after it, and that input too long for the heap raises an error.
+
+from __future__ import print_function
+import os
+from common import DRIVER, run, write, check_main
+
+
+# exit code of the driver when a program raises an error
+RUNTIME_ERROR = 250
+
+
+CONSOLE = '''
+function main()
+  var a = gets()
+  var b = read(3)
+  var c = read(100)
+  puts(b + "|" + c + "|")
+  return len(a)
+end
+'''
+
+
+READ = '''
+function main()
+  var a = read(3000000)
+  return len(a)
+end
+'''
+
+
+def check_console(temp):
+    src = write(os.path.join(temp, 'console.ccml'), CONSOLE)
+    res = run([DRIVER, src], 'x' * 5000 + '\nabcdef')
+    if res[0] != 0 or res[1] != 'abc|def|\nexit: 5000\n':
+        print('unexpected console input!')
+        print(res[1], res[2])
+        return False
+    return True
+
+
+def check_too_long(temp):
+    # a half space is 1mb so neither of these fit in a string
+    src = write(os.path.join(temp, 'gets.ccml'), CONSOLE)
+    res = run([DRIVER, src], 'x' * 3000000 + '\nabcdef')
+    if res[0] != RUNTIME_ERROR:
+        print('expected an error for a line longer than the heap!')
+        print(res[0], res[1], res[2])
+        return False
+    src = write(os.path.join(temp, 'read.ccml'), READ)
+    res = run([DRIVER, src], 'x' * 3000000)
+    if res[0] != RUNTIME_ERROR:
+        print('expected an error reading more than the heap holds!')
+        print(res[0], res[1], res[2])
+        return False
+    return True
+
+
+if __name__ == '__main__':
+    check_main(check_console, check_too_long)
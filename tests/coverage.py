@@ -0,0 +1,78 @@
+#! /usr/bin/python
+
+# run a program with 'nano_driver -l' and check the lcov file marks the
+# lines, functions and branch outcomes which did and did not execute.
+
+from __future__ import print_function
+import os
+from common import DRIVER, run, write, check_main
+
+
+COVER = '''
+function never(x)
+  return x * 2
+end
+
+function check(x)
+  if (x > 5)
+    return 1
+  end
+  return 0
+end
+
+function main()
+  var t = 0
+  var i = 0
+  for (i = 0 to 3)
+    t = t + check(i)
+  end
+  return t
+end
+'''
+
+
+def check_coverage(temp):
+    src = write(os.path.join(temp, 'cover.ccml'), COVER)
+    out = os.path.join(temp, 'cover.info')
+    plain = run([DRIVER, src])
+    res = run([DRIVER, '-l', out, src])
+    if res[0] != 0 or res[1] != plain[1]:
+        print('covered output differs!')
+        print(res[1], res[2])
+        return False
+    lines = {}
+    funcs = {}
+    branches = {}
+    with open(out) as fd:
+        for line in fd:
+            key, _, val = line.strip().partition(':')
+            if key == 'DA':
+                no, count = val.split(',')
+                lines[int(no)] = int(count)
+            if key == 'FNDA':
+                count, name = val.split(',')
+                funcs[name] = int(count)
+            if key == 'BRDA':
+                no, block, branch, taken = val.split(',')
+                branches[(int(no), int(branch))] = taken
+    # the source starts with a blank line
+    want = {3: 0, 7: 1, 8: 0, 10: 1, 17: 1, 19: 1}
+    for no, count in want.items():
+        if lines.get(no) != count:
+            print('line {0} expected count {1}'.format(no, count))
+            print(lines)
+            return False
+    if funcs.get('never') != 0 or funcs.get('check') != 1:
+        print('expected check and not never to be covered')
+        print(funcs)
+        return False
+    # 'if (x > 5)' only ever fell through to 'return 0'
+    if branches.get((7, 0)) != '1' or branches.get((7, 1)) != '0':
+        print('expected one outcome of the branch on line 7')
+        print(branches)
+        return False
+    return True
+
+
+if __name__ == '__main__':
+    check_main(check_coverage)
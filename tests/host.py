@@ -0,0 +1,44 @@
+#! /usr/bin/python
+
+# build each host api test in ./host against the libraries and run it.  a
+# test exits with zero when all of its checks pass.
+
+from __future__ import print_function
+import os
+from common import LIBS, SOURCE, CXX, run, in_temp, report, tried, passed
+
+
+CXXFLAGS = ['-std=c++14', '-O1', '-I' + SOURCE,
+            '-I' + os.path.join(SOURCE, 'lib_common'), '-I./host']
+LDFLAGS = ['-L' + LIBS, '-lnano_lib_builtin', '-lnano_lib_compiler',
+           '-lnano_lib_vm', '-lnano_lib_common', '-lpthread']
+
+
+def do_host(temp, path):
+    print('{0}'.format(path))
+    tried.add(path)
+    base = os.path.basename(path)
+    exe = os.path.join(temp, os.path.splitext(base)[0])
+    ret, out, err = run([CXX] + CXXFLAGS + [path, '-o', exe] + LDFLAGS)
+    if ret != 0:
+        print('{0} failed to build!'.format(base))
+        print(err)
+        return
+    ret, out, err = run([exe])
+    if ret == 0:
+        passed.add(path)
+    else:
+        print('{0} failed!'.format(base))
+        print('{0}{1}({2})'.format(out, err, ret))
+
+
+def main(temp):
+    for f in sorted(os.listdir('./host')):
+        root, ext = os.path.splitext(f)
+        if ext == '.cpp':
+            do_host(temp, os.path.join('./host', f))
+
+
+if __name__ == '__main__':
+    in_temp(main)
+    report()
@@ -0,0 +1,115 @@
+// breakpoints halt a thread before a line runs, are stepped over when it
+// resumes and can be removed and added again at any time
+
+#include "host.h"
+
+using namespace nano;
+
+static const char *source = R"(
+function f(x)
+  return x + 1
+end
+function main()
+  var i = 0
+  var a = 0
+  for (i = 0 to 10)
+    a = f(a)
+  end
+  return a
+end
+)";
+
+static const line_t line_f = {0, 3};
+static const line_t line_call = {0, 9};
+
+// resume until the thread halts or finishes, true if it halted
+static bool run(thread_t *t) {
+  t->resume(1 << 30);
+  CHECK(!t->has_error());
+  return !t->finished();
+}
+
+// halt count until the thread finishes
+static int halts(thread_t *t) {
+  int n = 0;
+  while (run(t)) {
+    ++n;
+  }
+  CHECK(t->get_return_value()->v == 10);
+  return n;
+}
+
+int main() {
+  program_t program;
+  CHECK(host::build(program, source));
+  const function_t &entry = *program.function_find("main");
+
+  // add and hit, once per call
+  {
+    vm_t vm(program);
+    vm.breakpoint_add(line_f);
+    thread_t *t = vm.new_thread(entry, 0, nullptr);
+    CHECK(run(t));
+    CHECK(t->get_source_line() == line_f);
+    CHECK(halts(t) == 9);
+  }
+
+  // step off a breakpoint and halt there again on the next call
+  {
+    vm_t vm(program);
+    vm.breakpoint_add(line_f);
+    thread_t *t = vm.new_thread(entry, 0, nullptr);
+    CHECK(run(t));
+    const int32_t pc = t->get_pc();
+    CHECK(t->step_inst());
+    CHECK(t->get_pc() != pc);
+    CHECK(t->step_line());
+    CHECK(!(t->get_source_line() == line_f));
+    CHECK(run(t));
+    CHECK(t->get_source_line() == line_f);
+    CHECK(halts(t) == 8);
+  }
+
+  // remove then add again while halted stops again before moving on
+  {
+    vm_t vm(program);
+    vm.breakpoint_add(line_f);
+    thread_t *t = vm.new_thread(entry, 0, nullptr);
+    CHECK(run(t));
+    const int32_t pc = t->get_pc();
+    vm.breakpoint_remove(line_f);
+    vm.breakpoint_add(line_f);
+    CHECK(run(t));
+    CHECK(t->get_pc() == pc);
+    CHECK(halts(t) == 9);
+  }
+
+  // a line stepped over while no breakpoint was set halts when it is added
+  {
+    vm_t vm(program);
+    vm.breakpoint_add(line_call);
+    thread_t *t = vm.new_thread(entry, 0, nullptr);
+    CHECK(run(t));
+    vm.breakpoint_clear();
+    CHECK(vm.breakpoints().empty());
+    CHECK(t->step_inst());
+    // back around the loop and onto the same line
+    while (!(t->get_source_line() == line_call)) {
+      CHECK(t->step_inst());
+    }
+    vm.breakpoint_add(line_call);
+    CHECK(halts(t) == 9);
+  }
+
+  // cleared breakpoints no longer halt
+  {
+    vm_t vm(program);
+    vm.breakpoint_add(line_f);
+    vm.breakpoint_add(line_call);
+    thread_t *t = vm.new_thread(entry, 0, nullptr);
+    CHECK(run(t));
+    vm.breakpoint_clear();
+    CHECK(halts(t) == 0);
+  }
+  return 0;
+}
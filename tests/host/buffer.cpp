@@ -0,0 +1,128 @@
+// buffers let scripts read and write host memory which the collector never
+// moves, releasing it once no buffer value refers to it
+
+#include <vector>
+
+#include "host.h"
+#include "lib_vm/handle.h"
+
+using namespace nano;
+
+static const char *source = R"(
+function sum()
+  var b = get_buf(1)
+  var i = 0
+  var s = 0
+  for (i = 0 to len(b))
+    s += b[i]
+  end
+  b[0] = 66
+  b[1] = 67
+  var x = new_array(2)
+  x[0] = b
+  var y = 0
+  for (i = 0 to 100000)
+    y = new_array(4)
+  end
+  return s + x[0][1] + b.length
+end
+function text()
+  var b = get_buf(0)
+  return "<" + b + ">"
+end
+function write_ro()
+  var b = get_buf(0)
+  b[0] = 1
+  return 0
+end
+function bounds()
+  var b = get_buf(1)
+  return b[len(b)]
+end
+function keep()
+  return hold(get_buf(1))
+end
+function junk()
+  var i = 0
+  var x = 0
+  for (i = 0 to 100000)
+    x = new_array(4)
+  end
+  return 0
+end
+)";
+
+static std::vector<uint8_t> memory(64 * 1024, 'a');
+static int released = 0;
+
+static void on_release(void *user, uint8_t *data, int32_t size) {
+  CHECK(user == &memory && data == memory.data());
+  CHECK(size == int32_t(memory.size()));
+  ++released;
+}
+
+static void vm_get_buf(thread_t &t, int32_t) {
+  const bool writable = t.get_stack().pop()->v != 0;
+  t.get_stack().push_buffer(memory.data(), int32_t(memory.size()), writable,
+                            on_release, &memory);
+}
+
+static handle_t held;
+
+static void vm_hold(thread_t &t, int32_t) {
+  held = handle_t(t.vm(), t.get_stack().pop());
+  t.get_stack().push_int(0);
+}
+
+int main() {
+  program_t program;
+  CHECK(host::build(program, source, [](nano_t &nano) {
+    nano.syscall_register("get_buf", 1);
+    nano.syscall_register("hold", 1);
+  }));
+  program.syscall_resolve("get_buf", vm_get_buf);
+  program.syscall_resolve("hold", vm_hold);
+  vm_t vm(program);
+
+  // read every byte, write two and survive collections while in use
+  const value_t *v = host::call(vm, "sum");
+  CHECK(v && v->type() == val_type_int);
+  CHECK(v->v == 'a' * int32_t(memory.size()) + 'C' + int32_t(memory.size()));
+  CHECK(memory[0] == 'B' && memory[1] == 'C' && memory[2] == 'a');
+  CHECK(released == 0);
+
+  // no longer referenced so the next collection releases it
+  CHECK(host::call(vm, "junk"));
+  CHECK(released == 1);
+
+  memory.assign(memory.size(), 0);
+  memcpy(memory.data(), "hi", 2);
+  v = host::call(vm, "text");
+  CHECK(v && v->type() == val_type_string);
+  CHECK(strcmp(v->string(), "<hi>") == 0);
+
+  // read only buffers and bounds are enforced
+  CHECK(!host::call(vm, "write_ro"));
+  CHECK(memory[0] == 'h');
+  CHECK(!host::call(vm, "bounds"));
+
+  // a handle keeps a buffer alive until it is released
+  CHECK(host::call(vm, "keep"));
+  CHECK(host::call(vm, "junk"));
+  const int before = released;
+  CHECK(host::call(vm, "junk"));
+  CHECK(released == before);
+  CHECK(held.get()->type() == val_type_buffer);
+  CHECK(held.get()->buffer()->data == memory.data());
+  held.reset();
+  CHECK(host::call(vm, "junk"));
+  CHECK(released == before + 1);
+
+  // everything left is released with the vm
+  vm.reset();
+  CHECK(host::call(vm, "text"));
+  const int after = released;
+  vm.reset();
+  CHECK(released == after + 1);
+  return 0;
+}
@@ -0,0 +1,85 @@
+// handles keep host held values alive and up to date across collections
+
+#include "host.h"
+#include "lib_vm/handle.h"
+
+using namespace nano;
+
+static const char *source = R"(
+function make()
+  var a = new_array(3)
+  a[0] = 1
+  a[1] = "hi"
+  a[2] = 3.5
+  return a
+end
+function big()
+  hold(new_array(20000))
+  return 0
+end
+function nop()
+  return 0
+end
+function junk()
+  var i = 0
+  var x = 0
+  for (i = 0 to 100000)
+    x = new_array(4)
+  end
+  return 0
+end
+)";
+
+// a value the host has been given by a script
+static handle_t held;
+
+static void vm_hold(thread_t &t, int32_t) {
+  held = handle_t(t.vm(), t.get_stack().pop());
+  t.get_stack().push_int(0);
+}
+
+int main() {
+  program_t program;
+  CHECK(host::build(program, source, [](nano_t &nano) {
+    nano.syscall_register("hold", 1);
+  }));
+  program.syscall_resolve("hold", vm_hold);
+  vm_t vm(program);
+
+  handle_t h(vm, host::call(vm, "make"));
+  handle_t copy = h;
+  handle_scope_t scope(vm);
+  handle_scope_t::local_t local = scope.add(h.get());
+  const value_t *before = h.get();
+
+  // allocate enough to force several collections
+  for (int i = 0; i < 3; ++i) {
+    CHECK(host::call(vm, "junk"));
+  }
+  const value_t *a = h.get();
+  CHECK(a != before);
+  CHECK(copy.get() == a);
+  CHECK(local.get() == a);
+  CHECK(a->type() == val_type_array);
+  CHECK(a->array()[0]->v == 1);
+  CHECK(strcmp(a->array()[1]->string(), "hi") == 0);
+  CHECK(a->array()[2]->f == 3.5f);
+
+  // a released handle no longer keeps its value alive.  each call collects
+  // before it runs.
+  CHECK(host::call(vm, "big"));
+  CHECK(host::call(vm, "nop"));
+  CHECK(held.get()->array_size() == 20000);
+  const uint64_t with = vm.stats().heap_used;
+  held.reset();
+  CHECK(!held.valid() && held.get() == nullptr);
+  CHECK(host::call(vm, "nop"));
+  CHECK(vm.stats().heap_used + 20000 * sizeof(value_t *) <= with);
+  CHECK(h.get()->array()[0]->v == 1);
+
+  // released slots are reused
+  copy.reset();
+  handle_t again(vm, h.get());
+  CHECK(again.get() == h.get());
+  return 0;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+#include "nanoscript.h"
+
+
+// fail the test if a condition does not hold
+#define CHECK(X)                                                     \
+  {                                                                  \
+    if (!(X)) {                                                      \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__,         \
+              __LINE__, #X);                                         \
+      exit(1);                                                       \
+    }                                                                \
+  }
+
+namespace host {
+
+// build a program from source, letting 'setup' register extra syscalls
+inline bool build(nano::program_t &program, const char *source,
+                  const std::function<void(nano::nano_t &)> &setup = {}) {
+  nano::nano_t nano(program);
+  builtins_register(nano);
+  if (setup) {
+    setup(nano);
+  }
+  nano::source_manager_t sources;
+  sources.load_from_string(source);
+  nano::error_t error;
+  if (!nano.build(sources, error)) {
+    fprintf(stderr, "%s\n", error.error.c_str());
+    return false;
+  }
+  builtins_resolve(program);
+  return true;
+}
+
+// call a function by name returning its result, or nullptr on error
+inline nano::value_t *call(nano::vm_t &vm, const char *name) {
+  const nano::function_t *func = vm.program().function_find(name);
+  CHECK(func);
+  nano::value_t *out = nullptr;
+  nano::thread_error_t error;
+  if (!vm.call_once(*func, 0, nullptr, out, error)) {
+    return nullptr;
+  }
+  return out;
+}
+
+} // namespace host
@@ -0,0 +1,43 @@
+// a map which outgrows the heap raises a thread error rather than aborting
+
+#include "host.h"
+
+using namespace nano;
+
+static const char *source = R"(
+function fill(n)
+  var m = new_map()
+  var i = 0
+  for (i = 0 to n)
+    m[i] = i
+  end
+  return len(m)
+end
+function small()
+  return fill(1000)
+end
+function large()
+  return fill(20000)
+end
+)";
+
+int main() {
+  program_t program;
+  CHECK(host::build(program, source));
+  vm_t vm(program);
+
+  const value_t *v = host::call(vm, "small");
+  CHECK(v && v->v == 1000);
+
+  value_t *out = nullptr;
+  thread_error_t error = thread_error_t::e_success;
+  CHECK(!vm.call_once(*program.function_find("large"), 0, nullptr, out,
+                      error));
+  CHECK(error == thread_error_t::e_bad_argument);
+
+  // the vm is still usable afterwards
+  vm.reset();
+  v = host::call(vm, "small");
+  CHECK(v && v->v == 1000);
+  return 0;
+}
@@ -0,0 +1,153 @@
+// user types with member_resolve use their slot hooks through the member
+// inline caches, which refill when a site sees another receiver type
+
+#include "host.h"
+
+using namespace nano;
+
+static const char *source = R"(
+function len_of(o)
+  return o.length
+end
+function get_x(o)
+  return o.x
+end
+function set_x(o, v)
+  o.x = v
+  return 0
+end
+function mixed()
+  var p = point(3)
+  var a = new_array(5)
+  var m = new_map()
+  m["one"] = 1
+  m["two"] = 2
+  var t = 0
+  var i = 0
+  for (i = 0 to 4)
+    t = t + len_of(p) + len_of(a) + len_of(m)
+    set_x(p, get_x(p) + 1)
+  end
+  return t * 100 + get_x(p)
+end
+function bad_get()
+  var p = point(1)
+  get_x(p)
+  return get_x(new_array(2))
+end
+function bad_set()
+  var p = point(1)
+  set_x(p, 2)
+  return set_x(new_array(2), 3)
+end
+function read_only()
+  var p = point(1)
+  p.length = 2
+  return 0
+end
+function unknown()
+  var p = point(1)
+  return p.missing
+end
+)";
+
+struct point_t {
+  int32_t x;
+};
+
+enum {
+  slot_x,
+  slot_length,
+};
+
+static value_type_t point_type;
+static int slot_gets = 0;
+static int slot_sets = 0;
+
+static point_t &point(const value_t *v) {
+  return *(point_t *)v->user_data();
+}
+
+static int32_t point_resolve(const std::string &member) {
+  if (member == "x") {
+    return slot_x;
+  }
+  if (member == "length") {
+    return slot_length;
+  }
+  return -1;
+}
+
+static bool point_get(thread_t &t, value_t *obj, int32_t slot) {
+  ++slot_gets;
+  switch (slot) {
+  case slot_x:
+    t.get_stack().push_int(point(obj).x);
+    return true;
+  case slot_length:
+    t.get_stack().push_int(10);
+    return true;
+  default:
+    return false;
+  }
+}
+
+// only x can be written
+static bool point_set(thread_t &, value_t *obj, value_t *expr, int32_t slot) {
+  ++slot_sets;
+  if (slot != slot_x || !expr || !expr->is_a<val_type_int>()) {
+    return false;
+  }
+  point(obj).x = expr->v;
+  return true;
+}
+
+static void vm_point(thread_t &t, int32_t) {
+  const value_t *x = t.get_stack().pop();
+  point(t.get_stack().push_user(point_type)).x = x->v;
+}
+
+// call a function returning its thread error
+static thread_error_t call_error(vm_t &vm, const char *name) {
+  value_t *out = nullptr;
+  thread_error_t error = thread_error_t::e_success;
+  vm.call_once(*vm.program().function_find(name), 0, nullptr, out, error);
+  return error;
+}
+
+int main() {
+  program_t program;
+  CHECK(host::build(program, source, [](nano_t &nano) {
+    nano.syscall_register("point", 1);
+  }));
+  program.syscall_resolve("point", vm_point);
+
+  user_type_t desc;
+  desc.name = "point";
+  desc.size = sizeof(point_t);
+  desc.member_resolve = point_resolve;
+  desc.member_get = point_get;
+  desc.member_set = point_set;
+
+  vm_t vm(program);
+  point_type = vm.user_type_register(desc);
+
+  // each site alternates between a point, an array and a map
+  const value_t *v = host::call(vm, "mixed");
+  CHECK(v && v->v == 4 * (10 + 5 + 2) * 100 + 7);
+  CHECK(slot_gets == 4 * 2 + 1);
+  CHECK(slot_sets == 4);
+
+  // arrays have no x so the refilled sites fail
+  CHECK(call_error(vm, "bad_get") == thread_error_t::e_bad_member_access);
+  CHECK(call_error(vm, "bad_set") == thread_error_t::e_bad_member_access);
+
+  // a slot the type refuses to write, and a name it does not resolve
+  CHECK(call_error(vm, "read_only") == thread_error_t::e_bad_member_access);
+  CHECK(call_error(vm, "unknown") == thread_error_t::e_bad_member_access);
+
+  // the sites still serve points after the failures
+  v = host::call(vm, "mixed");
+  CHECK(v && v->v == 4 * (10 + 5 + 2) * 100 + 7);
+  return 0;
+}
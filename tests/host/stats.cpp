@@ -0,0 +1,74 @@
+// vm statistics read from another OS thread stay consistent while the vm
+// collects and resets
+
+#include <atomic>
+#include <thread>
+
+#include "host.h"
+
+using namespace nano;
+
+static const char *source = R"(
+function junk()
+  var i = 0
+  var x = 0
+  for (i = 0 to 100000)
+    x = new_array(4)
+  end
+  return 0
+end
+)";
+
+// far more than both half spaces, but far less than a wrapped subtraction
+static const uint64_t heap_limit = 64 * 1024 * 1024;
+
+enum phase_t {
+  e_running,
+  e_resetting,
+  e_done,
+};
+
+int main() {
+  program_t program;
+  CHECK(host::build(program, source));
+  vm_t vm(program);
+
+  std::atomic<int> phase(e_running);
+  std::atomic<bool> ok(true);
+  std::atomic<uint64_t> polls(0);
+
+  std::thread poller([&]() {
+    vm_stats_t last = vm.stats();
+    while (phase.load() != e_done) {
+      const bool running = phase.load() == e_running;
+      const vm_stats_t s = vm.stats();
+      ok = ok && s.heap_used <= heap_limit && s.heap_peak <= heap_limit;
+      ok = ok && s.heap_used <= s.heap_peak;
+      // totals only go backwards when the vm is reset
+      if (running && phase.load() == e_running) {
+        ok = ok && s.bytes_allocated >= last.bytes_allocated;
+        ok = ok && s.collections >= last.collections;
+      }
+      last = s;
+      polls.fetch_add(1);
+    }
+  });
+
+  for (int i = 0; i < 4; ++i) {
+    CHECK(host::call(vm, "junk"));
+  }
+  const vm_stats_t s = vm.stats();
+  CHECK(s.collections > 10);
+
+  phase = e_resetting;
+  for (int i = 0; i < 20; ++i) {
+    vm.reset();
+    CHECK(host::call(vm, "junk"));
+  }
+  phase = e_done;
+  poller.join();
+
+  CHECK(polls.load() > 0);
+  CHECK(ok.load());
+  return 0;
+}
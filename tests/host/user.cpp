@@ -0,0 +1,200 @@
+// registered user types dispatch operators, comparisons and member access
+// to their hooks and are traced and finalised by the collector
+
+#include "host.h"
+
+using namespace nano;
+
+static const char *source = R"(
+function arith()
+  var a = vec(1, 2)
+  var b = vec(3, 4)
+  var t = new_array(1)
+  t[0] = "hello"
+  a.tag = t
+  t = 0
+  var i = 0
+  var c = 0
+  for (i = 0 to 100000)
+    c = a + b
+  end
+  c.x = 10
+  var s = c.tag
+  return c.x + c.y + len(s[0])
+end
+function order()
+  var a = vec(1, 0)
+  var b = vec(2, 0)
+  var out = 0
+  if (a < b)
+    out += 1
+  end
+  if (b > a)
+    out += 2
+  end
+  if (a <= b)
+    out += 4
+  end
+  if (a <= a)
+    out += 8
+  end
+  if (b >= a)
+    out += 16
+  end
+  if (not (a >= b))
+    out += 32
+  end
+  if (not (a > b))
+    out += 64
+  end
+  return out
+end
+function equal()
+  var a = vec(1, 0)
+  var b = vec(1, 0)
+  var out = 0
+  if (a == a)
+    out += 1
+  end
+  if (not (a == b))
+    out += 2
+  end
+  if (not (a == none))
+    out += 4
+  end
+  if (not (none == a))
+    out += 8
+  end
+  return out
+end
+function no_add()
+  var a = vec(1, 0)
+  return a - a
+end
+)";
+
+struct vec2_t {
+  float x, y;
+  value_t *tag;
+};
+
+static value_type_t vec_type;
+static int finalised = 0;
+
+static vec2_t &vec(const value_t *v) {
+  return *(vec2_t *)v->user_data();
+}
+
+static void vec_trace(value_gc_t &gc, value_t *self) {
+  if (vec(self).tag) {
+    gc.trace(&vec(self).tag, 1);
+  }
+}
+
+static void vec_finalise(value_t *) {
+  ++finalised;
+}
+
+static bool vec_add(thread_t &t, const value_t *l, const value_t *r) {
+  if (l->type() != vec_type || r->type() != vec_type) {
+    return false;
+  }
+  const vec2_t a = vec(l), b = vec(r);
+  vec2_t &c = vec(t.get_stack().push_user(vec_type));
+  c.x = a.x + b.x;
+  c.y = a.y + b.y;
+  c.tag = a.tag;
+  return true;
+}
+
+// ordered on x only
+static bool vec_lt(thread_t &t, const value_t *l, const value_t *r) {
+  if (l->type() != vec_type || r->type() != vec_type) {
+    return false;
+  }
+  t.get_stack().push_int(vec(l).x < vec(r).x ? 1 : 0);
+  return true;
+}
+
+static bool vec_get(thread_t &t, value_t *obj, const std::string &m) {
+  if (m == "x") {
+    t.get_stack().push_float(vec(obj).x);
+    return true;
+  }
+  if (m == "y") {
+    t.get_stack().push_float(vec(obj).y);
+    return true;
+  }
+  if (m == "tag") {
+    t.get_stack().push(vec(obj).tag);
+    return true;
+  }
+  return false;
+}
+
+static bool vec_set(thread_t &, value_t *obj, value_t *e,
+                    const std::string &m) {
+  if (m == "x") {
+    vec(obj).x = e->as_float();
+    return true;
+  }
+  if (m == "tag") {
+    vec(obj).tag = e;
+    return true;
+  }
+  return false;
+}
+
+static void vm_vec(thread_t &t, int32_t) {
+  value_t *y = t.get_stack().pop();
+  value_t *x = t.get_stack().pop();
+  vec2_t &v = vec(t.get_stack().push_user(vec_type));
+  v.x = x->as_float();
+  v.y = y->as_float();
+}
+
+int main() {
+  program_t program;
+  CHECK(host::build(program, source, [](nano_t &nano) {
+    nano.syscall_register("vec", 2);
+  }));
+  program.syscall_resolve("vec", vm_vec);
+
+  user_type_t desc;
+  desc.name = "vec2";
+  desc.size = sizeof(vec2_t);
+  desc.trace = vec_trace;
+  desc.finalise = vec_finalise;
+  desc.on_add = vec_add;
+  desc.on_lt = vec_lt;
+  desc.on_member_get = vec_get;
+  desc.on_member_set = vec_set;
+  {
+    vm_t vm(program);
+    vec_type = vm.user_type_register(desc);
+
+    // the tag array is only reachable through the host data
+    const value_t *v = host::call(vm, "arith");
+    CHECK(v && v->as_float() == 10.f + 6.f + 5.f);
+    CHECK(finalised > 0);
+
+    v = host::call(vm, "order");
+    CHECK(v && v->v == 127);
+
+    // without on_equals a value only equals itself
+    v = host::call(vm, "equal");
+    CHECK(v && v->v == 15);
+
+    // an operator without a hook is an error
+    CHECK(!host::call(vm, "no_add"));
+  }
+  // everything left is finalised with the vm
+  const int before = finalised;
+  {
+    vm_t vm(program);
+    vec_type = vm.user_type_register(desc);
+    CHECK(host::call(vm, "equal"));
+  }
+  CHECK(finalised == before + 2);
+  return 0;
+}
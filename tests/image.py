@@ -0,0 +1,42 @@
+#! /usr/bin/python
+
+# write each test program out as an image with 'nano_driver -o', run it again
+# from the image with 'nano_driver -i' and check the output matches.
+
+from __future__ import print_function
+import os
+from common import DRIVER, run, programs, show_diff, in_temp, report
+from common import tried, passed
+
+
+def do_image(temp, path):
+    print('{0}'.format(path))
+    tried.add(path)
+    base = os.path.basename(path)
+    image = os.path.join(temp, base + '.nimg')
+
+    expect = run([DRIVER, path, '-o', image])
+    if not os.path.exists(image):
+        # programs that fail to compile have nothing to compare
+        if expect[0] != 0:
+            passed.add(path)
+        else:
+            print('{0} image was not written!'.format(base))
+        return
+
+    got = run([DRIVER, '-i', image])
+    if got[0] == expect[0] and got[1] == expect[1]:
+        passed.add(path)
+    else:
+        print('{0} differs when run from an image!'.format(base))
+        show_diff(got, expect)
+
+
+def main(temp):
+    for path in programs(['./xpass', './regression']):
+        do_image(temp, path)
+
+
+if __name__ == '__main__':
+    in_temp(main)
+    report()
@@ -0,0 +1,138 @@
+#! /usr/bin/python
+
+# configure and build the console driver with NANO_JIT=ON, then run each
+# xpass and regression test with every function compiled on its first call
+# and check the output matches the interpreter.
+#
+# also check a thread waiting in a compiled function halts as often as it
+# does when interpreted.
+
+from __future__ import print_function
+import os
+import sys
+from common import DRIVER, SOURCE, CXX, run, write, programs, show_diff
+from common import in_temp, report, tried, passed
+
+
+JIT_BUILD = '../build_jit'
+JIT_DRIVER = os.path.join(JIT_BUILD, 'nano_driver')
+ROOT = '..'
+
+
+WAIT = r'''
+#include "host.h"
+
+using namespace nano;
+
+static const char *source = R"(
+function hot()
+  var i = 0
+  for (i = 0 to 3)
+    wait(2)
+  end
+  return i
+end
+function main()
+  var i = 0
+  var t = 0
+  for (i = 0 to 4)
+    t = t + hot()
+  end
+  return t
+end
+)";
+
+// resume the vm until its thread finishes, returning the number of resumes
+static int resumes(program_t &program, bool jit) {
+  vm_t vm(program);
+  vm.jit_enable(jit);
+  vm.new_thread(*program.function_find("main"), 0, nullptr);
+  int n = 0;
+  while (!vm.finished()) {
+    CHECK(vm.resume(1 << 20));
+    ++n;
+  }
+  if (jit) {
+    CHECK(vm.native_find(program.function_find("hot")->code_start_));
+  }
+  return n;
+}
+
+int main() {
+  program_t program;
+  CHECK(host::build(program, source));
+  const int expect = resumes(program, false);
+  CHECK(expect > 12);
+  CHECK(resumes(program, true) == expect);
+  return 0;
+}
+'''
+
+
+def build():
+    ret, out, err = run(['cmake', '-S', ROOT, '-B', JIT_BUILD,
+                         '-DNANO_JIT=ON', '-DNANO_BUILD_DRIVER=ON'])
+    if ret != 0:
+        print(out, err)
+        return False
+    ret, out, err = run(['cmake', '--build', JIT_BUILD, '--target',
+                         'nano_driver', '-j4'])
+    if ret != 0:
+        print(out, err)
+        return False
+    return True
+
+
+def do_jit(env, path):
+    print('{0}'.format(path))
+    tried.add(path)
+    expect = run([DRIVER, path])
+    got = run([JIT_DRIVER, path], env=env)
+    if got[0] == expect[0] and got[1] == expect[1]:
+        passed.add(path)
+    else:
+        print('{0} differs from the interpreter!'.format(
+            os.path.basename(path)))
+        show_diff(got, expect)
+
+
+def do_wait(temp, env):
+    print('wait')
+    tried.add('wait')
+    src = write(os.path.join(temp, 'wait.cpp'), WAIT)
+    exe = os.path.join(temp, 'wait')
+    ret, out, err = run([CXX, '-std=c++14', '-O1', '-DNANO_JIT=1',
+                         '-I' + SOURCE,
+                         '-I' + os.path.join(SOURCE, 'lib_common'),
+                         '-I./host', src, '-o', exe, '-L' + JIT_BUILD,
+                         '-lnano_lib_builtin', '-lnano_lib_compiler',
+                         '-lnano_lib_vm', '-lnano_lib_common', '-lpthread'])
+    if ret != 0:
+        print('wait test failed to build!')
+        print(err)
+        return
+    ret, out, err = run([exe], env=env)
+    if ret == 0:
+        passed.add('wait')
+    else:
+        print('waits differ from the interpreter!')
+        print('{0}{1}({2})'.format(out, err, ret))
+
+
+def main(temp):
+    if '-nobuild' not in sys.argv and not build():
+        print('unable to build the JIT driver')
+        exit(1)
+
+    # compile every function as soon as it is called
+    env = dict(os.environ)
+    env['NANO_JIT_THRESHOLD'] = '1'
+
+    for path in programs(['./xpass', './regression']):
+        do_jit(env, path)
+    do_wait(temp, env)
+
+
+if __name__ == '__main__':
+    in_temp(main)
+    report()
@@ -0,0 +1,128 @@
+#! /usr/bin/python
+
+# configure and build the console driver with NANO_OPCODE_STATS=ON, run a
+# small program and check the opcode counts, bigrams and binary operand
+# types it reports, and the hit counts in the '-a' annotated listing.
+
+from __future__ import print_function
+import os
+import sys
+from common import run, write, check_main
+
+
+STATS_BUILD = '../build_stats'
+STATS_DRIVER = os.path.join(STATS_BUILD, 'nano_driver')
+ROOT = '..'
+
+
+PROGRAM = '''
+function main()
+  var i = 0
+  var t = 0
+  for (i = 0 to 100)
+    t = t + i
+  end
+  var f = 1.5 * 2.0
+  return t
+end
+'''
+
+
+def build():
+    ret, out, err = run(['cmake', '-S', ROOT, '-B', STATS_BUILD,
+                         '-DNANO_OPCODE_STATS=ON', '-DNANO_BUILD_DRIVER=ON'])
+    if ret != 0:
+        print(out, err)
+        return False
+    ret, out, err = run(['cmake', '--build', STATS_BUILD, '--target',
+                         'nano_driver', '-j4'])
+    if ret != 0:
+        print(out, err)
+        return False
+    return True
+
+
+def read_stats(path):
+    # map each table's rows, keyed by the text after the count, to counts
+    total = None
+    tables = {}
+    table = None
+    with open(path) as fd:
+        for line in fd:
+            line = line.strip()
+            if line.startswith('opcode stats:'):
+                total = int(line.split()[2])
+            elif line.startswith('count'):
+                table = tables.setdefault(line.split(None, 1)[1], {})
+            elif line and table is not None:
+                percent, count, key = line.split(None, 2)
+                table[key] = int(count)
+    return total, tables
+
+
+def read_listing(path):
+    # hit counts of each instruction in order
+    hits = []
+    with open(path) as fd:
+        for line in fd:
+            if not line.startswith('#') and line.strip():
+                count, ins = line.split(None, 1)
+                hits.append((int(count), ins.strip()))
+    return hits
+
+
+def expect(table, key, count):
+    if table.get(key) != count:
+        print('expected {0} of {1}, got {2}'.format(count, key,
+                                                    table.get(key)))
+        return False
+    return True
+
+
+def check_stats(temp):
+    src = write(os.path.join(temp, 'stats.ccml'), PROGRAM)
+    stats = os.path.join(temp, 'stats.txt')
+    listing = os.path.join(temp, 'stats.lst')
+    env = dict(os.environ)
+    env['NANO_OPCODE_STATS'] = stats
+    res = run([STATS_DRIVER, '-a', listing, src], env=env)
+    if res[0] != 0 or res[1] != 'exit: 4950\n':
+        print('unexpected program result!')
+        print(res[1], res[2])
+        return False
+
+    total, tables = read_stats(stats)
+    ops = tables.get('opcode', {})
+    ok = (expect(ops, 'INS_ADD', 100) and expect(ops, 'INS_FOR', 100) and
+          expect(ops, 'INS_MUL', 1))
+    bigrams = tables.get('bigram', {})
+    ok = ok and (expect(bigrams, 'INS_GETV INS_ADD', 100) and
+                 expect(bigrams, 'INS_ADD INS_SETV', 100))
+    binary = tables.get('binary operands', {})
+    ok = ok and (expect(binary, 'INS_ADD int int', 100) and
+                 expect(binary, 'INS_MUL float float', 1))
+    if not ok:
+        return False
+    # every opcode executed fits in the table
+    if total != sum(ops.values()):
+        print('opcode counts do not add up to {0}'.format(total))
+        print(ops)
+        return False
+
+    hits = read_listing(listing)
+    if (100, 'INS_ADD') not in hits or (1, 'INS_MUL') not in hits:
+        print('expected the loop body hit 100 times in the listing')
+        print(hits)
+        return False
+    if sum(count for count, ins in hits) != total:
+        print('listing hit counts do not add up to {0}'.format(total))
+        print(hits)
+        return False
+    return True
+
+
+if __name__ == '__main__':
+    if '-nobuild' not in sys.argv and not build():
+        print('unable to build the opcode stats driver')
+        exit(1)
+    check_main(check_stats)
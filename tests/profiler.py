@@ -0,0 +1,82 @@
+#! /usr/bin/python
+
+# run a program with 'nano_driver -p' and check the collapsed stacks and the
+# report attribute the samples to the hot function and line, and that the
+# program output is unchanged by profiling.
+#
+# with '-bench' compare the run time with and without the profiler.
+
+from __future__ import print_function
+import os
+import sys
+from common import DRIVER, run, write, timed, in_temp, check_main
+
+
+PROGRAM = '''
+function hot(n)
+  var s = 0
+  var i = 0
+  for (i = 0 to n)
+    s = s + i * i
+  end
+  return s
+end
+
+function cold(n)
+  return n + 1
+end
+
+function main()
+  var t = 0
+  var j = 0
+  for (j = 0 to {0})
+    t = t + hot(500)
+    t = t + cold(j)
+  end
+  return t
+end
+'''
+
+
+def check(temp):
+    src = write(os.path.join(temp, 'prof.ccml'), PROGRAM.format(200))
+    out = os.path.join(temp, 'prof.folded')
+    plain = run([DRIVER, src])
+    prof = run([DRIVER, '-p', out, src])
+    if prof[0] != 0 or prof[1] != plain[1]:
+        print('profiled output differs!')
+        print(prof[1], prof[2])
+        return False
+    stacks = {}
+    with open(out) as fd:
+        for line in fd:
+            stack, count = line.rsplit(' ', 1)
+            stacks[stack] = int(count)
+    total = sum(stacks.values())
+    if stacks.get('main;hot', 0) < total * 0.9:
+        print('expected most samples in main;hot')
+        print(stacks)
+        return False
+    # the loop body should be the hottest line
+    lines = prof[2].split('line\n', 1)[-1].splitlines()
+    if not lines or 's = s + i * i' not in lines[0]:
+        print('expected the loop body as the hottest line')
+        print(prof[2])
+        return False
+    return True
+
+
+def bench(temp):
+    src = write(os.path.join(temp, 'bench.ccml'), PROGRAM.format(5000))
+    out = os.path.join(temp, 'bench.folded')
+    off = timed([DRIVER, src], 5)
+    on = timed([DRIVER, '-p', out, src], 5)
+    print('off {0:.3f}s  on {1:.3f}s  overhead {2:.1f}%'.format(
+        off, on, 100.0 * (on - off) / off))
+
+
+if __name__ == '__main__':
+    if '-bench' in sys.argv:
+        in_temp(bench)
+        exit(0)
+    check_main(check)
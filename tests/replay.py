@@ -0,0 +1,48 @@
+#! /usr/bin/python
+
+# record a program reading stdin with 'nano_driver -record' and check that
+# '-replay' repeats the run without any input.
+
+from __future__ import print_function
+import os
+from common import DRIVER, run, write, check_main
+
+
+REPLAY = '''
+function main()
+  var a = gets()
+  var c = getc()
+  var n = 0
+  var i = 0
+  for (i = 0 to 10)
+    n = n + rand() % 7
+  end
+  puts(a + "|" + c + "|" + n)
+  return len(a)
+end
+'''
+
+
+def check_replay(temp):
+    src = write(os.path.join(temp, 'replay.ccml'), REPLAY)
+    log = os.path.join(temp, 'replay.log')
+    rec = run([DRIVER, '-record', log, src], 'hello\nX')
+    if rec[0] != 0 or 'hello|88|' not in rec[1]:
+        print('failed to record!')
+        print(rec[1], rec[2])
+        return False
+    play = run([DRIVER, '-replay', log, src], '')
+    if play[0] != 0 or play[1] != rec[1]:
+        print('replayed output differs!')
+        print(play[1], play[2])
+        return False
+    # a log only replays the program it was recorded from
+    write(src, REPLAY.replace('% 7', '% 5'))
+    if run([DRIVER, '-replay', log, src], '')[0] == 0:
+        print('replayed a log recorded from another program')
+        return False
+    return True
+
+
+if __name__ == '__main__':
+    check_main(check_replay)
@@ -20,6 +20,10 @@ else:
 tried = set()
 passed = set()
 
+# file to gather lcov coverage of the xpass and regression tests into
+lcov_out = None
+LCOV_TEMP = 'temp.info'
+
 
 def get_expected(path):
     with open(path, "r") as fd:
@@ -36,7 +40,8 @@ def try_comp(base, path):
         proc = subprocess.Popen(
             [COMP, path],
             stdout=subprocess.PIPE,
-            stderr=subprocess.PIPE)
+            stderr=subprocess.PIPE,
+            universal_newlines=True)
         out, err = proc.communicate()
         ret = proc.returncode
     except OSError:
@@ -50,7 +55,8 @@ def do_comp(base, path):
         proc = subprocess.Popen(
             [COMP, path],
             stdout=subprocess.PIPE,
-            stderr=subprocess.PIPE)
+            stderr=subprocess.PIPE,
+            universal_newlines=True)
 
         out, err = proc.communicate()
         ret = proc.returncode
@@ -64,17 +70,30 @@ def do_comp(base, path):
         print('failed to execute {0}'.format(path))
 
 
+def append_lcov():
+    if os.path.exists(LCOV_TEMP):
+        with open(LCOV_TEMP, 'r') as src, open(lcov_out, 'a') as dst:
+            dst.write(src.read())
+        os.remove(LCOV_TEMP)
+
+
 def do_xpass(base, path):
     print('{0}'.format(path))
     tried.add(path)
+    args = [DRIVER, path]
+    if lcov_out:
+        args = [DRIVER, '-l', LCOV_TEMP, path]
     try:
         proc = subprocess.Popen(
-            [DRIVER, path],
+            args,
             stdout=subprocess.PIPE,
-            stderr=subprocess.PIPE)
+            stderr=subprocess.PIPE,
+            universal_newlines=True)
 
         out, err = proc.communicate()
         ret = proc.returncode
+        if lcov_out:
+            append_lcov()
 
         if ret != 0:
             print('{0} returned error code {1}!'.format(base, ret))
@@ -99,7 +118,8 @@ def do_xfail(base, path):
         proc = subprocess.Popen(
             [DRIVER, path],
             stdout=subprocess.PIPE,
-            stderr=subprocess.PIPE)
+            stderr=subprocess.PIPE,
+            universal_newlines=True)
 
         out, err = proc.communicate()
         ret = proc.returncode
@@ -114,7 +134,11 @@ def do_xfail(base, path):
 
 
 def main():
+    global lcov_out
     arg_fast = ('-fast' in sys.argv)
+    if '-lcov' in sys.argv:
+        lcov_out = sys.argv[sys.argv.index('-lcov') + 1]
+        open(lcov_out, 'w').close()
 
     for f in os.listdir('./xpass'):
         root, ext = os.path.splitext(f)
@@ -0,0 +1,141 @@
+#! /usr/bin/python
+
+# check the numeric array builtins give the same results with every simd
+# kernel level ('NANO_SIMD=scalar|sse|avx2') for array sizes which exercise
+# the vector loops and their scalar tails.
+#
+# with '-bench' time each builtin against the equivalent script loop.
+
+from __future__ import print_function
+import os
+import sys
+from common import DRIVER, run, write, timed, in_temp, report, tried, passed
+
+
+LEVELS = ['scalar', 'sse', 'avx2']
+
+SIZES = [1, 3, 4, 7, 8, 15, 16, 17, 33, 100]
+
+CHECK = '''
+function main()
+  var n = {0}
+  var a = new_float32_array(n)
+  var b = new_float32_array(n)
+  var i = 0
+  for (i = 0 to n)
+    a[i] = ((i * 37) % 13) - 5.25
+    b[i] = (i % 3) + 0.5
+  end
+  var r = new_array(8)
+  r[0] = array_sum(a)
+  r[1] = array_dot(a, b)
+  r[2] = array_min(a)
+  r[3] = array_max(a)
+  r[4] = array_argmax(a)
+  array_axpy(2, b, a)
+  array_mul(a, b)
+  array_add(a, b)
+  array_scale(a, 0.5)
+  array_clamp(a, -2, 4)
+  r[5] = array_sum(a)
+  r[6] = a[0]
+  r[7] = a[n - 1]
+  for (i = 0 to 8)
+    puts("" + r[i])
+  end
+end
+'''
+
+SETUP = '''
+function main()
+  var n = 20000
+  var a = new_float32_array(n)
+  var b = new_float32_array(n)
+  var i = 0
+  for (i = 0 to n)
+    a[i] = i % 100
+    b[i] = 0.5
+  end
+  var s = 0
+  var r = 0
+  for (r = 0 to 20)
+{0}
+  end
+  return s
+end
+'''
+
+BENCH = [
+  ('sum',
+   '    s = array_sum(a)',
+   '    s = 0\n    for (i = 0 to n)\n      s = s + a[i]\n    end'),
+  ('dot',
+   '    s = array_dot(a, b)',
+   '    s = 0\n    for (i = 0 to n)\n      s = s + a[i] * b[i]\n    end'),
+  ('max',
+   '    s = array_max(a)',
+   '    s = a[0]\n    for (i = 1 to n)\n      if (a[i] > s)\n'
+   '        s = a[i]\n      end\n    end'),
+  ('axpy',
+   '    array_axpy(0.5, b, a)',
+   '    for (i = 0 to n)\n      a[i] = a[i] + 0.5 * b[i]\n    end'),
+  ('scale',
+   '    array_scale(a, 0.5)',
+   '    for (i = 0 to n)\n      a[i] = a[i] * 0.5\n    end'),
+  ('add',
+   '    array_add(a, b)',
+   '    for (i = 0 to n)\n      a[i] = a[i] + b[i]\n    end'),
+]
+
+
+def level_env(level):
+    env = dict(os.environ)
+    if level:
+        env['NANO_SIMD'] = level
+    return env
+
+
+def do_check(temp, size):
+    name = 'size {0}'.format(size)
+    print(name)
+    tried.add(name)
+    src = write(os.path.join(temp, 'check.ccml'), CHECK.format(size))
+    outs = [run([DRIVER, src], env=level_env(level)) for level in LEVELS]
+    if outs[0][0] != 0:
+        print('{0} failed to run!'.format(name))
+        print(outs[0][1], outs[0][2])
+        return
+    for level, out in zip(LEVELS[1:], outs[1:]):
+        if out != outs[0]:
+            print('{0} differs with {1} kernels!'.format(name, level))
+            print('got ----\n{0}\n--------'.format(out[1].strip()))
+            print('exp ----\n{0}\n--------'.format(outs[0][1].strip()))
+            return
+    passed.add(name)
+
+
+def do_bench(temp):
+    def setup(name, body):
+        return write(os.path.join(temp, name + '.ccml'), SETUP.format(body))
+    # time spent compiling and filling the arrays is subtracted
+    base = timed([DRIVER, setup('base', '    s = 0')], 5)
+    print('{0:8} {1:>12} {2:>12} {3:>8}'.format('', 'builtin', 'script',
+                                                 'speedup'))
+    for name, builtin, script in BENCH:
+        b = max(timed([DRIVER, setup(name + '_b', builtin)], 5) - base, 1e-6)
+        s = max(timed([DRIVER, setup(name + '_s', script)], 3) - base, 1e-6)
+        print('{0:8} {1:9.2f} ms {2:9.2f} ms {3:7.0f}x'.format(
+            name, b * 1000, s * 1000, s / b))
+
+
+def main(temp):
+    for size in SIZES:
+        do_check(temp, size)
+
+
+if __name__ == '__main__':
+    if '-bench' in sys.argv:
+        in_temp(do_bench)
+        exit(0)
+    in_temp(main)
+    report()
@@ -0,0 +1,82 @@
+#! /usr/bin/python
+
+# run each test program once writing a snapshot of its globals after @init
+# with 'nano_driver -s', then again restoring it with 'nano_driver -r' and
+# check the output matches.
+#
+# with '-bench' compare cold start against snapshot start for a program that
+# builds a large global table.
+
+from __future__ import print_function
+import os
+import sys
+from common import DRIVER, run, write, timed, programs, show_diff, in_temp
+from common import report, tried, passed
+
+
+BENCH = '''
+function make(n)
+  var t = new_array(n)
+  var i = 0
+  for (i = 0 to n)
+    t[i] = (i * 7919) % 1000
+  end
+  var j = 0
+  for (j = 0 to 50)
+    for (i = 0 to n)
+      t[i] = (t[i] * 31 + j) % 1000
+    end
+  end
+  return t
+end
+var table = make(10000)
+function main()
+  return table[1234]
+end
+'''
+
+
+def do_snapshot(temp, path):
+    print('{0}'.format(path))
+    tried.add(path)
+    base = os.path.basename(path)
+    snap = os.path.join(temp, base + '.snap')
+
+    expect = run([DRIVER, path, '-s', snap])
+    if not os.path.exists(snap):
+        # programs that fail before main have nothing to compare
+        if expect[0] != 0:
+            passed.add(path)
+        else:
+            print('{0} snapshot was not written!'.format(base))
+        return
+
+    got = run([DRIVER, path, '-r', snap])
+    if got[0] == expect[0] and got[1] == expect[1]:
+        passed.add(path)
+    else:
+        print('{0} differs when restored from a snapshot!'.format(base))
+        show_diff(got, expect)
+
+
+def do_bench(temp):
+    src = write(os.path.join(temp, 'bench.ccml'), BENCH)
+    snap = os.path.join(temp, 'bench.snap')
+    run([DRIVER, src, '-s', snap])
+    cold = timed([DRIVER, src], 5)
+    warm = timed([DRIVER, src, '-r', snap], 5)
+    print('cold start     {0:.2f} ms'.format(cold * 1000))
+    print('snapshot start {0:.2f} ms'.format(warm * 1000))
+
+
+def main(temp):
+    for path in programs(['./xpass', './regression']):
+        do_snapshot(temp, path)
+
+
+if __name__ == '__main__':
+    if '-bench' in sys.argv:
+        in_temp(do_bench)
+        exit(0)
+    in_temp(main)
+    report()
@@ -0,0 +1,57 @@
+#! /usr/bin/python
+
+# run a program with 'nano_driver -t' and check the trace event file holds
+# the thread slices, syscalls and collections.
+
+from __future__ import print_function
+import json
+import os
+from common import DRIVER, run, write, check_main
+
+
+TRACE = '''
+function main()
+  var s = ""
+  var i = 0
+  for (i = 0 to 50000)
+    s = "garbage " + i
+  end
+  puts(s)
+  return 0
+end
+'''
+
+
+def check_trace(temp):
+    # enough garbage for at least one collection and a syscall to time
+    src = write(os.path.join(temp, 'trace.ccml'), TRACE)
+    out = os.path.join(temp, 'trace.json')
+    res = run([DRIVER, '-t', out, src])
+    if res[0] != 0:
+        print('failed to run!')
+        print(res[1], res[2])
+        return False
+    with open(out) as fd:
+        events = json.load(fd)['traceEvents']
+    names = set(e['name'] for e in events)
+    for name in ['resume', 'puts', 'gc_collect', 'thread_create',
+                 'thread_finish']:
+        if name not in names:
+            print('expected a {0} event'.format(name))
+            print(sorted(names))
+            return False
+    # syscalls happen within a resume slice of the same thread
+    slices = [e for e in events if e['name'] == 'resume']
+    for e in events:
+        if e['name'] != 'puts':
+            continue
+        if not any(s['tid'] == e['tid'] and s['ts'] <= e['ts'] and
+                   e['ts'] + e['dur'] <= s['ts'] + s['dur'] + 0.01
+                   for s in slices):
+            print('syscall outside of a resume slice')
+            return False
+    return True
+
+
+if __name__ == '__main__':
+    check_main(check_trace)